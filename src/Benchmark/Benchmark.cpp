@@ -0,0 +1,235 @@
+﻿#include "Pch.h"
+#include "Benchmark.h"
+
+namespace
+{
+    std::atomic<int64_t> sAllocatedBytes = 0;
+    std::atomic<bool> sCountsAllocations = false;   // Only written by AllocationWindow, so other runs never share a written line
+
+    // Stored in front of every block, so a block can be freed without knowing how it was allocated
+    struct BlockHeader
+    {
+        void*   raw;
+        size_t  size;
+        bool    counted;
+    };
+
+    void* Allocate(const size_t size, const size_t alignment)
+    {
+        const size_t blockAlignment = std::max(alignment, alignof(std::max_align_t));
+        void* raw = std::malloc(sizeof(BlockHeader) + blockAlignment + size);
+
+        if (raw == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+
+        const uintptr_t block = (reinterpret_cast<uintptr_t>(raw) + sizeof(BlockHeader) + blockAlignment - 1) & ~(blockAlignment - 1);
+
+        BlockHeader* header = reinterpret_cast<BlockHeader*>(block) - 1;
+        header->raw = raw;
+        header->size = size;
+        header->counted = sCountsAllocations.load(std::memory_order_relaxed);
+
+        if (header->counted)
+        {
+            sAllocatedBytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+        }
+
+        return reinterpret_cast<void*>(block);
+    }
+
+    void* TryAllocate(const size_t size, const size_t alignment) noexcept
+    {
+        try
+        {
+            return Allocate(size, alignment);
+        }
+        catch (const std::bad_alloc&)
+        {
+            return nullptr;
+        }
+    }
+
+    void Free(void* block) noexcept
+    {
+        if (block == nullptr)
+        {
+            return;
+        }
+
+        const BlockHeader* header = static_cast<BlockHeader*>(block) - 1;
+
+        if (header->counted)
+        {
+            sAllocatedBytes.fetch_sub(static_cast<int64_t>(header->size), std::memory_order_relaxed);
+        }
+
+        std::free(header->raw);
+    }
+}
+
+void* operator new(const size_t size) { return Allocate(size, alignof(std::max_align_t)); }
+void* operator new[](const size_t size) { return Allocate(size, alignof(std::max_align_t)); }
+void* operator new(const size_t size, const std::align_val_t alignment) { return Allocate(size, static_cast<size_t>(alignment)); }
+void* operator new[](const size_t size, const std::align_val_t alignment) { return Allocate(size, static_cast<size_t>(alignment)); }
+
+// The default nothrow forms may call malloc directly, Free would then read a header that was never written
+void* operator new(const size_t size, const std::nothrow_t&) noexcept { return TryAllocate(size, alignof(std::max_align_t)); }
+void* operator new[](const size_t size, const std::nothrow_t&) noexcept { return TryAllocate(size, alignof(std::max_align_t)); }
+void* operator new(const size_t size, const std::align_val_t alignment, const std::nothrow_t&) noexcept { return TryAllocate(size, static_cast<size_t>(alignment)); }
+void* operator new[](const size_t size, const std::align_val_t alignment, const std::nothrow_t&) noexcept { return TryAllocate(size, static_cast<size_t>(alignment)); }
+
+void operator delete(void* block) noexcept { Free(block); }
+void operator delete[](void* block) noexcept { Free(block); }
+void operator delete(void* block, size_t) noexcept { Free(block); }
+void operator delete[](void* block, size_t) noexcept { Free(block); }
+void operator delete(void* block, std::align_val_t) noexcept { Free(block); }
+void operator delete[](void* block, std::align_val_t) noexcept { Free(block); }
+void operator delete(void* block, size_t, std::align_val_t) noexcept { Free(block); }
+void operator delete[](void* block, size_t, std::align_val_t) noexcept { Free(block); }
+void operator delete(void* block, const std::nothrow_t&) noexcept { Free(block); }
+void operator delete[](void* block, const std::nothrow_t&) noexcept { Free(block); }
+void operator delete(void* block, std::align_val_t, const std::nothrow_t&) noexcept { Free(block); }
+void operator delete[](void* block, std::align_val_t, const std::nothrow_t&) noexcept { Free(block); }
+
+namespace Benchmark
+{
+    std::ofstream Reporter::sOutput;
+    Mutex Reporter::sMutex;
+
+    void Reporter::Open(const std::string& path)
+    {
+        sOutput.open(path, std::ios::trunc);
+    }
+
+    void Reporter::Report(const std::string& name, const std::string& params, const uint64_t numOps, const Nanoseconds elapsed)
+    {
+        const double nsPerOp = static_cast<double>(elapsed.count()) / static_cast<double>(numOps);
+        const double opsPerSec = (elapsed.count() == 0) ? 0.0 : (numOps * 1e9 / elapsed.count());
+
+        std::ostringstream line;
+        line << "{\"name\":\"" << name << "\""
+             << ",\"params\":\"" << params << "\""
+             << ",\"ops\":" << numOps
+             << ",\"ns\":" << elapsed.count()
+             << ",\"nsPerOp\":" << nsPerOp
+             << ",\"opsPerSec\":" << opsPerSec
+             << "}";
+
+        WriteLine(line.str());
+    }
+
+    void Reporter::ReportMemory(const std::string& name, const std::string& params, const uint64_t numItems, const int64_t numBytes)
+    {
+        const double bytesPerItem = static_cast<double>(numBytes) / static_cast<double>(numItems);
+
+        std::ostringstream line;
+        line << "{\"name\":\"" << name << "\""
+             << ",\"params\":\"" << params << "\""
+             << ",\"items\":" << numItems
+             << ",\"bytes\":" << numBytes
+             << ",\"bytesPerItem\":" << bytesPerItem
+             << "}";
+
+        WriteLine(line.str());
+    }
+
+    void Reporter::ReportThroughput(const std::string& name, const std::string& params, const uint64_t numBytes, const Nanoseconds elapsed, const uint64_t numCycles)
+    {
+        const double bytesPerCycle = (numCycles == 0) ? 0.0 : (static_cast<double>(numBytes) / static_cast<double>(numCycles));
+        const double gbPerSec = (elapsed.count() == 0) ? 0.0 : (static_cast<double>(numBytes) / elapsed.count());
+
+        std::ostringstream line;
+        line << "{\"name\":\"" << name << "\""
+             << ",\"params\":\"" << params << "\""
+             << ",\"bytes\":" << numBytes
+             << ",\"ns\":" << elapsed.count()
+             << ",\"cycles\":" << numCycles
+             << ",\"bytesPerCycle\":" << bytesPerCycle
+             << ",\"gbPerSec\":" << gbPerSec
+             << "}";
+
+        WriteLine(line.str());
+    }
+
+    void Reporter::ReportCpuCost(const std::string& name, const std::string& params, const uint64_t numOps, const Nanoseconds elapsed, const Nanoseconds cpuElapsed)
+    {
+        const double nsPerOp = static_cast<double>(elapsed.count()) / static_cast<double>(numOps);
+        const double cpuNsPerOp = static_cast<double>(cpuElapsed.count()) / static_cast<double>(numOps);
+        const double cores = (elapsed.count() == 0) ? 0.0 : (static_cast<double>(cpuElapsed.count()) / elapsed.count());
+
+        std::ostringstream line;
+        line << "{\"name\":\"" << name << "\""
+             << ",\"params\":\"" << params << "\""
+             << ",\"ops\":" << numOps
+             << ",\"ns\":" << elapsed.count()
+             << ",\"nsPerOp\":" << nsPerOp
+             << ",\"cpuNs\":" << cpuElapsed.count()
+             << ",\"cpuNsPerOp\":" << cpuNsPerOp
+             << ",\"cores\":" << cores
+             << "}";
+
+        WriteLine(line.str());
+    }
+
+    void Reporter::WriteLine(const std::string& line)
+    {
+        MutexLockGrd lock(sMutex);
+
+        sOutput << line << std::endl;
+        std::cerr << line << "\n";
+    }
+
+    AllocationWindow::AllocationWindow()
+    {
+        sCountsAllocations.store(true);
+    }
+
+    AllocationWindow::~AllocationWindow()
+    {
+        sCountsAllocations.store(false);
+    }
+
+    int64_t GetAllocatedBytes()
+    {
+        return sAllocatedBytes.load(std::memory_order_relaxed);
+    }
+
+    Nanoseconds ReadProcessCpuTime()
+    {
+#if defined(_WIN32)
+        FILETIME creation, exit, kernel, user;
+
+        if (!::GetProcessTimes(::GetCurrentProcess(), &creation, &exit, &kernel, &user))
+        {
+            return Nanoseconds(0);
+        }
+
+        auto toNs = [](const FILETIME& time)
+            {
+                return ((static_cast<int64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) * 100;
+            };
+
+        return Nanoseconds(toNs(kernel) + toNs(user));
+#else
+        timespec time;
+
+        if (::clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time) != 0)
+        {
+            return Nanoseconds(0);
+        }
+
+        return Nanoseconds(static_cast<int64_t>(time.tv_sec) * 1'000'000'000 + time.tv_nsec);
+#endif
+    }
+
+    uint64_t ReadCycleCounter()
+    {
+#if defined(_M_X64) || defined(__x86_64__)
+        return __rdtsc();
+#else
+        return SteadyNowNs();
+#endif
+    }
+}
@@ -0,0 +1,90 @@
+﻿#pragma once
+
+namespace Benchmark
+{
+    /*------------------*
+     *    Benchmarks    *
+     *------------------*/
+
+    void RunMessageBenchmarks();
+    void RunLockBufferBenchmarks();
+    void RunDispatchBenchmarks();
+    void RunSessionBenchmarks();
+    void RunBroadcastBenchmarks();
+    void RunLoopbackBenchmarks();
+    void RunPingBenchmarks();
+    void RunChecksumBenchmarks();
+    void RunReplicationBenchmarks();
+
+    /*----------------*
+     *    Reporter    *
+     *----------------*/
+
+    // 결과를 한 줄에 하나씩 JSON 객체로 기록한다
+    class Reporter
+    {
+    public:
+        static void Open(const std::string& path);
+        static void Report(const std::string& name, const std::string& params, const uint64_t numOps, const Nanoseconds elapsed);
+        static void ReportMemory(const std::string& name, const std::string& params, const uint64_t numItems, const int64_t numBytes);
+        static void ReportThroughput(const std::string& name, const std::string& params, const uint64_t numBytes, const Nanoseconds elapsed, const uint64_t numCycles);
+
+        // 작업당 벽시계 시간과 그동안 프로세스가 쓴 CPU 시간을 한 줄에 기록한다, cores는 평균으로 쓴 코어 수
+        static void ReportCpuCost(const std::string& name, const std::string& params, const uint64_t numOps, const Nanoseconds elapsed, const Nanoseconds cpuElapsed);
+
+    private:
+        static void WriteLine(const std::string& line);
+
+    private:
+        static std::ofstream    sOutput;
+        static Mutex            sMutex;
+    };
+
+    /*------------------------*
+     *    AllocationWindow    *
+     *------------------------*/
+
+    // 살아 있는 동안만 operator new가 할당을 센다, 한 번에 하나만 둔다
+    // 창 밖의 할당은 공유 카운터를 건드리지 않아서 다른 벤치마크의 수치에 영향을 주지 않는다
+    class AllocationWindow
+    {
+    public:
+        AllocationWindow();
+        ~AllocationWindow();
+        AllocationWindow(const AllocationWindow&) = delete;
+        AllocationWindow& operator=(const AllocationWindow&) = delete;
+    };
+
+    // AllocationWindow 안에서 할당되어 아직 해제되지 않은 힙 바이트, Benchmark는 operator new를 바꿔서 센다
+    // 해제한 메모리를 재사용하거나 페이지 단위로 잡히는 상주 메모리와 달리 할당한 만큼만 바뀐다
+    int64_t GetAllocatedBytes();
+
+    // 프로세스의 모든 스레드가 쓴 CPU 시간, 윈도우의 std::clock은 벽시계 시간이라 대신 쓴다
+    Nanoseconds ReadProcessCpuTime();
+
+    // x86에서는 TSC, 그 밖에서는 나노초
+    uint64_t ReadCycleCounter();
+
+    template<typename TFunc>
+    Nanoseconds Measure(TFunc&& func)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        func();
+
+        return std::chrono::steady_clock::now() - start;
+    }
+
+    // 컴파일러가 결과를 버리지 못하게 한다
+    template<typename T>
+    void KeepAlive(const T& value)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        // The value must be in memory that the empty asm may read
+        asm volatile("" : : "r"(&value) : "memory");
+#else
+        static volatile char sink;
+        sink = *reinterpret_cast<const volatile char*>(&value);
+        (void)sink;
+#endif
+    }
+}
@@ -0,0 +1,88 @@
+﻿#include "Pch.h"
+#include "Benchmark.h"
+#include "Config.h"
+
+namespace Benchmark
+{
+    using ChecksumFunc = uint32_t(*)(const void*, const size_t, const uint32_t);
+
+    // 같은 버퍼를 반복해서 계산한다, 이전 결과를 이어받아 호출끼리 겹쳐 실행되지 않게 한다
+    void RunCrc32cBenchmark(const ChecksumFunc checksum, const char* backend, const size_t blockSize)
+    {
+        const size_t numIters = Config::numChecksumBytes / blockSize;
+        const std::string params = std::string("backend=") + backend + ",block=" + std::to_string(blockSize);
+
+        std::vector<std::byte> block(blockSize);
+
+        for (size_t idx = 0; idx < blockSize; ++idx)
+        {
+            block[idx] = static_cast<std::byte>(idx * 31 + 7);
+        }
+
+        uint32_t crc = 0;
+        uint64_t numCycles = 0;
+
+        const Nanoseconds elapsed = Measure([checksum, &block, &crc, &numCycles, numIters]()
+            {
+                const uint64_t start = ReadCycleCounter();
+
+                for (size_t iter = 0; iter < numIters; ++iter)
+                {
+                    crc = checksum(block.data(), block.size(), crc);
+                }
+
+                numCycles = ReadCycleCounter() - start;
+            });
+
+        KeepAlive(crc);
+        Reporter::ReportThroughput("Crc32c.Compute", params, numIters * blockSize, elapsed, numCycles);
+    }
+
+    // 송신 쪽 인코딩과 수신 쪽 검사를 합친 프레임당 비용
+    void RunFrameChecksumBenchmark(const size_t payloadSize)
+    {
+        const size_t numIters = Config::numMessageOps;
+
+        Message msg;
+        msg.payload.resize(payloadSize);
+        msg.header.size = static_cast<Message::Size>(msg.CalculateSize());
+
+        std::vector<std::byte> frame(sizeof(Message::Header) + payloadSize + Framing::checksumSize);
+        std::memcpy(frame.data(), &msg.header, sizeof(Message::Header));
+
+        size_t numValid = 0;
+
+        const Nanoseconds elapsed = Measure([&frame, &msg, &numValid, numIters]()
+            {
+                const std::byte* header = frame.data();
+                const size_t frameSize = sizeof(Message::Header) + msg.payload.size();
+
+                for (size_t iter = 0; iter < numIters; ++iter)
+                {
+                    Framing::EncodeChecksum(header, sizeof(Message::Header), msg.payload.data(), msg.payload.size(), frame.data() + frameSize);
+                    numValid += Framing::VerifyChecksum(frame.data(), frameSize);
+                }
+            });
+
+        KeepAlive(numValid);
+        Reporter::Report("Framing.Checksum", "payload=" + std::to_string(payloadSize), numIters, elapsed);
+    }
+
+    void RunChecksumBenchmarks()
+    {
+        for (const size_t blockSize : { 16, 64, 256, 1024, 4096, 65536 })
+        {
+            RunCrc32cBenchmark(Crc32c::Compute, Crc32c::GetBackend(), blockSize);
+
+            if (Crc32c::IsHardwareAccelerated())
+            {
+                RunCrc32cBenchmark(Crc32c::ComputeSoftware, "table", blockSize);
+            }
+        }
+
+        for (const size_t payloadSize : { 0, 16, 256, 4096 })
+        {
+            RunFrameChecksumBenchmark(payloadSize);
+        }
+    }
+}
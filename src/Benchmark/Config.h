@@ -0,0 +1,24 @@
+﻿#pragma once
+
+namespace Benchmark::Config
+{
+    constexpr uint8_t maxThreads = 8;
+
+    constexpr size_t numMessageOps = 1'000'000;
+    constexpr size_t numLockBufferOps = 1'000'000;
+    constexpr size_t numDispatchOps = 1'000'000;
+    constexpr size_t numFramingMsgs = 200'000;
+    constexpr size_t numConflationUpdates = 1'000'000;
+    constexpr size_t numBroadcasts = 100;
+    constexpr size_t numNearbyPublishes = 10'000;
+    constexpr float nearbySpacing = 16.0f;              // 세션 하나가 차지하는 월드 칸의 한 변
+    constexpr float nearbyRadius = 64.0f;               // 관심 반경 안에 세션이 50개쯤 들어온다
+    constexpr size_t numFootprintSessions = 100'000;
+    constexpr size_t numLoopbackSessions = 100'000;
+    constexpr size_t numPings = 20'000;
+    constexpr uint16_t pingPort = 60100;
+    constexpr size_t numReplicationTicks = 2'000;
+    constexpr size_t numChecksumBytes = 256 * 1024 * 1024;  // 크기마다 이만큼을 나눠서 계산한다
+
+    constexpr const char* outputPath = "benchmark.jsonl";
+}
@@ -0,0 +1,16 @@
+﻿#pragma once
+
+#include <PattyCore/Include.h>
+#include <PattyCore/ServerServiceBase.h>
+#include <PattyCore/ClientServiceBase.h>
+
+#include <new>
+#include <cstdlib>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif // _MSC_VER
+#endif
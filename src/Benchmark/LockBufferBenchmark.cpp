@@ -0,0 +1,105 @@
+﻿#include "Pch.h"
+#include "Benchmark.h"
+#include "Config.h"
+
+namespace Benchmark
+{
+    void RunLockBufferPushPop(const size_t numThreads)
+    {
+        LockBuffer<uint64_t> buffer;
+        const size_t numOpsPerThread = Config::numLockBufferOps / numThreads;
+
+        const Nanoseconds elapsed = Measure([&buffer, numThreads, numOpsPerThread]()
+            {
+                std::vector<std::thread> threads;
+
+                for (size_t idx = 0; idx < numThreads; ++idx)
+                {
+                    threads.emplace_back([&buffer, numOpsPerThread]()
+                                         {
+                                             uint64_t item = 0;
+
+                                             for (size_t op = 0; op < numOpsPerThread; ++op)
+                                             {
+                                                 buffer.Push(uint64_t(op));
+                                                 buffer.Pop(item);
+                                             }
+
+                                             KeepAlive(item);
+                                         });
+                }
+
+                for (std::thread& thread : threads)
+                {
+                    thread.join();
+                }
+            });
+
+        Reporter::Report("LockBuffer.PushPop", "threads=" + std::to_string(numThreads), numOpsPerThread * numThreads * 2, elapsed);
+    }
+
+    // numThreads - 1개 스레드가 넣고 1개 스레드가 통째로 꺼낸다
+    void RunLockBufferSwap(const size_t numThreads)
+    {
+        LockBuffer<uint64_t> buffer;
+        const size_t numProducers = std::max<size_t>(numThreads - 1, 1);
+        const size_t numOpsPerThread = Config::numLockBufferOps / numProducers;
+        std::atomic<size_t> numDone = 0;
+        size_t numSwapped = 0;
+
+        const Nanoseconds elapsed = Measure([&]()
+            {
+                std::vector<std::thread> threads;
+
+                for (size_t idx = 0; idx < numProducers; ++idx)
+                {
+                    threads.emplace_back([&buffer, &numDone, numOpsPerThread]()
+                                         {
+                                             for (size_t op = 0; op < numOpsPerThread; ++op)
+                                             {
+                                                 buffer.Push(uint64_t(op));
+                                             }
+
+                                             numDone.fetch_add(1);
+                                         });
+                }
+
+                std::queue<uint64_t> swapped;
+
+                while (true)
+                {
+                    const bool producersDone = (numDone.load() == numProducers);
+
+                    buffer >> swapped;
+                    numSwapped += swapped.size();
+                    swapped = std::queue<uint64_t>();
+
+                    if (producersDone)
+                    {
+                        break;
+                    }
+                }
+
+                for (std::thread& thread : threads)
+                {
+                    thread.join();
+                }
+            });
+
+        assert(numSwapped == numOpsPerThread * numProducers);
+        Reporter::Report("LockBuffer.Swap", "threads=" + std::to_string(numThreads), numSwapped, elapsed);
+    }
+
+    void RunLockBufferBenchmarks()
+    {
+        for (size_t numThreads = 1; numThreads <= Config::maxThreads; numThreads *= 2)
+        {
+            RunLockBufferPushPop(numThreads);
+        }
+
+        for (size_t numThreads = 2; numThreads <= Config::maxThreads; numThreads *= 2)
+        {
+            RunLockBufferSwap(numThreads);
+        }
+    }
+}
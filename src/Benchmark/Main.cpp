@@ -0,0 +1,43 @@
+﻿#include "Pch.h"
+#include "Benchmark.h"
+#include "Config.h"
+
+using namespace Benchmark;
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        const std::string outputPath = (argc > 1) ? argv[1] : Config::outputPath;
+        const std::string filter = (argc > 2) ? argv[2] : "";
+
+        Reporter::Open(outputPath);
+
+        const std::vector<std::pair<std::string, void(*)()>> benchmarks =
+        {
+            { "Message",    RunMessageBenchmarks },
+            { "LockBuffer", RunLockBufferBenchmarks },
+            { "Dispatch",   RunDispatchBenchmarks },
+            { "Session",    RunSessionBenchmarks },
+            { "Broadcast",  RunBroadcastBenchmarks },
+            { "Loopback",   RunLoopbackBenchmarks },
+            { "Ping",       RunPingBenchmarks },
+            { "Checksum",   RunChecksumBenchmarks },
+            { "Replication", RunReplicationBenchmarks },
+        };
+
+        for (const auto& benchmark : benchmarks)
+        {
+            if (filter.empty() || (benchmark.first == filter))
+            {
+                benchmark.second();
+            }
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+    }
+
+    return 0;
+}
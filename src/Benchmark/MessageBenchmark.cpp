@@ -0,0 +1,165 @@
+﻿#include "Pch.h"
+#include "Benchmark.h"
+#include "Config.h"
+
+namespace Benchmark
+{
+    template<size_t NumFields>
+    void RunMessageBenchmark()
+    {
+        const size_t numIters = Config::numMessageOps / NumFields;
+        Message msg;
+
+        const Nanoseconds pushElapsed = Measure([&msg, numIters]()
+            {
+                for (size_t iter = 0; iter < numIters; ++iter)
+                {
+                    msg.payload.clear();
+
+                    for (size_t field = 0; field < NumFields; ++field)
+                    {
+                        msg << static_cast<uint64_t>(field);
+                    }
+                }
+            });
+
+        KeepAlive(msg.header.size);
+        Reporter::Report("Message.Push", "fields=" + std::to_string(NumFields), numIters * NumFields, pushElapsed);
+
+        uint64_t sum = 0;
+
+        const Nanoseconds pushPopElapsed = Measure([&msg, &sum, numIters]()
+            {
+                for (size_t iter = 0; iter < numIters; ++iter)
+                {
+                    for (size_t field = 0; field < NumFields; ++field)
+                    {
+                        msg << static_cast<uint64_t>(field);
+                    }
+
+                    for (size_t field = 0; field < NumFields; ++field)
+                    {
+                        uint64_t value = 0;
+                        msg >> value;
+                        sum += value;
+                    }
+                }
+            });
+
+        KeepAlive(sum);
+        Reporter::Report("Message.PushPop", "fields=" + std::to_string(NumFields), numIters * NumFields, pushPopElapsed);
+    }
+
+    struct ViewBenchmarkSchema : MessageSchema<uint64_t, uint32_t, VarBytes>
+    {
+        enum : size_t { First, Second, Blob };
+    };
+
+    // 큰 메시지에서 필드 두 개만 읽는 핸들러를 흉내 낸다
+    void RunMessageViewBenchmark(const size_t blobSize)
+    {
+        const size_t numIters = Config::numMessageOps;
+        const std::string params = "blob=" + std::to_string(blobSize);
+        const std::vector<std::byte> blob(blobSize);
+
+        Message source;
+        MessageBuilder<ViewBenchmarkSchema> builder(source, blob.size());
+        builder.Set<ViewBenchmarkSchema::First>(1)
+               .Set<ViewBenchmarkSchema::Second>(2)
+               .Write<ViewBenchmarkSchema::Blob>(blob.data(), blob.size());
+
+        uint64_t sum = 0;
+
+        const Nanoseconds viewElapsed = Measure([&source, &sum, numIters]()
+            {
+                for (size_t iter = 0; iter < numIters; ++iter)
+                {
+                    const MessageView<ViewBenchmarkSchema> view(source);
+                    sum += view.Get<ViewBenchmarkSchema::First>() + view.Get<ViewBenchmarkSchema::Second>();
+                }
+            });
+
+        KeepAlive(sum);
+        Reporter::Report("Message.View", params, numIters, viewElapsed);
+
+        // operator>> pops from the back, so the blob is in front of the two fields
+        Message popped;
+        popped.payload = blob;
+        popped << static_cast<uint32_t>(2) << static_cast<uint64_t>(1);
+
+        const size_t numPopIters = numIters / 10;
+
+        const Nanoseconds popElapsed = Measure([&popped, &sum, numPopIters]()
+            {
+                for (size_t iter = 0; iter < numPopIters; ++iter)
+                {
+                    Message msg = popped;
+                    uint64_t first = 0;
+                    uint32_t second = 0;
+                    msg >> first >> second;
+                    sum += first + second;
+                }
+            });
+
+        KeepAlive(sum);
+        Reporter::Report("Message.CopyPop", params, numPopIters, popElapsed);
+    }
+
+    void RunFramingBenchmark(const Framing::Mode mode, const char* modeName)
+    {
+        const size_t numIters = Config::numMessageOps;
+        Framing::HeaderBuffer buffer = {};
+        size_t numBytes = 0;
+
+        const Nanoseconds encodeElapsed = Measure([&buffer, &numBytes, mode, numIters]()
+            {
+                Message::Header header;
+
+                for (size_t iter = 0; iter < numIters; ++iter)
+                {
+                    header.id = static_cast<Message::Id>(iter & 0xFF);
+                    header.size = static_cast<Message::Size>(sizeof(Message::Header) + (iter & 0x3F));
+                    numBytes += Framing::EncodeHeader(mode, header, buffer.data());
+                }
+            });
+
+        KeepAlive(numBytes);
+        Reporter::Report("Framing.Encode", std::string("mode=") + modeName, numIters, encodeElapsed);
+
+        Message::Header header;
+        header.id = 42;
+        header.size = sizeof(Message::Header) + 16;
+
+        const size_t headerSize = Framing::EncodeHeader(mode, header, buffer.data());
+        uint64_t sum = 0;
+
+        const Nanoseconds decodeElapsed = Measure([&buffer, &sum, mode, headerSize, numIters]()
+            {
+                Message::Header decoded;
+                size_t decodedSize = 0;
+
+                for (size_t iter = 0; iter < numIters; ++iter)
+                {
+                    Framing::DecodeHeader(mode, buffer.data(), headerSize, decoded, decodedSize);
+                    sum += decoded.size + decodedSize;
+                }
+            });
+
+        KeepAlive(sum);
+        Reporter::Report("Framing.Decode", std::string("mode=") + modeName, numIters, decodeElapsed);
+    }
+
+    void RunMessageBenchmarks()
+    {
+        RunMessageBenchmark<1>();
+        RunMessageBenchmark<4>();
+        RunMessageBenchmark<16>();
+        RunMessageBenchmark<64>();
+
+        RunMessageViewBenchmark(64);
+        RunMessageViewBenchmark(4096);
+
+        RunFramingBenchmark(Framing::Mode::Fixed, "fixed");
+        RunFramingBenchmark(Framing::Mode::Compact, "compact");
+    }
+}
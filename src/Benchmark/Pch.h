@@ -0,0 +1,5 @@
+﻿#pragma once
+
+#include "Include.h"
+
+using namespace PattyCore;
@@ -0,0 +1,152 @@
+﻿#include "Pch.h"
+#include "Benchmark.h"
+#include "Config.h"
+
+namespace Benchmark
+{
+    namespace
+    {
+        // 게임 서버가 흔히 복제하는 개체 상태
+        struct Entity
+        {
+            uint32_t    id;
+            float       x;
+            float       y;
+            float       z;
+            float       yaw;
+            uint32_t    health;
+            uint32_t    flags;
+            uint32_t    padding;
+        };
+
+        constexpr Replicator::StateId worldStateId = 1;
+    }
+
+    // 세션 한 쌍을 MemoryPipe로 잇고 한 쪽은 Replicator로 개체 목록을 커밋하고 다른 쪽은 ReplicaSet으로 받아 응답한다
+    // 틱마다 numMoving개의 개체가 움직인다, 보낸 쪽 세션의 송신 바이트를 매 틱 스냅숏을 보냈을 때와 비교한다
+    void RunReplicationBenchmark(const size_t numEntities, const size_t numMoving)
+    {
+        ThreadPool socketGroup(2);
+        Replicator replicator;
+        ReplicaSet replicaSet;
+        std::atomic<Replicator::Tick> appliedTick = 0;
+
+        auto [serverPipe, clientPipe] = MemoryPipe::CreatePair(socketGroup.get_executor(), socketGroup.get_executor());
+
+        auto serverContext = std::make_shared<Session::Context>();
+        serverContext->onClosed = [](const ErrCode&, Session::Ptr) {};
+        serverContext->onReceived = [&replicator](Session::MessageBatch&& batch)
+            {
+                for (const Session::OwnedMessage& ownedMsg : batch)
+                {
+                    const MessageView<ReplicaAckSchema> view(ownedMsg.msg);
+
+                    if (view.IsValid())
+                    {
+                        replicator.Acknowledge(view.Get<ReplicaAckSchema::StateId>(), ownedMsg.owner->GetId(), view.Get<ReplicaAckSchema::Tick>());
+                    }
+                }
+            };
+        serverContext->sendPolicy = std::make_shared<Session::SendPolicy>();
+        serverContext->receivePolicy = std::make_shared<Session::ReceivePolicy>();
+        serverContext->clock = std::make_shared<CoarseClock>(socketGroup);
+        serverContext->serviceStats = std::make_shared<ServiceStats>();
+
+        // The same steps ServiceBase takes for a replica update
+        auto clientContext = std::make_shared<Session::Context>(*serverContext);
+        clientContext->onReceived = [&replicaSet, &appliedTick](Session::MessageBatch&& batch)
+            {
+                for (const Session::OwnedMessage& ownedMsg : batch)
+                {
+                    Replicator::StateId stateId = 0;
+                    const Replicator::Tick tick = replicaSet.Apply(ownedMsg.owner->GetId(), ownedMsg.msg, stateId);
+
+                    if (tick == 0)
+                    {
+                        continue;
+                    }
+
+                    Message ack;
+                    ack.header.id = static_cast<Message::Id>(Message::SystemId::ReplicaAck);
+
+                    MessageBuilder<ReplicaAckSchema> builder(ack);
+                    builder.Set<ReplicaAckSchema::StateId>(stateId)
+                           .Set<ReplicaAckSchema::Tick>(tick);
+
+                    ownedMsg.owner->SendConflatedAsync(std::move(ack), Replicator::ackKeyBegin | stateId, Session::Priority::Control);
+                    appliedTick.store(tick);
+                }
+            };
+
+        Session::Ptr server = Session::Create(Transport(serverPipe), 0, asio::make_strand(socketGroup), serverContext);
+        Session::Ptr client = Session::Create(Transport(clientPipe), 1, asio::make_strand(socketGroup), clientContext);
+
+        replicator.Register(worldStateId);
+        replicator.Subscribe(worldStateId, server);
+
+        std::vector<Entity> entities(numEntities);
+
+        for (size_t idx = 0; idx < numEntities; ++idx)
+        {
+            entities[idx] = Entity{ static_cast<uint32_t>(idx), idx * 1.0f, 0.0f, idx * 2.0f, 0.0f, 100, 0, 0 };
+        }
+
+        std::mt19937 engine(7);
+        const size_t stateSize = numEntities * sizeof(Entity);
+
+        const Nanoseconds elapsed = Measure([&]()
+            {
+                for (size_t tick = 1; tick <= Config::numReplicationTicks; ++tick)
+                {
+                    for (size_t moved = 0; moved < numMoving; ++moved)
+                    {
+                        Entity& entity = entities[engine() % numEntities];
+                        entity.x += 0.5f;
+                        entity.z -= 0.25f;
+                        entity.yaw += 0.1f;
+                    }
+
+                    replicator.Commit(worldStateId, reinterpret_cast<const std::byte*>(entities.data()), stateSize);
+
+                    // Paced like a server tick, the peer applies each update before the next one
+                    while (appliedTick.load() < tick)
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+
+        std::vector<std::byte> replica;
+        Replicator::Tick tick = 0;
+
+        if (!replicaSet.Read(client->GetId(), worldStateId, replica, tick) ||
+            (replica.size() != stateSize) ||
+            (std::memcmp(replica.data(), entities.data(), stateSize) != 0))
+        {
+            std::cerr << "[BENCHMARK] Replication replica diverged at tick " << tick << "\n";
+        }
+
+        const std::string params = "entities=" + std::to_string(numEntities) + ",moving=" + std::to_string(numMoving);
+        const size_t snapshotSize = sizeof(Message::Header) + ReplicaSnapshotSchema::CalculatePayloadSize(stateSize);
+
+        Reporter::Report("Replication.Tick", params, Config::numReplicationTicks, elapsed);
+        Reporter::ReportMemory("Replication.Egress", params + ",delta=0", Config::numReplicationTicks, static_cast<int64_t>(snapshotSize * Config::numReplicationTicks));
+        Reporter::ReportMemory("Replication.Egress", params + ",delta=1", Config::numReplicationTicks, static_cast<int64_t>(server->GetStats().bytesOut));
+
+        server->Close();
+        client->Close();
+        server = nullptr;
+        client = nullptr;
+        socketGroup.join();
+    }
+
+    void RunReplicationBenchmarks()
+    {
+        for (const size_t numMoving : { 1, 16, 128 })
+        {
+            RunReplicationBenchmark(1'024, numMoving);
+        }
+
+        RunReplicationBenchmark(16'384, 256);
+    }
+}
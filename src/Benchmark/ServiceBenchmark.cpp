@@ -0,0 +1,717 @@
+﻿#include "Pch.h"
+#include "Benchmark.h"
+#include "Config.h"
+
+namespace Benchmark
+{
+    /*---------------*
+     *    Sockets    *
+     *---------------*/
+
+    // 루프백으로 연결된 소켓 쌍을 만든다
+    StreamSocket ConnectPair(ThreadPool& serverPool, Tcp::acceptor& acceptor, Tcp::socket& client)
+    {
+        Tcp::socket server(serverPool);
+
+        client.connect(Tcp::endpoint(asio::ip::address_v4::loopback(), acceptor.local_endpoint().port()));
+        acceptor.accept(server);
+
+        return StreamSocket(std::move(server));
+    }
+
+    // 콜백이 아무것도 하지 않는 세션 컨텍스트
+    Session::Context::Ptr CreateSessionContext(ThreadPool& socketGroup, Session::OnReceived onReceived, const bool lean)
+    {
+        auto context = std::make_shared<Session::Context>();
+        context->onClosed = [](const ErrCode&, Session::Ptr) {};
+        context->onReceived = std::move(onReceived);
+        context->sendPolicy = std::make_shared<Session::SendPolicy>();
+        context->receivePolicy = std::make_shared<Session::ReceivePolicy>();
+        context->clock = std::make_shared<CoarseClock>(socketGroup);
+        context->serviceStats = std::make_shared<ServiceStats>();
+        context->lean = lean;
+
+        return context;
+    }
+
+    /*----------------*
+     *    Dispatch    *
+     *----------------*/
+
+    // ServiceBase::DispatchReceivedMessage와 같은 형태로 메시지 스레드 그룹에 게시한다
+    // profiler가 있으면 핸들러마다 HandlerProfiler::Scope를 씌워서 프로파일링 비용까지 잰다
+    template<typename TPool>
+    void RunDispatchBenchmark(const char* name, const std::string& params, const size_t numThreads, HandlerProfiler* profiler = nullptr)
+    {
+        TPool messageGroup(numThreads);
+        std::atomic<size_t> numHandled = 0;
+
+        const Nanoseconds elapsed = Measure([&messageGroup, &numHandled, profiler]()
+            {
+                for (size_t op = 0; op < Config::numDispatchOps; ++op)
+                {
+                    Session::OwnedMessage ownedMsg;
+                    ownedMsg.msg.header.id = static_cast<Message::Id>(op % 16);
+                    ownedMsg.msg << static_cast<uint32_t>(op);
+
+                    asio::post(messageGroup,
+                               [&numHandled, profiler, ownedMsg = std::move(ownedMsg)]() mutable
+                               {
+                                   HandlerProfiler::Scope profile(profiler, ownedMsg);
+                                   KeepAlive(ownedMsg.msg.header.size);
+                                   numHandled.fetch_add(1, std::memory_order_relaxed);
+                               });
+                }
+
+                while (numHandled.load() < Config::numDispatchOps)
+                {
+                    std::this_thread::yield();
+                }
+            });
+
+        messageGroup.stop();
+        messageGroup.join();
+        Reporter::Report(name, params + "threads=" + std::to_string(numThreads), Config::numDispatchOps, elapsed);
+    }
+
+    void RunDispatchBenchmarks()
+    {
+        ThreadPool timerGroup(1);
+
+        for (size_t numThreads = 1; numThreads <= Config::maxThreads; numThreads *= 2)
+        {
+            RunDispatchBenchmark<ThreadPool>("Dispatch.Post", "", numThreads);
+            RunDispatchBenchmark<WorkStealingPool>("Dispatch.Steal", "", numThreads);
+
+            for (const bool measuresCpuTime : { false, true })
+            {
+                HandlerProfiler::Config config;
+                config.measuresCpuTime = measuresCpuTime;
+
+                HandlerProfiler profiler(timerGroup, config);
+                profiler.Start();
+
+                const std::string params = std::string("cpu=") + (measuresCpuTime ? "1" : "0") + ",";
+                RunDispatchBenchmark<WorkStealingPool>("Dispatch.Profiled", params, numThreads, &profiler);
+            }
+        }
+
+        timerGroup.join();
+    }
+
+    /*---------------*
+     *    Session    *
+     *---------------*/
+
+    // 미리 직렬화한 프레임을 한 소켓에 쏟아붓고 세션이 모두 읽어낼 때까지 측정한다
+    // checksum이면 ChecksumSwitch 뒤로 모든 프레임에 CRC32C를 붙여서 검사 비용까지 잰다
+    void RunSessionFramingBenchmark(const size_t payloadSize, const bool checksum)
+    {
+        ThreadPool socketGroup(1);
+        asio::io_context clientContext;
+        Tcp::acceptor acceptor(clientContext, Tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+        Tcp::socket client(clientContext);
+
+        std::atomic<size_t> numReceived = 0;
+        std::promise<void> received;
+
+        auto onReceived = [&numReceived, &received](Session::MessageBatch&& batch)
+            {
+                // The session expects the receiver to take the messages
+                Session::MessageBatch consumed = std::move(batch);
+                const size_t numMsgs = consumed.size();
+
+                if (numReceived.fetch_add(numMsgs) + numMsgs == Config::numFramingMsgs)
+                {
+                    received.set_value();
+                }
+            };
+
+        Session::Ptr session = Session::Create(ConnectPair(socketGroup, acceptor, client),
+                                               0,
+                                               asio::make_strand(socketGroup),
+                                               CreateSessionContext(socketGroup, std::move(onReceived), false));
+
+        Message msg;
+        msg.payload.resize(payloadSize);
+        msg.header.size = static_cast<Message::Size>(msg.CalculateSize());
+
+        const std::byte* header = reinterpret_cast<const std::byte*>(&msg.header);
+        Framing::ChecksumBuffer trailer = {};
+        std::vector<std::byte> frames;
+
+        if (checksum)
+        {
+            Message marker;
+            marker.header.id = static_cast<Message::Id>(Message::SystemId::ChecksumSwitch);
+
+            const std::byte* markerHeader = reinterpret_cast<const std::byte*>(&marker.header);
+            frames.insert(frames.end(), markerHeader, markerHeader + sizeof(Message::Header));
+
+            Framing::EncodeChecksum(header, sizeof(Message::Header), msg.payload.data(), msg.payload.size(), trailer.data());
+        }
+
+        const size_t trailerSize = checksum ? trailer.size() : 0;
+        frames.reserve(frames.size() + (msg.CalculateSize() + trailerSize) * Config::numFramingMsgs);
+
+        for (size_t idx = 0; idx < Config::numFramingMsgs; ++idx)
+        {
+            frames.insert(frames.end(), header, header + sizeof(Message::Header));
+            frames.insert(frames.end(), msg.payload.begin(), msg.payload.end());
+            frames.insert(frames.end(), trailer.begin(), trailer.begin() + trailerSize);
+        }
+
+        const Nanoseconds elapsed = Measure([&client, &frames, &received]()
+            {
+                asio::write(client, asio::buffer(frames));
+                received.get_future().wait();
+            });
+
+        const std::string params = "payload=" + std::to_string(payloadSize) + ",checksum=" + (checksum ? "1" : "0");
+        Reporter::Report("Session.Framing", params, Config::numFramingMsgs, elapsed);
+
+        session->Close();
+        session = nullptr;
+        socketGroup.join();
+    }
+
+    // MemoryPipe로 연결한 끝을 세션으로 감싸기 전후에 할당된 힙 바이트 차이로 유휴 세션 하나의 비용을 잰다
+    // 파일 디스크립터 없이 numSessions개를 모두 만들 수 있고 커널 소켓 버퍼는 포함하지 않는다
+    void RunSessionFootprintBenchmark(const size_t numSessions, const bool lean)
+    {
+        const std::string params = "sessions=" + std::to_string(numSessions) + ",lean=" + (lean ? "1" : "0");
+
+        ThreadPool socketGroup(1);
+        asio::io_context clientContext;
+        std::vector<MemoryPipe::Ptr> serverEnds;
+        std::vector<MemoryPipe::Ptr> clientEnds;
+        serverEnds.reserve(numSessions);
+        clientEnds.reserve(numSessions);
+
+        for (size_t idx = 0; idx < numSessions; ++idx)
+        {
+            auto [serverEnd, clientEnd] = MemoryPipe::CreatePair(socketGroup.get_executor(), clientContext.get_executor());
+            serverEnds.push_back(std::move(serverEnd));
+            clientEnds.push_back(std::move(clientEnd));
+        }
+
+        Session::Context::Ptr context = CreateSessionContext(socketGroup, [](Session::MessageBatch&&) {}, lean);
+        std::vector<Session::Ptr> sessions;
+        sessions.reserve(numSessions);
+
+        int64_t numAllocated = 0;
+
+        {
+            AllocationWindow window;
+            const int64_t allocatedBefore = GetAllocatedBytes();
+
+            for (size_t idx = 0; idx < numSessions; ++idx)
+            {
+                sessions.push_back(Session::Create(Transport(std::move(serverEnds[idx])),
+                                                   static_cast<Session::Id>(idx),
+                                                   asio::make_strand(socketGroup),
+                                                   context));
+            }
+
+            // With one socket thread the first reads have all started once this runs
+            std::promise<void> started;
+
+            asio::post(socketGroup,
+                       [&started]()
+                       {
+                           started.set_value();
+                       });
+
+            started.get_future().wait();
+
+            numAllocated = GetAllocatedBytes() - allocatedBefore;
+        }
+
+        const size_t numOpen = std::count_if(sessions.begin(), sessions.end(),
+                                             [](const Session::Ptr& session)
+                                             {
+                                                 return !session->IsClosed();
+                                             });
+
+        // A per-session figure over fewer sessions than asked for would look valid but mean something else
+        if (numOpen != numSessions)
+        {
+            throw std::runtime_error("Session.Footprint " + params + ": only " + std::to_string(numOpen) + " sessions open");
+        }
+
+        Reporter::ReportMemory("Session.Footprint", params, numSessions, numAllocated);
+
+        for (const Session::Ptr& session : sessions)
+        {
+            session->Close();
+        }
+
+        sessions.clear();
+        socketGroup.join();
+    }
+
+    // 읽지 않는 상대에게 numKeys개의 키를 돌아가며 갱신하다가 읽기 시작해서 모든 키의 마지막 값을 받을 때까지 측정한다
+    // 쌓인 바이트는 상대가 마지막 값을 받기까지 읽어야 했던 양이다
+    void RunSessionConflationBenchmark(const size_t numKeys, const bool conflate)
+    {
+        ThreadPool socketGroup(1);
+        asio::io_context clientContext;
+        Tcp::acceptor acceptor(clientContext, Tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+        Tcp::socket client(clientContext);
+
+        Session::Ptr session = Session::Create(ConnectPair(socketGroup, acceptor, client),
+                                               0,
+                                               asio::make_strand(socketGroup),
+                                               CreateSessionContext(socketGroup, [](Session::MessageBatch&&) {}, false));
+
+        const size_t numUpdates = Config::numConflationUpdates;
+        const size_t frameSize = sizeof(Message::Header) + sizeof(uint64_t) * 2;
+        std::vector<std::byte> frames(frameSize * 4096);
+        size_t numBytesRead = 0;
+
+        const Nanoseconds elapsed = Measure([&]()
+            {
+                for (uint64_t update = 0; update < numUpdates; ++update)
+                {
+                    const uint64_t key = update % numKeys;
+
+                    Message msg;
+                    msg << key << update;
+
+                    if (conflate)
+                    {
+                        session->SendConflatedAsync(std::move(msg), key);
+                    }
+                    else
+                    {
+                        session->SendAsync(std::move(msg));
+                    }
+                }
+
+                // Every key is fresh once its update from the last round arrives
+                const uint64_t lastRound = numUpdates - numKeys;
+                size_t numFresh = 0;
+                size_t numPending = 0;
+
+                while (numFresh < numKeys)
+                {
+                    numPending += client.read_some(asio::buffer(frames.data() + numPending, frames.size() - numPending));
+
+                    const size_t numFrames = numPending / frameSize;
+
+                    for (size_t idx = 0; idx < numFrames; ++idx)
+                    {
+                        uint64_t update = 0;
+                        std::memcpy(&update, frames.data() + idx * frameSize + sizeof(Message::Header) + sizeof(uint64_t), sizeof(update));
+
+                        numFresh += (update >= lastRound) ? 1 : 0;
+                    }
+
+                    numBytesRead += numFrames * frameSize;
+                    numPending -= numFrames * frameSize;
+                    std::memmove(frames.data(), frames.data() + numFrames * frameSize, numPending);
+                }
+            });
+
+        const std::string params = "keys=" + std::to_string(numKeys) + ",conflate=" + (conflate ? "1" : "0");
+        Reporter::Report("Session.Conflation", params, numUpdates, elapsed);
+        Reporter::ReportMemory("Session.Conflation.Backlog", params, numUpdates, static_cast<int64_t>(numBytesRead));
+
+        session->Close();
+        session = nullptr;
+        socketGroup.join();
+    }
+
+    void RunSessionBenchmarks()
+    {
+        for (const size_t payloadSize : { 0, 16, 256, 4096 })
+        {
+            RunSessionFramingBenchmark(payloadSize, false);
+            RunSessionFramingBenchmark(payloadSize, true);
+        }
+
+        for (const size_t numKeys : { 16, 1'024 })
+        {
+            RunSessionConflationBenchmark(numKeys, false);
+            RunSessionConflationBenchmark(numKeys, true);
+        }
+
+        Reporter::ReportMemory("Session.Sizeof", "", 1, sizeof(Session));
+
+        for (const size_t numSessions : { static_cast<size_t>(1'000), Config::numFootprintSessions })
+        {
+            RunSessionFootprintBenchmark(numSessions, false);
+            RunSessionFootprintBenchmark(numSessions, true);
+        }
+    }
+
+    /*-----------------*
+     *    Broadcast    *
+     *-----------------*/
+
+    class BroadcastService : public ServiceBase
+    {
+    public:
+        using ServiceBase::ServiceBase;
+        using ServiceBase::CreateSession;
+        using ServiceBase::BroadcastMessageAsync;
+        using ServiceBase::ForEachSessionParallel;
+        using ServiceBase::UpdateInterest;
+
+        // PublishNearbyAsync는 태스크 스레드로 넘기므로 발행 자체의 비용은 그리드에서 바로 잰다
+        size_t PublishNearby(const InterestGrid::Position& position, const Message& msg)
+        {
+            return mInterestGrid.Publish(position, msg, -1);
+        }
+
+        ThreadPool& GetSocketGroup()
+        {
+            return mThreadPoolGroup.GetSocketGroup();
+        }
+
+        // 세션 스트랜드에 앞서 게시된 작업이 모두 끝날 때까지 기다린다
+        void Flush()
+        {
+            std::promise<void> flushed;
+
+            asio::post(mSessionStrand,
+                       [&flushed]()
+                       {
+                           flushed.set_value();
+                       });
+
+            flushed.get_future().wait();
+        }
+
+        size_t GetNumSessions()
+        {
+            std::promise<size_t> numSessions;
+
+            asio::post(mSessionStrand,
+                       [this, &numSessions]()
+                       {
+                           numSessions.set_value(mSessionMap.size());
+                       });
+
+            return numSessions.get_future().get();
+        }
+    };
+
+    void RunBroadcastBenchmark(const size_t numSessions)
+    {
+        const ServiceBase::ThreadPoolGroup::Info info = { 4, 1, 1, 4, 0, BusyPoller::Config() };
+        BroadcastService service(info);
+
+        asio::io_context clientContext;
+        Tcp::acceptor acceptor(clientContext, Tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+        std::vector<Tcp::socket> clients;
+        std::vector<Session::Ptr> sessions;
+        clients.reserve(numSessions);
+        sessions.reserve(numSessions);
+
+        try
+        {
+            for (size_t idx = 0; idx < numSessions; ++idx)
+            {
+                clients.emplace_back(clientContext);
+                sessions.push_back(service.CreateSession(ConnectPair(service.GetSocketGroup(), acceptor, clients.back())));
+            }
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "[BENCHMARK] Broadcast sessions=" << numSessions << " skipped: " << e.what() << "\n";
+
+            service.Stop();
+            service.Join();
+
+            return;
+        }
+
+        while (service.GetNumSessions() < numSessions)
+        {
+            std::this_thread::yield();
+        }
+
+        const Nanoseconds elapsed = Measure([&service]()
+            {
+                for (size_t idx = 0; idx < Config::numBroadcasts; ++idx)
+                {
+                    Message msg;
+                    service.BroadcastMessageAsync(std::move(msg));
+                }
+
+                service.Flush();
+            });
+
+        Reporter::Report("ServiceBase.Broadcast", "sessions=" + std::to_string(numSessions), Config::numBroadcasts, elapsed);
+
+        std::atomic<uint64_t> sum = 0;
+
+        // 월드 틱처럼 세션마다 가벼운 작업을 하는 순회를 반복한다
+        const Nanoseconds forEachElapsed = Measure([&service, &sum]()
+            {
+                for (size_t idx = 0; idx < Config::numBroadcasts; ++idx)
+                {
+                    std::promise<void> done;
+
+                    service.ForEachSessionParallel([&sum](const Session::Ptr& session)
+                                                   {
+                                                       sum.fetch_add(session->GetStats().messagesOut, std::memory_order_relaxed);
+                                                   },
+                                                   [&done]()
+                                                   {
+                                                       done.set_value();
+                                                   });
+
+                    done.get_future().wait();
+                }
+            });
+
+        KeepAlive(sum.load());
+        Reporter::Report("ServiceBase.ForEachParallel", "sessions=" + std::to_string(numSessions), Config::numBroadcasts, forEachElapsed);
+
+        // 세션 밀도가 일정하도록 월드 크기를 세션 수에 맞추고, 무작위 위치에서 발행한다
+        const float worldSize = std::sqrt(static_cast<float>(numSessions)) * Config::nearbySpacing;
+        std::mt19937 engine(7);
+        std::uniform_real_distribution<float> coord(0.0f, worldSize);
+
+        for (const Session::Ptr& session : sessions)
+        {
+            service.UpdateInterest(session, { coord(engine), coord(engine) }, Config::nearbyRadius);
+        }
+
+        std::vector<InterestGrid::Position> positions(Config::numNearbyPublishes);
+
+        for (InterestGrid::Position& position : positions)
+        {
+            position = { coord(engine), coord(engine) };
+        }
+
+        auto publishAll = [&service, &positions]()
+            {
+                const Message msg;
+
+                for (const InterestGrid::Position& position : positions)
+                {
+                    service.PublishNearby(position, msg);
+                }
+            };
+
+        Reporter::Report("InterestGrid.Publish", "sessions=" + std::to_string(numSessions) + ",movers=0", Config::numNearbyPublishes, Measure(publishAll));
+
+        // 다른 스레드가 세션들을 계속 움직이는 동안 발행한다, 잠금이 영역별로 나뉘어 있으면 서로 거의 막지 않는다
+        std::atomic<bool> moving = true;
+
+        std::thread mover([&service, &sessions, &moving, worldSize]()
+            {
+                std::mt19937 moverEngine(11);
+                std::uniform_real_distribution<float> moverCoord(0.0f, worldSize);
+                size_t idx = 0;
+
+                while (moving.load(std::memory_order_relaxed))
+                {
+                    service.UpdateInterest(sessions[idx], { moverCoord(moverEngine), moverCoord(moverEngine) }, Config::nearbyRadius);
+                    idx = (idx + 1) % sessions.size();
+                }
+            });
+
+        const Nanoseconds movingElapsed = Measure(publishAll);
+
+        moving = false;
+        mover.join();
+
+        Reporter::Report("InterestGrid.Publish", "sessions=" + std::to_string(numSessions) + ",movers=1", Config::numNearbyPublishes, movingElapsed);
+
+        sessions.clear();
+
+        service.Stop();
+        service.Join();
+    }
+
+    void RunBroadcastBenchmarks()
+    {
+        RunBroadcastBenchmark(10);
+        RunBroadcastBenchmark(1'000);
+        RunBroadcastBenchmark(10'000);
+    }
+
+    /*----------------*
+     *    Loopback    *
+     *----------------*/
+
+    // 받은 메시지를 그대로 돌려보낸다
+    class EchoServerService : public ServerServiceBase
+    {
+    public:
+        using ServerServiceBase::ServerServiceBase;
+
+    protected:
+        void OnMessageReceived(OwnedMessage ownedMsg) override
+        {
+            ownedMsg.owner->SendAsync(std::move(ownedMsg.msg));
+        }
+    };
+
+    // 등록된 세션마다 메시지를 하나 보내고 돌아온 응답을 센다
+    class EchoClientService : public ClientServiceBase
+    {
+    public:
+        using ClientServiceBase::ClientServiceBase;
+
+        size_t GetNumReplies() const
+        {
+            return mNumReplies.load();
+        }
+
+    protected:
+        void OnSessionRegistered(Session::Ptr session) override
+        {
+            Message msg;
+            msg << static_cast<uint32_t>(session->GetId());
+
+            session->SendAsync(std::move(msg));
+        }
+
+        void OnMessageReceived(OwnedMessage /*ownedMsg*/) override
+        {
+            mNumReplies.fetch_add(1);
+        }
+
+    private:
+        std::atomic<size_t>     mNumReplies = 0;
+    };
+
+    // 커널 소켓 없이 서버와 클라이언트 서비스를 MemoryPipe로 잇고 세션마다 한 번 왕복한다
+    void RunLoopbackBenchmark(const size_t numSessions)
+    {
+        const ServiceBase::ThreadPoolGroup::Info info = { 2, 1, 2, 1, 0, BusyPoller::Config() };
+        EchoServerService server(info, 0);
+        EchoClientService client(info);
+
+        server.Start();
+
+        const Nanoseconds elapsed = Measure([&server, &client, numSessions]()
+            {
+                client.ConnectLoopback(server, numSessions);
+
+                while (client.GetNumReplies() < numSessions)
+                {
+                    std::this_thread::sleep_for(Milliseconds(1));
+                }
+            });
+
+        Reporter::Report("Loopback.ConnectEcho", "sessions=" + std::to_string(numSessions), numSessions, elapsed);
+
+        client.Stop();
+        server.Stop();
+        client.Join();
+        server.Join();
+    }
+
+    // 응답을 받으면 다음 핑을 보내서 한 번에 하나씩 왕복한다
+    class PingClientService : public ClientServiceBase
+    {
+    public:
+        using ClientServiceBase::ClientServiceBase;
+
+        Session::Ptr WaitSession()
+        {
+            MutexULock lock(mLock);
+            mCondition.wait(lock, [this]() { return mSession != nullptr; });
+
+            return mSession;
+        }
+
+        void Ping(const size_t numPings)
+        {
+            mNumPings = numPings;
+            mNumReplies.store(0);
+
+            Message msg;
+            msg << static_cast<uint32_t>(0);
+
+            mSession->SendAsync(std::move(msg));
+        }
+
+        size_t GetNumReplies() const
+        {
+            return mNumReplies.load();
+        }
+
+    protected:
+        void OnSessionRegistered(Session::Ptr session) override
+        {
+            MutexLockGrd lock(mLock);
+            mSession = std::move(session);
+            mCondition.notify_all();
+        }
+
+        void OnMessageReceived(OwnedMessage ownedMsg) override
+        {
+            if (mNumReplies.fetch_add(1) + 1 < mNumPings)
+            {
+                ownedMsg.owner->SendAsync(std::move(ownedMsg.msg));
+            }
+        }
+
+    private:
+        Mutex                   mLock;
+        std::condition_variable mCondition;
+        Session::Ptr            mSession;
+
+        size_t                  mNumPings = 0;
+        std::atomic<size_t>     mNumReplies = 0;
+    };
+
+    // 커널 루프백 TCP로 한 세션이 핑을 하나씩 주고받는다, 양쪽 소켓 스레드가 spinInterval 동안 폴링한다
+    // 왕복 시간과 그동안 프로세스가 쓴 CPU 시간을 한 줄에 왕복당으로 기록해서 지연 시간과 CPU를 맞바꾼 정도를 본다
+    void RunPingBenchmark(const Microseconds spinInterval)
+    {
+        const ServiceBase::ThreadPoolGroup::Info info = { 1, 1, 1, 1, 0, { spinInterval, Microseconds(0) } };
+
+        EchoServerService server(info, Config::pingPort);
+        PingClientService client(info);
+
+        server.Start();
+        client.Start("127.0.0.1", std::to_string(Config::pingPort), 1);
+        client.WaitSession();
+
+        const Nanoseconds cpuStart = ReadProcessCpuTime();
+
+        const Nanoseconds elapsed = Measure([&client]()
+            {
+                client.Ping(Config::numPings);
+
+                while (client.GetNumReplies() < Config::numPings)
+                {
+                    std::this_thread::sleep_for(Milliseconds(1));
+                }
+            });
+
+        const Nanoseconds cpuElapsed = ReadProcessCpuTime() - cpuStart;
+        // The backend is fixed at build time, so each build reports under its own name
+        const std::string params = std::string("io=") + ServiceBase::GetIoBackend() + ",spinUs=" + std::to_string(spinInterval.count());
+
+        // nsPerOp is the round trip, cpuNsPerOp what it cost, compare both across spinUs
+        Reporter::ReportCpuCost("Ping.RoundTrip", params, Config::numPings, elapsed, cpuElapsed);
+
+        client.Stop();
+        server.Stop();
+        client.Join();
+        server.Join();
+    }
+
+    void RunLoopbackBenchmarks()
+    {
+        RunLoopbackBenchmark(1'000);
+        RunLoopbackBenchmark(Config::numLoopbackSessions);
+    }
+
+    void RunPingBenchmarks()
+    {
+        for (const int64_t spinUs : { 0, 50, 1'000 })
+        {
+            RunPingBenchmark(Microseconds(spinUs));
+        }
+    }
+}
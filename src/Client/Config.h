@@ -7,6 +7,13 @@ namespace Client::Config
     constexpr uint8_t numMessageThreads = 4;
     constexpr uint8_t numTaskThreads = 3;
 
+    // 0이 아니면 소켓 스레드마다 코어 하나를 써서 수신 뒤 이 시간 동안 커널에서 잠들지 않고 폴링한다
+    constexpr uint32_t socketSpinUs = 0;
+    constexpr uint32_t socketBusyPollUs = 0;
+
     constexpr const char* host = "127.0.0.1";
     constexpr const char* service = "60000";
+
+    // 연결이 끊기면 같은 세션으로 다시 연결한다
+    constexpr bool resumesSessions = true;
 }
@@ -19,6 +19,8 @@ int main()
             Config::numSessionThreads,
             Config::numMessageThreads,
             Config::numTaskThreads,
+            0,
+            { Microseconds(Config::socketSpinUs), Microseconds(Config::socketBusyPollUs) },
         };
 
         Service service(info);
@@ -1,6 +1,7 @@
 ﻿#include "Pch.h"
 #include "Service.h"
 #include "MessageId.h"
+#include "Config.h"
 #include <Server/MessageId.h>
 
 namespace Client
@@ -10,7 +11,15 @@ namespace Client
     Service::Service(const ThreadPoolGroup::Info& info)
         : ClientServiceBase(info)
         , mPingTimerStrand(asio::make_strand(mThreadPoolGroup.GetTaskGroup()))
-    {}
+        , mSecondTimer(mThreadPoolGroup.GetTaskGroup())
+    {
+        mSendPolicy->priorities[static_cast<Message::Id>(MessageId::Ping)] = Session::Priority::Control;
+        mSendPolicy->allowsCompactFraming = true;
+        mSendPolicy->allowsFrameChecksum = true;
+        mResumesSessions = Config::resumesSessions;
+
+        WaitSecondAsync();
+    }
 
     void Service::OnSessionRegistered(Session::Ptr session)
     {
@@ -55,7 +64,7 @@ namespace Client
             return;
         }
 
-        mPingTimerMap[id]->start = std::chrono::steady_clock::now();
+        mPingTimerMap[id]->start = Clock::now();
 
         Message msg;
         msg.header.id = static_cast<Message::Id>(MessageId::Ping);
@@ -67,10 +76,18 @@ namespace Client
     {
         const Session::Id id = session->GetId();
 
-        TimePoint end = std::chrono::steady_clock::now();
+        TimePoint end = Clock::now();
 
         auto elapsed = std::chrono::duration_cast<Microseconds>(end - mPingTimerMap[id]->start);
 
+        const uint64_t elapsedUs = static_cast<uint64_t>(elapsed.count());
+        uint64_t maxPingUs = mMaxPingUs.load();
+
+        while ((elapsedUs > maxPingUs) && !mMaxPingUs.compare_exchange_weak(maxPingUs, elapsedUs));
+
+        mNumPings.fetch_add(1);
+        mTotalPingUs.fetch_add(elapsedUs);
+
         asio::post(mPingTimerStrand,
                    [this, session]() mutable
                    {
@@ -118,6 +135,38 @@ namespace Client
                    });
     }
 
+    void Service::WaitSecondAsync()
+    {
+        mSecondTimer.expires_after(1s);
+        mSecondTimer.async_wait([this](const ErrCode& errCode)
+                                {
+                                    OnSecondElapsed(errCode);
+                                });
+    }
+
+    void Service::OnSecondElapsed(const ErrCode& errCode)
+    {
+        if (errCode)
+        {
+            std::cerr << "[CLIENT] Failed to wait a second: " << errCode << "\n";
+            return;
+        }
+
+        const uint32_t numPings = mNumPings.exchange(0);
+        const uint64_t totalPingUs = mTotalPingUs.exchange(0);
+        const uint64_t maxPingUs = mMaxPingUs.exchange(0);
+        WaitSecondAsync();
+
+        if (numPings == 0)
+        {
+            return;
+        }
+
+        std::cout << "[CLIENT] Pings: " << numPings << "/s, "
+                  << "avg: " << (totalPingUs / numPings) << "us, "
+                  << "max: " << maxPingUs << "us (io: " << GetIoBackend() << ")\n";
+    }
+
     Service::PingTimer::PingTimer(const Session::Id id, ThreadPool& taskGroup)
         : id(id)
         , timer(taskGroup)
@@ -22,6 +22,8 @@ namespace Client
         void WaitPingTimerAsync(Session::Ptr session);
         void OnPingTimerExpired(const ErrCode& errCode, Session::Ptr session);
         void PingAsync(Session::Ptr session);
+        void WaitSecondAsync();
+        void OnSecondElapsed(const ErrCode& errCode);
 
     private:
         /*-----------------*
@@ -45,5 +47,11 @@ namespace Client
         PingTimer::Map      mPingTimerMap;
         Strand              mPingTimerStrand;
 
+        // 초당 핑 통계, 입출력 백엔드 간 비교에 사용한다
+        Timer                   mSecondTimer;
+        std::atomic<uint32_t>   mNumPings = 0;
+        std::atomic<uint64_t>   mTotalPingUs = 0;
+        std::atomic<uint64_t>   mMaxPingUs = 0;
+
     };
 }
@@ -0,0 +1,127 @@
+﻿#include "Pch.h"
+#include "BusyPoller.h"
+
+namespace PattyCore
+{
+    namespace
+    {
+        // Spinners that never park still publish their spin time about this often
+        constexpr int64_t spinFlushNs = 1'000'000;
+    }
+
+    BusyPoller::BusyPoller(ThreadPool& socketGroup, const size_t numSpinners, const Config& config)
+        : mSocketGroup(socketGroup)
+        , mConfig(config)
+        , mNumSpinners(numSpinners)
+        , mSpinNs(std::chrono::duration_cast<Nanoseconds>(config.spinInterval).count())
+        , mMarkGranularity(std::max<int64_t>(mSpinNs / 8, 1'000))
+    {}
+
+    void BusyPoller::Start()
+    {
+        const int64_t now = SteadyNowNs();
+        mLastActive.store(now);
+
+        for (size_t idx = 0; idx < mNumSpinners; ++idx)
+        {
+            PostSpin(now);
+        }
+
+        std::cout << "[POLL] Started: " << mNumSpinners << " spinners, "
+                  << mConfig.spinInterval.count() << "us after the last read\n";
+    }
+
+    void BusyPoller::Stop()
+    {
+        mStopped.store(true);
+    }
+
+    void BusyPoller::ApplySocketOptions(Transport& transport)
+    {
+        if (mConfig.socketBusyPoll.count() == 0)
+        {
+            return;
+        }
+
+        ErrCode errCode;
+        transport.SetBusyPoll(mConfig.socketBusyPoll, errCode);
+
+        // Raising SO_BUSY_POLL above net.core.busy_read needs CAP_NET_ADMIN, every socket would fail the same way
+        if (errCode && !mWarnedSocketOption.exchange(true))
+        {
+            std::cerr << "[POLL] Failed to set SO_BUSY_POLL: " << errCode << "\n";
+        }
+    }
+
+    BusyPollStats BusyPoller::GetStats() const
+    {
+        BusyPollStats stats;
+        stats.numSpinners = static_cast<uint32_t>(mNumSpinners);
+        stats.numParked = static_cast<uint32_t>(mNumParked.load(std::memory_order_relaxed));
+        stats.spinNs = mSpinNsTotal.load(std::memory_order_relaxed);
+        stats.numParks = mNumParks.load(std::memory_order_relaxed);
+        stats.numWakes = mNumWakes.load(std::memory_order_relaxed);
+
+        return stats;
+    }
+
+    void BusyPoller::Wake()
+    {
+        const size_t numParked = mNumParked.exchange(0);
+
+        if (numParked == 0)
+        {
+            return;
+        }
+
+        mNumWakes.fetch_add(1, std::memory_order_relaxed);
+
+        const int64_t now = SteadyNowNs();
+
+        for (size_t idx = 0; idx < numParked; ++idx)
+        {
+            PostSpin(now);
+        }
+    }
+
+    void BusyPoller::PostSpin(const int64_t spinStart)
+    {
+        asio::post(mSocketGroup,
+                   [self = shared_from_this(), spinStart]()
+                   {
+                       self->Spin(spinStart);
+                   });
+    }
+
+    void BusyPoller::Spin(int64_t spinStart)
+    {
+        const int64_t now = SteadyNowNs();
+
+        if (mStopped.load(std::memory_order_relaxed) || (now - mLastActive.load(std::memory_order_relaxed) > mSpinNs))
+        {
+            mSpinNsTotal.fetch_add(now - spinStart, std::memory_order_relaxed);
+
+            if (!mStopped.load(std::memory_order_relaxed))
+            {
+                mNumParks.fetch_add(1, std::memory_order_relaxed);
+
+                // A read that lands between the check above and this increment does not wake it, the next one will
+                mNumParked.fetch_add(1);
+            }
+
+            return;
+        }
+
+        if (now - spinStart > spinFlushNs)
+        {
+            mSpinNsTotal.fetch_add(now - spinStart, std::memory_order_relaxed);
+            spinStart = now;
+        }
+
+        // Without dedicated cores the handlers this thread waits for may need the core it spins on
+        std::this_thread::yield();
+
+        // Going back through the scheduler runs the reactor without blocking and any ready handler first
+        PostSpin(spinStart);
+    }
+}
@@ -0,0 +1,81 @@
+﻿#pragma once
+
+#include "Statistics.h"
+#include "Transport.h"
+
+namespace PattyCore
+{
+    /*------------------*
+     *    BusyPoller    *
+     *------------------*/
+
+    // 소켓 스레드 그룹에 스스로를 다시 게시하는 스피너를 돌려서 스레드들이 커널에서 잠들지 않게 한다
+    // 게시된 작업이 남아 있는 동안 asio는 리액터를 대기 시간 0으로 돌리므로 스피너가 도는 동안 입출력을 바쁘게 폴링한다
+    // 마지막 수신 이후 spinInterval이 지나면 스피너가 멈추고 스레드는 원래대로 커널에서 기다린다, 다음 수신이 다시 깨운다
+    class BusyPoller : public std::enable_shared_from_this<BusyPoller>
+    {
+    public:
+        using Ptr = SPtr<BusyPoller>;
+
+        struct Config
+        {
+            Microseconds    spinInterval = Microseconds(0);     // 0이면 켜지 않는다
+            Microseconds    socketBusyPoll = Microseconds(0);   // 0이 아니면 소켓마다 SO_BUSY_POLL, 리눅스에서만
+        };
+
+    public:
+        // 스피너마다 코어 하나를 쓴다, 보통 소켓 스레드 수만큼 둔다
+        BusyPoller(ThreadPool& socketGroup, const size_t numSpinners, const Config& config);
+        BusyPoller(const BusyPoller&) = delete;
+        BusyPoller& operator=(const BusyPoller&) = delete;
+
+        void Start();
+
+        // 스피너를 모두 멈춘다, 스피너가 게시되어 있으면 스레드 풀이 일을 마치지 않으므로 join 전에 호출해야 한다
+        void Stop();
+
+        // 소켓 스레드에서 수신을 마칠 때마다 호출한다, 멈춘 스피너를 다시 돌린다
+        void MarkActive()
+        {
+            const int64_t now = SteadyNowNs();
+
+            // Spinners only compare against spinInterval, so a shared line written every few microseconds is enough
+            if (now - mLastActive.load(std::memory_order_relaxed) > mMarkGranularity)
+            {
+                mLastActive.store(now, std::memory_order_relaxed);
+            }
+
+            if (mNumParked.load(std::memory_order_relaxed) != 0)
+            {
+                Wake();
+            }
+        }
+
+        // 커널 소켓에 SO_BUSY_POLL을 설정한다, 권한이 없어 실패하면 처음 한 번만 알린다
+        void ApplySocketOptions(Transport& transport);
+
+        BusyPollStats GetStats() const;
+
+    private:
+        void Wake();
+        void PostSpin(const int64_t spinStart);
+        void Spin(int64_t spinStart);
+
+    private:
+        ThreadPool&             mSocketGroup;
+        const Config            mConfig;
+        const size_t            mNumSpinners;
+        const int64_t           mSpinNs;
+        const int64_t           mMarkGranularity;
+
+        alignas(64) std::atomic<int64_t>    mLastActive = 0;
+        std::atomic<size_t>                 mNumParked = 0;
+        std::atomic<bool>                   mStopped = false;
+
+        // 스피너가 멈출 때만 갱신한다
+        alignas(64) std::atomic<uint64_t>   mSpinNsTotal = 0;
+        std::atomic<uint64_t>               mNumParks = 0;
+        std::atomic<uint64_t>               mNumWakes = 0;
+        std::atomic<bool>                   mWarnedSocketOption = false;
+    };
+}
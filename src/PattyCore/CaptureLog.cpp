@@ -0,0 +1,245 @@
+﻿#include "Pch.h"
+#include "CaptureLog.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif // _WIN32
+
+namespace PattyCore
+{
+    CaptureLog::CaptureLog(const std::string& path, const size_t capacity)
+        : mCapacity(capacity)
+    {
+        Map(path);
+    }
+
+    CaptureLog::~CaptureLog()
+    {
+        Unmap();
+    }
+
+    bool CaptureLog::IsOpen() const
+    {
+        return mBase != nullptr;
+    }
+
+    bool CaptureLog::Append(const uint32_t sessionId, const Message& msg)
+    {
+        const uint64_t numBytes = sizeof(RecordHeader) + msg.payload.size();
+
+        // Reserve space without a lock, writers never overlap
+        const uint64_t offset = mOffset.fetch_add(numBytes, std::memory_order_relaxed);
+
+        if (offset + numBytes > mCapacity)
+        {
+            mNumDropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        const int64_t timestampNs = std::chrono::steady_clock::now().time_since_epoch().count();
+        std::byte* record = mBase + sizeof(FileHeader) + offset;
+
+        // Field by field over a zeroed header, so the padding never carries stack bytes into the file
+        std::memset(record, 0, sizeof(RecordHeader));
+        std::memcpy(record + offsetof(RecordHeader, timestampNs), &timestampNs, sizeof(int64_t));
+        std::memcpy(record + offsetof(RecordHeader, sessionId), &sessionId, sizeof(uint32_t));
+        std::memcpy(record + offsetof(RecordHeader, header) + offsetof(Message::Header, id), &msg.header.id, sizeof(Message::Id));
+
+        if (!msg.payload.empty())
+        {
+            std::memcpy(record + sizeof(RecordHeader), msg.payload.data(), msg.payload.size());
+        }
+
+        // The size commits the record, a crash before this leaves it zero for Load to stop at
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(record + offsetof(RecordHeader, header) + offsetof(Message::Header, size), &msg.header.size, sizeof(Message::Size));
+
+        mNumRecords.fetch_add(1, std::memory_order_relaxed);
+
+        return true;
+    }
+
+    bool CaptureLog::Load(const std::string& path, std::vector<Record>& records)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+        if (!file)
+        {
+            return false;
+        }
+
+        const uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+        file.seekg(0);
+
+        FileHeader fileHeader;
+        file.read(reinterpret_cast<char*>(&fileHeader), sizeof(FileHeader));
+
+        if (!file || (fileHeader.magic != magic))
+        {
+            return false;
+        }
+
+        records.clear();
+
+        // The file header is only complete after a clean shutdown, so the records themselves mark the end
+        uint64_t offset = sizeof(FileHeader);
+
+        while (offset + sizeof(RecordHeader) <= fileSize)
+        {
+            Record record;
+            file.read(reinterpret_cast<char*>(&record.header), sizeof(RecordHeader));
+
+            if (!file || (record.header.header.size < sizeof(Message::Header)))
+            {
+                break;
+            }
+
+            const uint64_t payloadSize = record.header.header.size - sizeof(Message::Header);
+
+            if (offset + sizeof(RecordHeader) + payloadSize > fileSize)
+            {
+                break;
+            }
+
+            record.msg.header = record.header.header;
+            record.msg.payload.resize(payloadSize);
+            file.read(reinterpret_cast<char*>(record.msg.payload.data()), payloadSize);
+
+            if (!file)
+            {
+                break;
+            }
+
+            offset += sizeof(RecordHeader) + payloadSize;
+            records.push_back(std::move(record));
+        }
+
+        return true;
+    }
+
+#ifdef _WIN32
+    void CaptureLog::Map(const std::string& path)
+    {
+        const uint64_t fileSize = sizeof(FileHeader) + mCapacity;
+
+        mFile = ::CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+        if (mFile == INVALID_HANDLE_VALUE)
+        {
+            std::cerr << "[CAPTURE] Failed to open: " << path << "\n";
+            return;
+        }
+
+        mMapping = ::CreateFileMappingA(mFile, nullptr, PAGE_READWRITE,
+                                        static_cast<DWORD>(fileSize >> 32), static_cast<DWORD>(fileSize), nullptr);
+
+        if (mMapping == nullptr)
+        {
+            std::cerr << "[CAPTURE] Failed to map: " << path << "\n";
+            return;
+        }
+
+        mBase = static_cast<std::byte*>(::MapViewOfFile(mMapping, FILE_MAP_WRITE, 0, 0, static_cast<SIZE_T>(fileSize)));
+
+        if (mBase != nullptr)
+        {
+            // Written now so a crashed capture is still recognized, Unmap fills in the totals
+            const FileHeader fileHeader;
+            std::memcpy(mBase, &fileHeader, sizeof(FileHeader));
+        }
+    }
+
+    void CaptureLog::Unmap()
+    {
+        uint64_t numBytes = 0;
+
+        if (mBase != nullptr)
+        {
+            numBytes = std::min<uint64_t>(mOffset.load(), mCapacity);
+
+            FileHeader fileHeader;
+            fileHeader.numBytes = numBytes;
+            fileHeader.numRecords = mNumRecords.load();
+            fileHeader.numDropped = mNumDropped.load();
+            std::memcpy(mBase, &fileHeader, sizeof(FileHeader));
+
+            ::UnmapViewOfFile(mBase);
+            mBase = nullptr;
+        }
+
+        if (mMapping != nullptr)
+        {
+            ::CloseHandle(mMapping);
+            mMapping = nullptr;
+        }
+
+        if (mFile != INVALID_HANDLE_VALUE)
+        {
+            // Trim the unused tail of the file
+            LARGE_INTEGER size;
+            size.QuadPart = static_cast<LONGLONG>(sizeof(FileHeader) + numBytes);
+            ::SetFilePointerEx(mFile, size, nullptr, FILE_BEGIN);
+            ::SetEndOfFile(mFile);
+
+            ::CloseHandle(mFile);
+            mFile = INVALID_HANDLE_VALUE;
+        }
+    }
+#else
+    void CaptureLog::Map(const std::string& path)
+    {
+        const size_t fileSize = sizeof(FileHeader) + mCapacity;
+
+        mFile = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+        if ((mFile < 0) || (::ftruncate(mFile, static_cast<off_t>(fileSize)) != 0))
+        {
+            std::cerr << "[CAPTURE] Failed to open: " << path << "\n";
+            return;
+        }
+
+        void* base = ::mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, mFile, 0);
+
+        if (base == MAP_FAILED)
+        {
+            std::cerr << "[CAPTURE] Failed to map: " << path << "\n";
+            return;
+        }
+
+        mBase = static_cast<std::byte*>(base);
+
+        // Written now so a crashed capture is still recognized, Unmap fills in the totals
+        const FileHeader fileHeader;
+        std::memcpy(mBase, &fileHeader, sizeof(FileHeader));
+    }
+
+    void CaptureLog::Unmap()
+    {
+        uint64_t numBytes = 0;
+
+        if (mBase != nullptr)
+        {
+            numBytes = std::min<uint64_t>(mOffset.load(), mCapacity);
+
+            FileHeader fileHeader;
+            fileHeader.numBytes = numBytes;
+            fileHeader.numRecords = mNumRecords.load();
+            fileHeader.numDropped = mNumDropped.load();
+            std::memcpy(mBase, &fileHeader, sizeof(FileHeader));
+
+            ::munmap(mBase, sizeof(FileHeader) + mCapacity);
+            mBase = nullptr;
+        }
+
+        if (mFile >= 0)
+        {
+            // Trim the unused tail of the file
+            ::ftruncate(mFile, static_cast<off_t>(sizeof(FileHeader) + numBytes));
+            ::close(mFile);
+            mFile = -1;
+        }
+    }
+#endif // _WIN32
+}
@@ -0,0 +1,74 @@
+﻿#pragma once
+
+#include "Message.h"
+
+namespace PattyCore
+{
+    /*------------------*
+     *    CaptureLog    *
+     *------------------*/
+
+    // 수신한 프레임을 메모리 맵 파일에 순서대로 기록한다
+    // 용량이 가득 차면 이후 프레임은 버리므로 오버헤드가 제한된다
+    // 프로세스가 비정상 종료되어도 맵 파일에 남은 레코드는 Load로 읽을 수 있다
+    class CaptureLog
+    {
+    public:
+        using Ptr = SPtr<CaptureLog>;
+
+        static constexpr uint32_t magic = 0x50435031;   // "PCP1"
+
+        struct FileHeader
+        {
+            uint32_t    magic = CaptureLog::magic;
+            uint32_t    reserved = 0;
+            uint64_t    numBytes = 0;       // FileHeader를 제외한 기록 크기, 아래 값들은 정상 종료할 때만 기록된다
+            uint64_t    numRecords = 0;
+            uint64_t    numDropped = 0;
+        };
+
+        struct RecordHeader
+        {
+            int64_t             timestampNs = 0;    // steady_clock 기준
+            uint32_t            sessionId = 0;
+            Message::Header     header;             // header.size - sizeof(Message::Header)만큼 payload가 뒤따른다
+                                                    // header.size를 마지막에 쓰므로 0이면 기록되지 않은 레코드다
+        };
+
+        struct Record
+        {
+            RecordHeader    header;
+            Message         msg;
+        };
+
+    public:
+        CaptureLog(const std::string& path, const size_t capacity);
+        ~CaptureLog();
+        CaptureLog(const CaptureLog&) = delete;
+        CaptureLog& operator=(const CaptureLog&) = delete;
+
+        bool IsOpen() const;
+        bool Append(const uint32_t sessionId, const Message& msg);
+
+        // 0으로 남은 레코드나 파일 끝에서 잘린 레코드를 만나면 그 앞까지만 읽는다
+        static bool Load(const std::string& path, std::vector<Record>& records);
+
+    private:
+        void Map(const std::string& path);
+        void Unmap();
+
+    private:
+        std::byte*              mBase = nullptr;    // FileHeader부터 시작하는 매핑 영역
+        size_t                  mCapacity = 0;      // FileHeader를 제외한 용량
+        std::atomic<uint64_t>   mOffset = 0;
+        std::atomic<uint64_t>   mNumRecords = 0;
+        std::atomic<uint64_t>   mNumDropped = 0;
+
+#ifdef _WIN32
+        HANDLE                  mFile = INVALID_HANDLE_VALUE;
+        HANDLE                  mMapping = nullptr;
+#else
+        int                     mFile = -1;
+#endif // _WIN32
+    };
+}
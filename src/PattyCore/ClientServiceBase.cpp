@@ -1,5 +1,6 @@
 ﻿#include "Pch.h"
 #include "ClientServiceBase.h"
+#include "ServerServiceBase.h"
 
 namespace PattyCore
 {
@@ -13,7 +14,7 @@ namespace PattyCore
     {
         ErrCode errCode;
 
-        mEndpoints = mResolver.resolve(host, service, errCode);
+        const Endpoints endpoints = mResolver.resolve(host, service, errCode);
 
         if (errCode)
         {
@@ -21,8 +22,47 @@ namespace PattyCore
             return;
         }
 
+        mEndpoints.clear();
+
+        for (const auto& entry : endpoints)
+        {
+            mEndpoints.emplace_back(entry.endpoint());
+        }
+
         ConnectAsync(numConnects);
-        std::cout << "[CLIENT] Started!\n";
+        std::cout << "[CLIENT] Started! (io: " << GetIoBackend() << ")\n";
+    }
+
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+    void ClientServiceBase::Start(const Local::endpoint& endpoint, size_t numConnects)
+    {
+        mEndpoints.assign(1, StreamEndpoint(endpoint));
+
+        ConnectAsync(numConnects);
+        std::cout << "[CLIENT] Started! (io: " << GetIoBackend() << ")\n";
+    }
+#endif // ASIO_HAS_LOCAL_SOCKETS
+
+    void ClientServiceBase::StartDatagram()
+    {
+        OpenDatagramChannel(Udp::endpoint(Udp::v4(), 0), false);
+        std::cout << "[CLIENT] Datagram started!\n";
+    }
+
+    void ClientServiceBase::ConnectLoopback(ServerServiceBase& server, size_t numConnects)
+    {
+        mLoopbackServer = &server;
+
+        for (; numConnects > 0; --numConnects)
+        {
+            MemoryPipe::Ptr pipe = server.AcceptLoopback(mThreadPoolGroup.GetSocketGroup().get_executor());
+
+            Session::Ptr session = CreateSession(std::move(pipe));
+            session->OfferCompactFraming();
+            session->OfferFrameChecksum();
+        }
+
+        std::cout << "[CLIENT] Loopback connected!\n";
     }
 
     void ClientServiceBase::ConnectAsync(size_t numConnects)
@@ -36,14 +76,14 @@ namespace PattyCore
                             mEndpoints,
                             asio::bind_executor(mThreadPoolGroup.GetSessionGroup(),
                                                 [this, numConnects]
-                                                (const ErrCode& errCode, const Tcp::endpoint& endpoint)
+                                                (const ErrCode& errCode, const StreamEndpoint& /*endpoint*/)
                                                 {
                                                     OnConnected(errCode, std::move(mSocket), numConnects);
                                                 })
         );
     }
 
-    void ClientServiceBase::OnConnected(const ErrCode& errCode, Tcp::socket socket, size_t numConnects)
+    void ClientServiceBase::OnConnected(const ErrCode& errCode, StreamSocket socket, size_t numConnects)
     {
         if (errCode)
         {
@@ -51,9 +91,64 @@ namespace PattyCore
             return;
         }
 
-        mSocket = Tcp::socket(mThreadPoolGroup.GetSocketGroup());
+        mSocket = StreamSocket(mThreadPoolGroup.GetSocketGroup());
         ConnectAsync(--numConnects);
 
-        CreateSession(std::move(socket));
+        Session::Ptr session = CreateSession(std::move(socket));
+
+        // The server answers only if it allows compact framing and checksums as well
+        session->OfferCompactFraming();
+        session->OfferFrameChecksum();
+    }
+
+    void ClientServiceBase::ReattachAsync(Session::Ptr session)
+    {
+        if (mLoopbackServer != nullptr)
+        {
+            session->Reattach(mLoopbackServer->AcceptLoopback(mThreadPoolGroup.GetSocketGroup().get_executor()));
+            session->OfferCompactFraming();
+            session->OfferFrameChecksum();
+
+            return;
+        }
+
+        auto socket = std::make_shared<StreamSocket>(mThreadPoolGroup.GetSocketGroup());
+
+        asio::async_connect(*socket,
+                            mEndpoints,
+                            asio::bind_executor(mThreadPoolGroup.GetSessionGroup(),
+                                                [this, socket, session = std::move(session)]
+                                                (const ErrCode& errCode, const StreamEndpoint& /*endpoint*/) mutable
+                                                {
+                                                    if (errCode)
+                                                    {
+                                                        std::cerr << *session << " Failed to reconnect: " << errCode << "\n";
+                                                        RetryReattachAsync(std::move(session));
+
+                                                        return;
+                                                    }
+
+                                                    session->Reattach(std::move(*socket));
+                                                    session->OfferCompactFraming();
+                                                    session->OfferFrameChecksum();
+                                                })
+        );
+    }
+
+    void ClientServiceBase::RetryReattachAsync(Session::Ptr session)
+    {
+        auto timer = std::make_shared<Timer>(mThreadPoolGroup.GetSessionGroup());
+
+        timer->expires_after(mResumePolicy->retryInterval);
+        timer->async_wait([this, timer, session = std::move(session)](const ErrCode& errCode) mutable
+                          {
+                              // The session gives up on its own once the resume timeout passes
+                              if (errCode || !session->IsDetached())
+                              {
+                                  return;
+                              }
+
+                              ReattachAsync(std::move(session));
+                          });
     }
 }
@@ -4,6 +4,8 @@
 
 namespace PattyCore
 {
+    class ServerServiceBase;
+
     /*-------------------------*
      *    ClientServiceBase    *
      *-------------------------*/
@@ -14,14 +16,27 @@ namespace PattyCore
         ClientServiceBase(const ThreadPoolGroup::Info& threadsInfo);
 
         void Start(const std::string& host, const std::string& service, size_t numConnects);
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+        void Start(const Local::endpoint& endpoint, size_t numConnects);
+#endif // ASIO_HAS_LOCAL_SOCKETS
+        void StartDatagram();
+
+        // 같은 프로세스의 server에 MemoryPipe로 numConnects개의 세션을 연결한다
+        void ConnectLoopback(ServerServiceBase& server, size_t numConnects);
+
+    protected:
+        // 처음 연결한 방식대로 다시 연결하고, 실패하면 세션이 끊겨 있는 동안 retryInterval마다 다시 시도한다
+        virtual void ReattachAsync(Session::Ptr session) override;
 
     private:
         void ConnectAsync(size_t numConnects);
-        void OnConnected(const ErrCode& error, Tcp::socket socket, size_t numConnects);
+        void OnConnected(const ErrCode& error, StreamSocket socket, size_t numConnects);
+        void RetryReattachAsync(Session::Ptr session);
 
     private:
-        Tcp::resolver       mResolver;
-        Endpoints           mEndpoints;
-        Tcp::socket         mSocket;
+        Tcp::resolver                   mResolver;
+        std::vector<StreamEndpoint>     mEndpoints;
+        StreamSocket                    mSocket;
+        ServerServiceBase*              mLoopbackServer = nullptr;  // ConnectLoopback으로 연결했을 때만 있다
     };
 }
@@ -0,0 +1,206 @@
+﻿#include "Pch.h"
+#include "Crc32c.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define PATTYCORE_CRC32C_SSE42
+#include <nmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif // _MSC_VER
+#elif defined(_M_ARM64) || (defined(__aarch64__) && defined(__ARM_FEATURE_CRC32))
+#define PATTYCORE_CRC32C_ARMV8
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <arm_acle.h>
+#endif // _MSC_VER
+#endif
+
+// GCC, Clang은 명령어 집합을 켜지 않은 번역 단위에서도 함수 단위로 쓸 수 있다
+#if defined(PATTYCORE_CRC32C_SSE42) && !defined(_MSC_VER)
+#define PATTYCORE_CRC32C_TARGET __attribute__((target("sse4.2")))
+#else
+#define PATTYCORE_CRC32C_TARGET
+#endif
+
+namespace PattyCore
+{
+    namespace
+    {
+        using Table = std::array<std::array<uint32_t, 256>, 8>;
+
+        constexpr uint32_t polynomial = 0x82F63B78;     // 0x1EDC6F41의 비트 역순
+
+        // tables[k][b]는 바이트 b 뒤에 0바이트가 k개 이어질 때의 CRC
+        constexpr Table MakeTables()
+        {
+            Table tables = {};
+
+            for (uint32_t byte = 0; byte < 256; ++byte)
+            {
+                uint32_t crc = byte;
+
+                for (int bit = 0; bit < 8; ++bit)
+                {
+                    crc = (crc >> 1) ^ ((crc & 1) ? polynomial : 0);
+                }
+
+                tables[0][byte] = crc;
+            }
+
+            for (size_t k = 1; k < tables.size(); ++k)
+            {
+                for (uint32_t byte = 0; byte < 256; ++byte)
+                {
+                    const uint32_t prev = tables[k - 1][byte];
+                    tables[k][byte] = (prev >> 8) ^ tables[0][prev & 0xFF];
+                }
+            }
+
+            return tables;
+        }
+
+        constexpr Table sTables = MakeTables();
+
+        uint32_t UpdateSoftware(uint32_t crc, const uint8_t* data, size_t size)
+        {
+            while (size >= 8)
+            {
+                uint64_t word;
+                std::memcpy(&word, data, sizeof(word));
+                word ^= crc;
+
+                crc = sTables[7][word & 0xFF]
+                    ^ sTables[6][(word >> 8) & 0xFF]
+                    ^ sTables[5][(word >> 16) & 0xFF]
+                    ^ sTables[4][(word >> 24) & 0xFF]
+                    ^ sTables[3][(word >> 32) & 0xFF]
+                    ^ sTables[2][(word >> 40) & 0xFF]
+                    ^ sTables[1][(word >> 48) & 0xFF]
+                    ^ sTables[0][word >> 56];
+
+                data += 8;
+                size -= 8;
+            }
+
+            for (; size > 0; --size)
+            {
+                crc = (crc >> 8) ^ sTables[0][(crc ^ *data++) & 0xFF];
+            }
+
+            return crc;
+        }
+
+#if defined(PATTYCORE_CRC32C_SSE42)
+        PATTYCORE_CRC32C_TARGET
+        uint32_t UpdateHardware(uint32_t crc, const uint8_t* data, size_t size)
+        {
+            uint64_t crc64 = crc;
+
+            while (size >= 8)
+            {
+                uint64_t word;
+                std::memcpy(&word, data, sizeof(word));
+                crc64 = _mm_crc32_u64(crc64, word);
+
+                data += 8;
+                size -= 8;
+            }
+
+            crc = static_cast<uint32_t>(crc64);
+
+            for (; size > 0; --size)
+            {
+                crc = _mm_crc32_u8(crc, *data++);
+            }
+
+            return crc;
+        }
+
+        bool HasHardwareSupport()
+        {
+#ifdef _MSC_VER
+            int info[4] = {};
+            __cpuid(info, 1);
+
+            return (info[2] & (1 << 20)) != 0;
+#else
+            // May run before main, when the CPU model is not initialized yet
+            __builtin_cpu_init();
+
+            return __builtin_cpu_supports("sse4.2");
+#endif // _MSC_VER
+        }
+#elif defined(PATTYCORE_CRC32C_ARMV8)
+        uint32_t UpdateHardware(uint32_t crc, const uint8_t* data, size_t size)
+        {
+            while (size >= 8)
+            {
+                uint64_t word;
+                std::memcpy(&word, data, sizeof(word));
+                crc = __crc32cd(crc, word);
+
+                data += 8;
+                size -= 8;
+            }
+
+            for (; size > 0; --size)
+            {
+                crc = __crc32cb(crc, *data++);
+            }
+
+            return crc;
+        }
+
+        // 컴파일러가 CRC 확장을 켠 빌드에서만 이 경로를 쓴다
+        bool HasHardwareSupport()
+        {
+            return true;
+        }
+#endif
+
+        using Update = uint32_t(*)(uint32_t, const uint8_t*, size_t);
+
+        Update SelectUpdate()
+        {
+#if defined(PATTYCORE_CRC32C_SSE42) || defined(PATTYCORE_CRC32C_ARMV8)
+            if (HasHardwareSupport())
+            {
+                return UpdateHardware;
+            }
+#endif
+            return UpdateSoftware;
+        }
+
+        const Update sUpdate = SelectUpdate();
+    }
+
+    uint32_t Crc32c::Compute(const void* data, const size_t size, const uint32_t crc)
+    {
+        return ~sUpdate(~crc, static_cast<const uint8_t*>(data), size);
+    }
+
+    uint32_t Crc32c::ComputeSoftware(const void* data, const size_t size, const uint32_t crc)
+    {
+        return ~UpdateSoftware(~crc, static_cast<const uint8_t*>(data), size);
+    }
+
+    bool Crc32c::IsHardwareAccelerated()
+    {
+        return sUpdate != UpdateSoftware;
+    }
+
+    const char* Crc32c::GetBackend()
+    {
+        if (!IsHardwareAccelerated())
+        {
+            return "table";
+        }
+
+#if defined(PATTYCORE_CRC32C_SSE42)
+        return "sse4.2";
+#else
+        return "armv8";
+#endif
+    }
+}
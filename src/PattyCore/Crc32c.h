@@ -0,0 +1,24 @@
+﻿#pragma once
+
+namespace PattyCore
+{
+    /*--------------*
+     *    Crc32c    *
+     *--------------*/
+
+    // Castagnoli 다항식의 CRC32, 프레임 무결성 검사에 쓴다
+    // SSE4.2나 ARMv8 CRC 명령이 있으면 8바이트씩 처리하고, 없으면 slicing-by-8 테이블로 계산한다
+    // 백엔드는 프로그램이 시작할 때 CPU를 확인해서 한 번 고른다
+    class Crc32c
+    {
+    public:
+        // crc에 이어서 계산한다, 처음이면 0
+        static uint32_t Compute(const void* data, const size_t size, const uint32_t crc = 0);
+
+        // 백엔드와 관계없이 테이블로 계산한다, 비교용
+        static uint32_t ComputeSoftware(const void* data, const size_t size, const uint32_t crc = 0);
+
+        static bool IsHardwareAccelerated();
+        static const char* GetBackend();
+    };
+}
@@ -0,0 +1,247 @@
+﻿#include "Pch.h"
+#include "DatagramChannel.h"
+
+#ifdef __linux__
+#include <sys/socket.h>
+#endif // __linux__
+
+namespace PattyCore
+{
+    DatagramChannel::DatagramChannel(ThreadPool& socketGroup, const Udp::endpoint& local, OnReceived onReceived)
+        : mSocket(socketGroup, local)
+        , mOnReceived(std::move(onReceived))
+        , mSendStrand(asio::make_strand(socketGroup))
+    {
+        mSocket.non_blocking(true);
+    }
+
+    void DatagramChannel::Start()
+    {
+        WaitReadableAsync();
+    }
+
+    void DatagramChannel::Close()
+    {
+        ErrCode errCode;
+        mSocket.close(errCode);
+    }
+
+    bool DatagramChannel::SendAsync(const Udp::endpoint& remote, const Header& header, const Message& msg)
+    {
+        const size_t numBytes = headerSize + msg.CalculateSize();
+
+        if (numBytes > maxDatagramSize)
+        {
+            return false;
+        }
+
+        Datagram datagram;
+        datagram.remote = remote;
+        datagram.bytes.resize(numBytes);
+
+        std::byte* data = datagram.bytes.data();
+        EncodeHeader(header, data);
+        std::memcpy(data + headerSize, &msg.header, sizeof(Message::Header));
+
+        if (!msg.payload.empty())
+        {
+            std::memcpy(data + headerSize + sizeof(Message::Header), msg.payload.data(), msg.payload.size());
+        }
+
+        asio::post(mSendStrand,
+                   [this, datagram = std::move(datagram)]() mutable
+                   {
+                       mSendBatch.push_back(std::move(datagram));
+
+                       // Datagrams sent in the same burst are flushed together
+                       if (!mFlushPosted)
+                       {
+                           mFlushPosted = true;
+                           asio::post(mSendStrand,
+                                      [this]()
+                                      {
+                                          FlushBatch();
+                                      });
+                       }
+                   });
+
+        return true;
+    }
+
+    uint16_t DatagramChannel::GetPort() const
+    {
+        return mSocket.local_endpoint().port();
+    }
+
+    bool DatagramChannel::IsNewer(const Sequence received, const Sequence last)
+    {
+        return static_cast<int32_t>(received - last) > 0;
+    }
+
+    void DatagramChannel::EncodeHeader(const Header& header, std::byte* out)
+    {
+        std::memcpy(out, &header.token, sizeof(Token));
+        std::memcpy(out + sizeof(Token), &header.sequence, sizeof(Sequence));
+    }
+
+    DatagramChannel::Header DatagramChannel::DecodeHeader(const std::byte* data)
+    {
+        Header header;
+        std::memcpy(&header.token, data, sizeof(Token));
+        std::memcpy(&header.sequence, data + sizeof(Token), sizeof(Sequence));
+
+        return header;
+    }
+
+    void DatagramChannel::WaitReadableAsync()
+    {
+        mSocket.async_wait(Udp::socket::wait_read,
+                           [this](const ErrCode& errCode)
+                           {
+                               OnReadable(errCode);
+                           });
+    }
+
+    void DatagramChannel::OnReadable(const ErrCode& errCode)
+    {
+        if (errCode)
+        {
+            if (errCode != asio::error::operation_aborted)
+            {
+                std::cerr << "[DATAGRAM] Failed to wait readable: " << errCode << "\n";
+            }
+
+            return;
+        }
+
+        ReceiveBatch();
+        WaitReadableAsync();
+    }
+
+    void DatagramChannel::ReceiveBatch()
+    {
+#ifdef __linux__
+        std::array<mmsghdr, batchSize> headers = {};
+        std::array<iovec, batchSize> iovecs = {};
+        std::array<sockaddr_storage, batchSize> addrs = {};
+
+        for (size_t idx = 0; idx < batchSize; ++idx)
+        {
+            iovecs[idx].iov_base = mReceiveBuffers[idx].data();
+            iovecs[idx].iov_len = maxDatagramSize;
+            headers[idx].msg_hdr.msg_iov = &iovecs[idx];
+            headers[idx].msg_hdr.msg_iovlen = 1;
+            headers[idx].msg_hdr.msg_name = &addrs[idx];
+            headers[idx].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+        }
+
+        // Drain the socket with as few syscalls as possible
+        while (true)
+        {
+            const int numReceived = ::recvmmsg(mSocket.native_handle(),
+                                               headers.data(),
+                                               static_cast<unsigned int>(batchSize),
+                                               MSG_DONTWAIT,
+                                               nullptr);
+
+            if (numReceived <= 0)
+            {
+                return;
+            }
+
+            for (int idx = 0; idx < numReceived; ++idx)
+            {
+                Udp::endpoint remote;
+                std::memcpy(remote.data(), &addrs[idx], headers[idx].msg_hdr.msg_namelen);
+                remote.resize(headers[idx].msg_hdr.msg_namelen);
+
+                OnDatagramReceived(mReceiveBuffers[idx].data(), headers[idx].msg_len, remote);
+
+                headers[idx].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+            }
+
+            if (static_cast<size_t>(numReceived) < batchSize)
+            {
+                return;
+            }
+        }
+#else
+        for (size_t numReceived = 0; numReceived < batchSize; ++numReceived)
+        {
+            ErrCode errCode;
+            Udp::endpoint remote;
+
+            const size_t numBytes = mSocket.receive_from(asio::buffer(mReceiveBuffers[0]), remote, 0, errCode);
+
+            if (errCode)
+            {
+                return;
+            }
+
+            OnDatagramReceived(mReceiveBuffers[0].data(), numBytes, remote);
+        }
+#endif // __linux__
+    }
+
+    void DatagramChannel::OnDatagramReceived(const std::byte* data, const size_t numBytes, const Udp::endpoint& remote)
+    {
+        if (numBytes < headerSize + sizeof(Message::Header))
+        {
+            return;
+        }
+
+        const Header header = DecodeHeader(data);
+        Message msg;
+
+        std::memcpy(&msg.header, data + headerSize, sizeof(Message::Header));
+
+        // Drop malformed datagrams instead of trusting the header
+        if (msg.header.size != numBytes - headerSize)
+        {
+            return;
+        }
+
+        msg.payload.assign(data + headerSize + sizeof(Message::Header), data + numBytes);
+
+        mOnReceived(header, remote, std::move(msg));
+    }
+
+    void DatagramChannel::FlushBatch()
+    {
+        mFlushPosted = false;
+
+#ifdef __linux__
+        std::array<mmsghdr, batchSize> headers = {};
+        std::array<iovec, batchSize> iovecs = {};
+
+        for (size_t offset = 0; offset < mSendBatch.size(); offset += batchSize)
+        {
+            const size_t numDatagrams = std::min(batchSize, mSendBatch.size() - offset);
+
+            for (size_t idx = 0; idx < numDatagrams; ++idx)
+            {
+                Datagram& datagram = mSendBatch[offset + idx];
+
+                iovecs[idx].iov_base = datagram.bytes.data();
+                iovecs[idx].iov_len = datagram.bytes.size();
+                headers[idx].msg_hdr = {};
+                headers[idx].msg_hdr.msg_iov = &iovecs[idx];
+                headers[idx].msg_hdr.msg_iovlen = 1;
+                headers[idx].msg_hdr.msg_name = datagram.remote.data();
+                headers[idx].msg_hdr.msg_namelen = static_cast<socklen_t>(datagram.remote.size());
+            }
+
+            // Datagrams the kernel can't take right now are dropped, the channel is unreliable
+            ::sendmmsg(mSocket.native_handle(), headers.data(), static_cast<unsigned int>(numDatagrams), MSG_DONTWAIT);
+        }
+#else
+        for (Datagram& datagram : mSendBatch)
+        {
+            ErrCode errCode;
+            mSocket.send_to(asio::buffer(datagram.bytes), datagram.remote, 0, errCode);
+        }
+#endif // __linux__
+
+        mSendBatch.clear();
+    }
+}
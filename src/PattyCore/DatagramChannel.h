@@ -0,0 +1,88 @@
+﻿#pragma once
+
+#include "Message.h"
+#include "MessageSchema.h"
+
+namespace PattyCore
+{
+    /*-----------------------*
+     *    DatagramChannel    *
+     *-----------------------*/
+
+    // 세션에 묶이는 비신뢰 UDP 채널
+    // 데이터그램 하나에 메시지 하나를 Header + Message::Header + payload 형태로 담는다
+    class DatagramChannel
+    {
+    public:
+        using Ptr = SPtr<DatagramChannel>;
+        using Token = uint64_t;
+        using Sequence = uint32_t;
+
+        struct Header
+        {
+            Token       token = 0;      // 세션 식별 토큰
+            Sequence    sequence = 0;   // 오래된 데이터그램을 버리기 위한 순번
+        };
+
+        // 구조체를 그대로 복사하면 패딩이 함께 나가므로 필드만 이어 붙인다
+        static constexpr size_t headerSize = sizeof(Token) + sizeof(Sequence);
+
+        using OnReceived = std::function<void(const Header&, const Udp::endpoint&, Message&&)>;
+
+        static constexpr size_t maxDatagramSize = 1400;
+        static constexpr size_t batchSize = 32;
+
+    public:
+        DatagramChannel(ThreadPool& socketGroup, const Udp::endpoint& local, OnReceived onReceived);
+        DatagramChannel(const DatagramChannel&) = delete;
+        DatagramChannel& operator=(const DatagramChannel&) = delete;
+
+        void Start();
+        void Close();
+
+        bool SendAsync(const Udp::endpoint& remote, const Header& header, const Message& msg);
+
+        uint16_t GetPort() const;
+
+        // 순환을 고려해서 received가 last보다 새 순번인지 판단한다
+        static bool IsNewer(const Sequence received, const Sequence last);
+
+        static void EncodeHeader(const Header& header, std::byte* out);
+        static Header DecodeHeader(const std::byte* data);
+
+    private:
+        struct Datagram
+        {
+            Udp::endpoint               remote;
+            std::vector<std::byte>      bytes;
+        };
+
+        void WaitReadableAsync();
+        void OnReadable(const ErrCode& errCode);
+        void ReceiveBatch();
+        void OnDatagramReceived(const std::byte* data, const size_t numBytes, const Udp::endpoint& remote);
+
+        void FlushBatch();
+
+    private:
+        Udp::socket                 mSocket;
+        OnReceived                  mOnReceived;
+
+        Strand                      mSendStrand;
+        std::vector<Datagram>       mSendBatch;     // 송신 스트랜드에서만 접근
+        bool                        mFlushPosted = false;
+
+        std::array<std::array<std::byte, maxDatagramSize>, batchSize>
+                                    mReceiveBuffers;
+    };
+
+    /*--------------------------*
+     *    DatagramBindSchema    *
+     *--------------------------*/
+
+    // SystemId::DatagramBind의 payload, 세션 스트림으로 전달된다
+    struct DatagramBindSchema : MessageSchema<DatagramChannel::Token, uint16_t>
+    {
+        enum : size_t { Token, Port };
+    };
+}
@@ -0,0 +1,190 @@
+﻿#pragma once
+
+#include "Message.h"
+#include "Crc32c.h"
+
+namespace PattyCore
+{
+    /*---------------*
+     *    Framing    *
+     *---------------*/
+
+    // 스트림 위에서 Message::Header를 표현하는 방식
+    // Fixed: Message::Header 8바이트 그대로
+    // Compact: id, payload 크기를 순서대로 varint(LEB128)로 인코딩, 핑은 2바이트
+    // 체크섬을 켜면 두 방식 모두 payload 뒤에 인코딩된 헤더와 payload의 CRC32C 4바이트가 붙는다
+    struct Framing
+    {
+        enum class Mode : uint8_t
+        {
+            Fixed,
+            Compact,
+        };
+
+        enum class Result : uint8_t
+        {
+            Ok,
+            Incomplete,     // 헤더를 해석하려면 더 받아야 한다
+            Malformed,      // 스트림이 깨졌다
+        };
+
+        static constexpr size_t maxVarintSize = 5;
+        static constexpr size_t maxHeaderSize = std::max(sizeof(Message::Header), maxVarintSize * 2);
+
+        using HeaderBuffer = std::array<std::byte, maxHeaderSize>;
+
+        static constexpr size_t checksumSize = sizeof(uint32_t);
+
+        using ChecksumBuffer = std::array<std::byte, checksumSize>;
+
+        // 헤더와 payload가 떨어져 있는 송신 경로용
+        static void EncodeChecksum(const std::byte* header, const size_t headerSize,
+                                   const std::byte* payload, const size_t payloadSize,
+                                   std::byte* out)
+        {
+            const uint32_t checksum = Crc32c::Compute(payload, payloadSize, Crc32c::Compute(header, headerSize));
+
+            std::memcpy(out, &checksum, checksumSize);
+        }
+
+        // frame은 헤더부터 payload 끝까지이고 바로 뒤에 체크섬이 있어야 한다
+        static bool VerifyChecksum(const std::byte* frame, const size_t frameSize)
+        {
+            uint32_t checksum = 0;
+            std::memcpy(&checksum, frame + frameSize, checksumSize);
+
+            return Crc32c::Compute(frame, frameSize) == checksum;
+        }
+
+        // out에 헤더를 쓰고 쓴 바이트 수를 반환한다
+        static size_t EncodeHeader(const Mode mode, const Message::Header& header, std::byte* out)
+        {
+            if (mode == Mode::Fixed)
+            {
+                std::memcpy(out, &header, sizeof(Message::Header));
+
+                return sizeof(Message::Header);
+            }
+
+            assert(header.size >= sizeof(Message::Header));
+
+            size_t numBytes = EncodeVarint(header.id, out);
+            numBytes += EncodeVarint(header.size - sizeof(Message::Header), out + numBytes);
+
+            return numBytes;
+        }
+
+        // Ok면 header에 논리적 헤더(size는 Message::Header 포함)를, headerSize에 소비한 바이트 수를 채운다
+        static Result DecodeHeader(const Mode mode,
+                                   const std::byte* data,
+                                   const size_t numBytes,
+                                   Message::Header& header,
+                                   size_t& headerSize)
+        {
+            if (mode == Mode::Fixed)
+            {
+                if (numBytes < sizeof(Message::Header))
+                {
+                    return Result::Incomplete;
+                }
+
+                std::memcpy(&header, data, sizeof(Message::Header));
+                headerSize = sizeof(Message::Header);
+
+                return (header.size < sizeof(Message::Header)) ? Result::Malformed : Result::Ok;
+            }
+
+            uint32_t id = 0;
+            uint32_t payloadSize = 0;
+            size_t idSize = 0;
+            size_t payloadSizeSize = 0;
+
+            Result result = DecodeVarint(data, numBytes, id, idSize);
+
+            if (result != Result::Ok)
+            {
+                return result;
+            }
+
+            result = DecodeVarint(data + idSize, numBytes - idSize, payloadSize, payloadSizeSize);
+
+            if (result != Result::Ok)
+            {
+                return result;
+            }
+
+            if (payloadSize > std::numeric_limits<Message::Size>::max() - sizeof(Message::Header))
+            {
+                return Result::Malformed;
+            }
+
+            header.id = id;
+            header.size = static_cast<Message::Size>(payloadSize + sizeof(Message::Header));
+            headerSize = idSize + payloadSizeSize;
+
+            return Result::Ok;
+        }
+
+        static size_t EncodeVarint(uint32_t value, std::byte* out)
+        {
+            size_t numBytes = 0;
+
+            while (value >= 0x80)
+            {
+                out[numBytes++] = static_cast<std::byte>((value & 0x7F) | 0x80);
+                value >>= 7;
+            }
+
+            out[numBytes++] = static_cast<std::byte>(value);
+
+            return numBytes;
+        }
+
+        static Result DecodeVarint(const std::byte* data, const size_t numBytes, uint32_t& value, size_t& numRead)
+        {
+            if (numBytes == 0)
+            {
+                return Result::Incomplete;
+            }
+
+            // Fast path: ids and sizes below 128 take a single byte
+            const uint8_t first = static_cast<uint8_t>(data[0]);
+
+            if (first < 0x80)
+            {
+                value = first;
+                numRead = 1;
+
+                return Result::Ok;
+            }
+
+            value = first & 0x7F;
+
+            for (size_t i = 1; i < maxVarintSize; ++i)
+            {
+                if (i == numBytes)
+                {
+                    return Result::Incomplete;
+                }
+
+                const uint8_t byte = static_cast<uint8_t>(data[i]);
+                value |= static_cast<uint32_t>(byte & 0x7F) << (7 * i);
+
+                if (byte < 0x80)
+                {
+                    // The fifth byte may only carry the top 4 bits of a uint32
+                    if ((i == maxVarintSize - 1) && (byte > 0x0F))
+                    {
+                        return Result::Malformed;
+                    }
+
+                    numRead = i + 1;
+
+                    return Result::Ok;
+                }
+            }
+
+            return Result::Malformed;
+        }
+    };
+}
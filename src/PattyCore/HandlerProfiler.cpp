@@ -0,0 +1,518 @@
+﻿#include "Pch.h"
+#include "HandlerProfiler.h"
+
+#if defined(__linux__)
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <execinfo.h>
+#endif // __linux__
+
+namespace PattyCore
+{
+    namespace
+    {
+        constexpr int maxStackFrames = 48;
+
+        // How long the watchdog waits for a stalled thread to run its signal handler
+        constexpr Milliseconds stackCaptureTimeout = Milliseconds(50);
+
+        // One capture at a time across all profilers in the process
+        Mutex sStackLock;
+
+#if defined(__linux__)
+        // SIGURG is ignored by default, so a signal that outlives every profiler does nothing
+        constexpr int stackSignal = SIGURG;
+
+        // The watchdog names the target thread, the target claims the request and fills the frames itself
+        struct StackRequest
+        {
+            std::atomic<pthread_t>  target{ pthread_t() };
+            std::atomic<int>        numFrames{ -1 };
+            void*                   frames[maxStackFrames];
+        };
+
+        StackRequest sStackRequest;
+
+        // Whatever handled the signal before, a SIGURG that is not our request still reaches it
+        struct sigaction sPreviousAction = {};
+
+        void OnStackSignal(int signal, siginfo_t* info, void* context)
+        {
+            const int savedErrno = errno;
+
+            // Claiming lets the watchdog tell a handler that never ran from one that is still writing
+            pthread_t self = ::pthread_self();
+
+            if (sStackRequest.target.compare_exchange_strong(self, pthread_t(), std::memory_order_acquire))
+            {
+                const int numFrames = ::backtrace(sStackRequest.frames, maxStackFrames);
+                sStackRequest.numFrames.store(numFrames, std::memory_order_release);
+            }
+            else if ((sPreviousAction.sa_flags & SA_SIGINFO) != 0)
+            {
+                sPreviousAction.sa_sigaction(signal, info, context);
+            }
+            else if ((sPreviousAction.sa_handler != SIG_DFL) && (sPreviousAction.sa_handler != SIG_IGN))
+            {
+                sPreviousAction.sa_handler(signal);
+            }
+
+            errno = savedErrno;
+        }
+
+        void InstallStackSignal()
+        {
+            static std::once_flag installed;
+
+            std::call_once(installed, []()
+                {
+                    // The first backtrace loads the unwinder and allocates, which must not happen inside the handler
+                    void* warmUp[1];
+                    ::backtrace(warmUp, 1);
+
+                    struct sigaction action = {};
+                    action.sa_sigaction = OnStackSignal;
+                    action.sa_flags = SA_RESTART | SA_SIGINFO;
+                    ::sigemptyset(&action.sa_mask);
+
+                    if (::sigaction(stackSignal, &action, &sPreviousAction) != 0)
+                    {
+                        std::cerr << "[PROFILE] Failed to install the stack capture signal handler\n";
+                    }
+                });
+        }
+#endif // __linux__
+    }
+
+    HandlerProfiler::Scope::Scope(HandlerProfiler* profiler, const Session::OwnedMessage& ownedMsg)
+        : mProfiler(profiler)
+    {
+        if (mProfiler == nullptr)
+        {
+            return;
+        }
+
+        ThreadSlot& slot = mProfiler->GetThreadSlot();
+
+        mId = ownedMsg.msg.header.id;
+        mStart = SteadyNowNs();
+        mCpuStart = mProfiler->mConfig.measuresCpuTime ? ReadCpuTime(slot) : 0;
+
+        mProfiler->Begin(slot, ownedMsg, mStart, mCpuStart);
+    }
+
+    HandlerProfiler::Scope::~Scope()
+    {
+        if (mProfiler == nullptr)
+        {
+            return;
+        }
+
+        mProfiler->End(mProfiler->GetThreadSlot(), mId, mStart, mCpuStart);
+    }
+
+    HandlerProfiler::HandlerProfiler(ThreadPool& timerGroup, const Config& config)
+        : mConfig(config)
+        , mSlowNs(std::chrono::duration_cast<Nanoseconds>(config.slowThreshold).count())
+        , mTimer(timerGroup)
+    {}
+
+    HandlerProfiler::~HandlerProfiler()
+    {
+        mTimer.cancel();
+    }
+
+    HandlerProfiler::ThreadSlot::~ThreadSlot()
+    {
+#ifdef _WIN32
+        if (threadHandle != nullptr)
+        {
+            ::CloseHandle(threadHandle);
+        }
+#endif // _WIN32
+    }
+
+    void HandlerProfiler::Start()
+    {
+        std::cout << "[PROFILE] Started: slow handler threshold " << mConfig.slowThreshold.count() << "ms\n";
+
+#if defined(__linux__)
+        if (mConfig.capturesStack)
+        {
+            InstallStackSignal();
+        }
+#endif // __linux__
+
+        WaitWatchAsync();
+    }
+
+    std::vector<StatsSnapshot::HandlerEntry> HandlerProfiler::Collect() const
+    {
+        std::unordered_map<Message::Id, Entry> merged;
+
+        for (ThreadSlot* slot : CopySlots())
+        {
+            MutexLockGrd lock(slot->lock);
+
+            for (const auto& [id, entry] : slot->entries)
+            {
+                Entry& total = merged[id];
+                total.numCalls += entry.numCalls;
+                total.totalNs += entry.totalNs;
+                total.maxNs = std::max(total.maxNs, entry.maxNs);
+                total.cpuNs += entry.cpuNs;
+                total.numSlow += entry.numSlow;
+            }
+        }
+
+        std::vector<StatsSnapshot::HandlerEntry> handlers;
+        handlers.reserve(merged.size());
+
+        for (const auto& [id, entry] : merged)
+        {
+            handlers.push_back({ id, entry.numCalls, entry.totalNs, entry.maxNs, entry.cpuNs, entry.numSlow });
+        }
+
+        std::sort(handlers.begin(), handlers.end(),
+                  [](const StatsSnapshot::HandlerEntry& lhs, const StatsSnapshot::HandlerEntry& rhs)
+                  {
+                      return lhs.totalNs > rhs.totalNs;
+                  });
+
+        return handlers;
+    }
+
+    HandlerProfiler::ThreadSlot& HandlerProfiler::GetThreadSlot()
+    {
+        return mSlotCache.Get([this]()
+            {
+                UPtr<ThreadSlot> slot = std::make_unique<ThreadSlot>();
+                slot->threadId = std::this_thread::get_id();
+
+                // The watchdog reads the CPU clock of a thread other than its own and captures its stack
+#if defined(_WIN32)
+                slot->threadHandle = ::OpenThread(THREAD_QUERY_LIMITED_INFORMATION | THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT,
+                                                  FALSE, ::GetCurrentThreadId());
+#elif defined(__linux__)
+                slot->nativeThread = ::pthread_self();
+                ::pthread_getcpuclockid(slot->nativeThread, &slot->cpuClock);
+#endif
+
+                MutexLockGrd lock(mSlotsLock);
+                mSlots.push_back(std::move(slot));
+
+                return mSlots.back().get();
+            });
+    }
+
+    std::vector<HandlerProfiler::ThreadSlot*> HandlerProfiler::CopySlots() const
+    {
+        MutexLockGrd lock(mSlotsLock);
+
+        std::vector<ThreadSlot*> slots;
+        slots.reserve(mSlots.size());
+
+        for (const UPtr<ThreadSlot>& slot : mSlots)
+        {
+            slots.push_back(slot.get());
+        }
+
+        return slots;
+    }
+
+    void HandlerProfiler::Begin(ThreadSlot& slot, const Session::OwnedMessage& ownedMsg, const int64_t start, const int64_t cpuStart)
+    {
+        // Mark the slot as being written before the fields change, so the watchdog never pairs new fields with an old run
+        slot.runSequence.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        slot.runningId.store(ownedMsg.msg.header.id, std::memory_order_relaxed);
+        slot.runningSession.store(ownedMsg.owner ? ownedMsg.owner->GetId() : 0, std::memory_order_relaxed);
+        slot.runningTrace.store(ownedMsg.traceId, std::memory_order_relaxed);
+        slot.runningSince.store(start, std::memory_order_relaxed);
+        slot.runningCpuSince.store(cpuStart, std::memory_order_relaxed);
+
+        // Running, publishes the fields above to the watchdog
+        slot.runSequence.fetch_add(1, std::memory_order_release);
+    }
+
+    void HandlerProfiler::End(ThreadSlot& slot, const Message::Id id, const int64_t start, const int64_t cpuStart)
+    {
+        slot.runSequence.fetch_add(2, std::memory_order_release);
+
+        const int64_t elapsed = SteadyNowNs() - start;
+        const int64_t cpuElapsed = mConfig.measuresCpuTime ? (ReadCpuTime(slot) - cpuStart) : 0;
+        const bool isSlow = (elapsed > mSlowNs);
+
+        {
+            MutexLockGrd lock(slot.lock);
+
+            Entry& entry = slot.entries[id];
+            ++entry.numCalls;
+            entry.totalNs += elapsed;
+            entry.maxNs = std::max<uint64_t>(entry.maxNs, elapsed);
+            entry.cpuNs += std::max<int64_t>(cpuElapsed, 0);
+            entry.numSlow += isSlow ? 1 : 0;
+        }
+
+        if (isSlow)
+        {
+            // Also when the watchdog caught it running, so the final duration is known
+            ReportSlow(slot, id, slot.runningSession.load(std::memory_order_relaxed), slot.runningTrace.load(std::memory_order_relaxed),
+                       elapsed, cpuElapsed, true, std::string());
+        }
+    }
+
+    void HandlerProfiler::WaitWatchAsync()
+    {
+        // Checking twice per threshold catches a stalled handler at most 1.5 thresholds in
+        const Milliseconds interval = std::max(mConfig.slowThreshold / 2, Milliseconds(1));
+
+        mTimer.expires_after(interval);
+        mTimer.async_wait([this](const ErrCode& errCode)
+                          {
+                              if (errCode)
+                              {
+                                  return;
+                              }
+
+                              Watch();
+                              WaitWatchAsync();
+                          });
+    }
+
+    void HandlerProfiler::Watch()
+    {
+        const int64_t now = SteadyNowNs();
+
+        // A stack capture waits on the stalled thread, new threads must still be able to add their slots meanwhile
+        for (ThreadSlot* slot : CopySlots())
+        {
+            const uint64_t sequence = slot->runSequence.load(std::memory_order_acquire);
+
+            if (((sequence & 3) != 2) || (slot->reportedSequence.load(std::memory_order_relaxed) == sequence))
+            {
+                continue;
+            }
+
+            const Message::Id id = slot->runningId.load(std::memory_order_relaxed);
+            const Session::Id sessionId = slot->runningSession.load(std::memory_order_relaxed);
+            const Tracer::Id traceId = slot->runningTrace.load(std::memory_order_relaxed);
+            const int64_t since = slot->runningSince.load(std::memory_order_relaxed);
+            const int64_t cpuSince = slot->runningCpuSince.load(std::memory_order_relaxed);
+
+            // The fields belong to this run only if it is still the same run
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if ((slot->runSequence.load(std::memory_order_relaxed) != sequence) || (now - since <= mSlowNs))
+            {
+                continue;
+            }
+
+            const int64_t cpuElapsed = mConfig.measuresCpuTime ? (ReadCpuTime(*slot) - cpuSince) : 0;
+
+            // The handler may have finished meanwhile, then the stack shows whatever the thread runs next
+            const std::string stack = mConfig.capturesStack ? CaptureStack(*slot) : std::string();
+
+            slot->reportedSequence.store(sequence, std::memory_order_relaxed);
+            ReportSlow(*slot, id, sessionId, traceId, now - since, cpuElapsed, false, stack);
+        }
+    }
+
+    void HandlerProfiler::ReportSlow(const ThreadSlot& slot, const Message::Id id, const Session::Id sessionId, const Tracer::Id traceId,
+                                     const int64_t elapsed, const int64_t cpuElapsed, const bool finished, const std::string& stack) const
+    {
+        std::ostringstream oss;
+
+        oss << "[WATCHDOG] Slow handler " << (finished ? "finished" : "running")
+            << ": message " << id
+            << " from [" << sessionId << "]"
+            << " on thread " << slot.threadId
+            << ", " << (elapsed / 1'000'000) << "ms";
+
+        // CPU time close to the wall time means the handler computes, far below means it waits on a lock or I/O
+        if (mConfig.measuresCpuTime)
+        {
+            oss << " (cpu " << (cpuElapsed / 1'000'000) << "ms)";
+        }
+
+        if (traceId != 0)
+        {
+            oss << ", trace " << traceId;
+        }
+
+        if (!finished && mConfig.capturesStack)
+        {
+            oss << (stack.empty() ? "\n    stack unavailable" : "\n" + stack);
+        }
+
+        std::cerr << oss.str() << "\n";
+    }
+
+    std::string HandlerProfiler::CaptureStack(const ThreadSlot& slot)
+    {
+        // Suspending or signalling the calling thread would wait on itself
+        if (slot.threadId == std::this_thread::get_id())
+        {
+            return std::string();
+        }
+
+        MutexLockGrd lock(sStackLock);
+
+        std::ostringstream oss;
+
+#if defined(__linux__)
+        sStackRequest.numFrames.store(-1, std::memory_order_relaxed);
+        sStackRequest.target.store(slot.nativeThread, std::memory_order_release);
+
+        if (::pthread_kill(slot.nativeThread, stackSignal) != 0)
+        {
+            sStackRequest.target.store(pthread_t(), std::memory_order_relaxed);
+            return std::string();
+        }
+
+        const auto deadline = std::chrono::steady_clock::now() + stackCaptureTimeout;
+        int numFrames = -1;
+
+        while (((numFrames = sStackRequest.numFrames.load(std::memory_order_acquire)) < 0) &&
+               (std::chrono::steady_clock::now() < deadline))
+        {
+            std::this_thread::yield();
+        }
+
+        if (numFrames < 0)
+        {
+            // Unclaimed means the handler never ran and now never will, claimed means it is writing the frames
+            if (sStackRequest.target.exchange(pthread_t(), std::memory_order_acq_rel) != pthread_t())
+            {
+                return std::string();
+            }
+
+            while ((numFrames = sStackRequest.numFrames.load(std::memory_order_acquire)) < 0)
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        // Symbolized here on the watchdog thread, the signal handler only collects addresses
+        char** symbols = ::backtrace_symbols(sStackRequest.frames, numFrames);
+
+        // The first two frames are the signal handler and the kernel's return trampoline
+        const int firstFrame = std::min(numFrames, 2);
+
+        for (int idx = firstFrame; idx < numFrames; ++idx)
+        {
+            oss << "    #" << (idx - firstFrame) << " ";
+
+            if (symbols != nullptr)
+            {
+                oss << symbols[idx];
+            }
+            else
+            {
+                oss << sStackRequest.frames[idx];
+            }
+
+            oss << (idx + 1 < numFrames ? "\n" : "");
+        }
+
+        std::free(symbols);
+#elif defined(_WIN32) && defined(_M_X64)
+        if ((slot.threadHandle == nullptr) || (::SuspendThread(slot.threadHandle) == static_cast<DWORD>(-1)))
+        {
+            return std::string();
+        }
+
+        // Nothing may allocate while the thread is suspended, it can hold the heap lock
+        DWORD64 frames[maxStackFrames];
+        int numFrames = 0;
+
+        CONTEXT context = {};
+        context.ContextFlags = CONTEXT_FULL;
+
+        if (::GetThreadContext(slot.threadHandle, &context))
+        {
+            while ((numFrames < maxStackFrames) && (context.Rip != 0))
+            {
+                frames[numFrames++] = context.Rip;
+
+                DWORD64 imageBase = 0;
+                PRUNTIME_FUNCTION function = ::RtlLookupFunctionEntry(context.Rip, &imageBase, nullptr);
+
+                if (function == nullptr)
+                {
+                    // A leaf function has no unwind data and keeps the return address on top of the stack
+                    context.Rip = *reinterpret_cast<const DWORD64*>(context.Rsp);
+                    context.Rsp += sizeof(DWORD64);
+                    continue;
+                }
+
+                PVOID handlerData = nullptr;
+                DWORD64 establisherFrame = 0;
+
+                ::RtlVirtualUnwind(UNW_FLAG_NHANDLER, imageBase, context.Rip, function, &context,
+                                   &handlerData, &establisherFrame, nullptr);
+            }
+        }
+
+        ::ResumeThread(slot.threadHandle);
+
+        // module+offset, symbolized offline against the matching pdb
+        for (int idx = 0; idx < numFrames; ++idx)
+        {
+            oss << "    #" << idx << " ";
+
+            HMODULE module = nullptr;
+            char path[MAX_PATH] = {};
+
+            if (::GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                                     reinterpret_cast<LPCSTR>(frames[idx]), &module) &&
+                (::GetModuleFileNameA(module, path, MAX_PATH) != 0))
+            {
+                const char* name = std::strrchr(path, '\\');
+                oss << (name != nullptr ? name + 1 : path)
+                    << "+0x" << std::hex << (frames[idx] - reinterpret_cast<DWORD64>(module)) << std::dec;
+            }
+            else
+            {
+                oss << "0x" << std::hex << frames[idx] << std::dec;
+            }
+
+            oss << (idx + 1 < numFrames ? "\n" : "");
+        }
+#endif
+
+        return oss.str();
+    }
+
+    int64_t HandlerProfiler::ReadCpuTime(const ThreadSlot& slot)
+    {
+#if defined(_WIN32)
+        FILETIME creation, exit, kernel, user;
+
+        if ((slot.threadHandle == nullptr) || !::GetThreadTimes(slot.threadHandle, &creation, &exit, &kernel, &user))
+        {
+            return 0;
+        }
+
+        auto toNs = [](const FILETIME& time)
+            {
+                return ((static_cast<int64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) * 100;
+            };
+
+        return toNs(kernel) + toNs(user);
+#elif defined(__linux__)
+        timespec time;
+
+        if (::clock_gettime(slot.cpuClock, &time) != 0)
+        {
+            return 0;
+        }
+
+        return static_cast<int64_t>(time.tv_sec) * 1'000'000'000 + time.tv_nsec;
+#else
+        return 0;
+#endif
+    }
+}
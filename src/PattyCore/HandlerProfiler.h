@@ -0,0 +1,121 @@
+﻿#pragma once
+
+#include "Session.h"
+
+namespace PattyCore
+{
+    /*-----------------------*
+     *    HandlerProfiler    *
+     *-----------------------*/
+
+    // 메시지 id별로 핸들러의 호출 수, 총 시간, 최대 시간, CPU 시간을 스레드별 슬롯에 모은다
+    // watchdog 타이머는 실행 중인 핸들러를 훑어서 slowThreshold를 넘긴 것을 그 자리에서 알린다
+    // 알릴 때의 CPU 시간으로 핸들러가 연산 중인지 락이나 입출력에 막혀 있는지 구분할 수 있다
+    // capturesStack이면 실행 중인 핸들러를 알릴 때 그 스레드의 호출 스택도 남긴다
+    // 리눅스는 시그널을 보내 그 스레드가 backtrace를 뜨게 하고, 윈도우 x64는 스레드를 잠시 멈추고 unwind한다
+    class HandlerProfiler
+    {
+    public:
+        struct Config
+        {
+            Milliseconds    slowThreshold = Milliseconds(100);
+            bool            measuresCpuTime = true;     // 스레드 CPU 시계는 시스템 호출이라 핸들러마다 수백 ns가 든다
+            bool            capturesStack = true;       // 리눅스에서는 SIGURG 핸들러를 설치한다, 원래 핸들러는 이어서 호출한다
+        };
+
+        /*-------------*
+         *    Scope    *
+         *-------------*/
+
+        // 핸들러 하나를 감싼다, profiler가 nullptr이면 아무것도 하지 않는다
+        class Scope
+        {
+        public:
+            Scope(HandlerProfiler* profiler, const Session::OwnedMessage& ownedMsg);
+            ~Scope();
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+        private:
+            HandlerProfiler*    mProfiler;
+            Message::Id         mId = 0;
+            int64_t             mStart = 0;
+            int64_t             mCpuStart = 0;
+        };
+
+    public:
+        HandlerProfiler(ThreadPool& timerGroup, const Config& config);
+        ~HandlerProfiler();
+        HandlerProfiler(const HandlerProfiler&) = delete;
+        HandlerProfiler& operator=(const HandlerProfiler&) = delete;
+
+        void Start();
+
+        // 총 시간이 긴 순으로 정렬한다
+        std::vector<StatsSnapshot::HandlerEntry> Collect() const;
+
+    private:
+        struct Entry
+        {
+            uint64_t    numCalls = 0;
+            uint64_t    totalNs = 0;
+            uint64_t    maxNs = 0;
+            uint64_t    cpuNs = 0;
+            uint64_t    numSlow = 0;
+        };
+
+        // 주인 스레드가 핸들러마다 쓰고, watchdog과 Collect가 읽는다
+        struct alignas(64) ThreadSlot
+        {
+            std::thread::id             threadId;
+
+            // 실행 중인 핸들러, runSequence를 4로 나눈 나머지가 1이면 쓰는 중, 2면 실행 중, 0이면 쉬는 중이다
+            std::atomic<uint64_t>       runSequence = 0;
+            std::atomic<Message::Id>    runningId = 0;
+            std::atomic<Session::Id>    runningSession = 0;
+            std::atomic<Tracer::Id>     runningTrace = 0;
+            std::atomic<int64_t>        runningSince = 0;
+            std::atomic<int64_t>        runningCpuSince = 0;
+            std::atomic<uint64_t>       reportedSequence = 0;   // watchdog이 이미 알린 실행
+
+#if defined(_WIN32)
+            HANDLE                      threadHandle = nullptr;
+#elif defined(__linux__)
+            clockid_t                   cpuClock = CLOCK_THREAD_CPUTIME_ID;
+            pthread_t                   nativeThread = pthread_t();
+#endif
+
+            Mutex                                   lock;       // Collect할 때만 경합한다
+            std::unordered_map<Message::Id, Entry>  entries;
+
+            ~ThreadSlot();
+        };
+
+        ThreadSlot& GetThreadSlot();
+
+        // 슬롯은 프로파일러가 없어질 때까지 남아 있으므로 포인터만 복사하고 락을 놓는다
+        std::vector<ThreadSlot*> CopySlots() const;
+
+        void Begin(ThreadSlot& slot, const Session::OwnedMessage& ownedMsg, const int64_t start, const int64_t cpuStart);
+        void End(ThreadSlot& slot, const Message::Id id, const int64_t start, const int64_t cpuStart);
+
+        void WaitWatchAsync();
+        void Watch();
+        void ReportSlow(const ThreadSlot& slot, const Message::Id id, const Session::Id sessionId, const Tracer::Id traceId,
+                        const int64_t elapsed, const int64_t cpuElapsed, const bool finished, const std::string& stack) const;
+
+        // 한 줄에 프레임 하나, 뜰 수 없으면 빈 문자열
+        static std::string CaptureStack(const ThreadSlot& slot);
+
+        static int64_t ReadCpuTime(const ThreadSlot& slot);
+
+    private:
+        const Config                    mConfig;
+        const int64_t                   mSlowNs;
+        Timer                           mTimer;
+
+        ThreadCache<ThreadSlot>         mSlotCache;
+        std::vector<UPtr<ThreadSlot>>   mSlots;
+        mutable Mutex                   mSlotsLock;     // 추가와 복사만 한다, 슬롯을 읽는 동안에는 잡지 않는다
+    };
+}
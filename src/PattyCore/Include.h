@@ -6,16 +6,38 @@
 
 #include <cassert>
 #include <memory>
+#include <atomic>
 #include <utility>
 #include <queue>
+#include <deque>
 #include <vector>
+#include <algorithm>
+#include <array>
 #include <unordered_map>
 #include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <fstream>
+#include <string>
 #include <chrono>
+#include <ctime>
 #include <cstdint>
 #include <cstddef>
+#include <cmath>
+#include <limits>
 #include <type_traits>
+#include <tuple>
+#include <mutex>
 #include <shared_mutex>
+#include <thread>
+#include <condition_variable>
+#include <future>
+#include <random>
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <time.h>
+#endif // _WIN32
 
 /*------------*
  *    Asio    *
@@ -26,6 +48,13 @@
 #define _WIN32_WINNT    0x0A00
 #endif // _WIN32
 
+// 리눅스에서 PATTYCORE_IO_URING을 정의하고 liburing을 링크하면
+// epoll 대신 io_uring 백엔드로 소켓 입출력을 처리한다
+#if defined(__linux__) && defined(PATTYCORE_IO_URING)
+#define ASIO_HAS_IO_URING
+#define ASIO_DISABLE_EPOLL
+#endif // __linux__ && PATTYCORE_IO_URING
+
 #define ASIO_STANDALONE
 #include <asio.hpp>
 
@@ -33,5 +62,8 @@
  *    PattyCore    *
  *-----------------*/
 
+// PATTYCORE_VIRTUAL_TIME을 정의하면 Timer가 VirtualClock::Advance로만 흐른다
+#include "VirtualClock.h"
 #include "TypeAliases.h"
 #include "LockBuffer.h"
+#include "ThreadCache.h"
@@ -0,0 +1,364 @@
+﻿#include "Pch.h"
+#include "InterestGrid.h"
+
+namespace PattyCore
+{
+    InterestGrid::InterestGrid(const float cellSize)
+        : mCellSize(cellSize)
+    {
+        assert(cellSize > 0.0f);
+    }
+
+    bool InterestGrid::SetCellSize(const float cellSize)
+    {
+        MutexLockGrd lock(mEntriesLock);
+
+        if (!mEntries.empty() || !(cellSize > 0.0f))
+        {
+            return false;
+        }
+
+        mCellSize = cellSize;
+
+        return true;
+    }
+
+    void InterestGrid::Update(const Session::Ptr& session, const Position& position, const float radius)
+    {
+        // A closed session is never removed by UnregisterSession again
+        if (session->IsClosed())
+        {
+            return;
+        }
+
+        const CellRange range = ToCellRange(position, radius);
+        const Session::Id sessionId = session->GetId();
+
+        SPtr<Entry> entry;
+
+        {
+            MutexLockGrd lock(mEntriesLock);
+
+            SPtr<Entry>& slot = mEntries[sessionId];
+
+            if (slot == nullptr)
+            {
+                slot = std::make_shared<Entry>();
+            }
+
+            entry = slot;
+        }
+
+        const Member member{ sessionId, session, position, radius * radius };
+
+        {
+            MutexLockGrd lock(entry->lock);
+
+            if (entry->removed)
+            {
+                return;
+            }
+
+            // Most moves stay within the same cells
+            if (entry->cells == range)
+            {
+                Replace(member, range);
+            }
+            else
+            {
+                Erase(sessionId, entry->cells);
+                Insert(member, range);
+                entry->cells = range;
+            }
+        }
+
+        // The session is marked closed before it is unregistered, so either Remove saw this entry or this sees the close
+        if (session->IsClosed())
+        {
+            Remove(sessionId);
+        }
+    }
+
+    bool InterestGrid::Remove(const Session::Ptr& session)
+    {
+        return Remove(session->GetId());
+    }
+
+    size_t InterestGrid::Publish(const Position& position, const Message& msg, const Session::Id ignoredId)
+    {
+        size_t numSent = 0;
+        std::vector<Session::Id> deadIds;
+
+        // Cells are coarse, the exact distance decides
+        auto sendIfInRange = [&position, &msg, ignoredId, &numSent, &deadIds](const Member& member)
+            {
+                const float dx = member.position.x - position.x;
+                const float dy = member.position.y - position.y;
+
+                if ((member.id == ignoredId) || (dx * dx + dy * dy > member.radiusSq))
+                {
+                    return;
+                }
+
+                const Session::Ptr session = member.session.lock();
+
+                if ((session == nullptr) || session->IsClosed())
+                {
+                    deadIds.push_back(member.id);
+                    return;
+                }
+
+                session->SendAsync(Message(msg));
+                ++numSent;
+            };
+
+        const int32_t cellX = ToCell(position.x);
+        const int32_t cellY = ToCell(position.y);
+
+        {
+            const Shard& shard = GetShard(ToRegion(cellX), ToRegion(cellY));
+            SMutexSLock lock(shard.lock);
+
+            auto cellIter = shard.cells.find(MakeKey(cellX, cellY));
+
+            if (cellIter != shard.cells.end())
+            {
+                for (const Member& member : cellIter->second)
+                {
+                    sendIfInRange(member);
+                }
+            }
+        }
+
+        {
+            SMutexSLock lock(mWideLock);
+
+            for (const Member& member : mWideMembers)
+            {
+                sendIfInRange(member);
+            }
+        }
+
+        // Removed after the shared locks are released, Remove takes them exclusively
+        for (const Session::Id deadId : deadIds)
+        {
+            Remove(deadId);
+        }
+
+        return numSent;
+    }
+
+    size_t InterestGrid::GetNumSessions() const
+    {
+        MutexLockGrd lock(mEntriesLock);
+
+        return mEntries.size();
+    }
+
+    bool InterestGrid::CellRange::operator==(const CellRange& other) const
+    {
+        return (minX == other.minX) && (minY == other.minY) && (maxX == other.maxX) && (maxY == other.maxY);
+    }
+
+    int32_t InterestGrid::ToCell(const float coord) const
+    {
+        // Far-off or NaN coordinates are clamped so cell arithmetic never overflows
+        constexpr float limit = static_cast<float>(std::numeric_limits<int32_t>::max() / 2);
+        const float cell = std::floor(coord / mCellSize);
+
+        if (!(cell > -limit))
+        {
+            return (cell < 0.0f) ? -static_cast<int32_t>(limit) : 0;
+        }
+
+        return static_cast<int32_t>(std::min(cell, limit));
+    }
+
+    InterestGrid::CellRange InterestGrid::ToCellRange(const Position& position, const float radius) const
+    {
+        const float extent = std::max(radius, 0.0f);
+
+        CellRange range;
+        range.minX = ToCell(position.x - extent);
+        range.minY = ToCell(position.y - extent);
+        range.maxX = ToCell(position.x + extent);
+        range.maxY = ToCell(position.y + extent);
+
+        return range;
+    }
+
+    InterestGrid::CellKey InterestGrid::MakeKey(const int32_t x, const int32_t y)
+    {
+        return (static_cast<CellKey>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+    }
+
+    int32_t InterestGrid::ToRegion(const int32_t cell)
+    {
+        // Rounds toward negative infinity, so the cells either side of 0 fall in different regions
+        return (cell >= 0) ? (cell / regionSpan) : -((-cell - 1) / regionSpan) - 1;
+    }
+
+    InterestGrid::Shard& InterestGrid::GetShard(const int32_t regionX, const int32_t regionY)
+    {
+        // Neighbouring regions must not share a shard, so the key is mixed before it is reduced
+        const uint64_t hash = MakeKey(regionX, regionY) * 0x9E3779B97F4A7C15;
+
+        return mShards[(hash >> 32) % numShards];
+    }
+
+    bool InterestGrid::IsWide(const CellRange& range)
+    {
+        const uint64_t width = static_cast<uint64_t>(static_cast<int64_t>(range.maxX) - range.minX + 1);
+        const uint64_t height = static_cast<uint64_t>(static_cast<int64_t>(range.maxY) - range.minY + 1);
+
+        return width * height > maxCellsPerSession;
+    }
+
+    void InterestGrid::RemoveFrom(Cell& cell, const Session::Id sessionId)
+    {
+        auto iter = std::find_if(cell.begin(), cell.end(),
+                                 [sessionId](const Member& member)
+                                 {
+                                     return member.id == sessionId;
+                                 });
+
+        if (iter != cell.end())
+        {
+            *iter = std::move(cell.back());
+            cell.pop_back();
+        }
+    }
+
+    template<typename TFunc>
+    void InterestGrid::ForEachCell(const CellRange& range, TFunc&& func)
+    {
+        // A session spans a few cells, usually within one or two regions, so each lock is taken once per region
+        for (int32_t regionX = ToRegion(range.minX); regionX <= ToRegion(range.maxX); ++regionX)
+        {
+            for (int32_t regionY = ToRegion(range.minY); regionY <= ToRegion(range.maxY); ++regionY)
+            {
+                const int32_t minX = std::max(range.minX, regionX * regionSpan);
+                const int32_t maxX = std::min(range.maxX, regionX * regionSpan + regionSpan - 1);
+                const int32_t minY = std::max(range.minY, regionY * regionSpan);
+                const int32_t maxY = std::min(range.maxY, regionY * regionSpan + regionSpan - 1);
+
+                Shard& shard = GetShard(regionX, regionY);
+                SMutexULock lock(shard.lock);
+
+                for (int32_t x = minX; x <= maxX; ++x)
+                {
+                    for (int32_t y = minY; y <= maxY; ++y)
+                    {
+                        func(shard.cells, MakeKey(x, y));
+                    }
+                }
+            }
+        }
+    }
+
+    void InterestGrid::Insert(const Member& member, const CellRange& range)
+    {
+        if (IsWide(range))
+        {
+            SMutexULock lock(mWideLock);
+            mWideMembers.push_back(member);
+
+            return;
+        }
+
+        ForEachCell(range, [&member](CellMap& cells, const CellKey key)
+                    {
+                        cells[key].push_back(member);
+                    });
+    }
+
+    void InterestGrid::Replace(const Member& member, const CellRange& range)
+    {
+        auto replaceIn = [&member](Cell& cell)
+            {
+                for (Member& old : cell)
+                {
+                    if (old.id == member.id)
+                    {
+                        old.position = member.position;
+                        old.radiusSq = member.radiusSq;
+
+                        return;
+                    }
+                }
+            };
+
+        if (IsWide(range))
+        {
+            SMutexULock lock(mWideLock);
+            replaceIn(mWideMembers);
+
+            return;
+        }
+
+        ForEachCell(range, [&replaceIn](CellMap& cells, const CellKey key)
+                    {
+                        auto iter = cells.find(key);
+
+                        if (iter != cells.end())
+                        {
+                            replaceIn(iter->second);
+                        }
+                    });
+    }
+
+    void InterestGrid::Erase(const Session::Id sessionId, const CellRange& range)
+    {
+        if (IsWide(range))
+        {
+            SMutexULock lock(mWideLock);
+            RemoveFrom(mWideMembers, sessionId);
+
+            return;
+        }
+
+        ForEachCell(range, [sessionId](CellMap& cells, const CellKey key)
+                    {
+                        auto iter = cells.find(key);
+
+                        if (iter == cells.end())
+                        {
+                            return;
+                        }
+
+                        RemoveFrom(iter->second, sessionId);
+
+                        if (iter->second.empty())
+                        {
+                            cells.erase(iter);
+                        }
+                    });
+    }
+
+    bool InterestGrid::Remove(const Session::Id sessionId)
+    {
+        SPtr<Entry> entry;
+
+        {
+            MutexLockGrd lock(mEntriesLock);
+
+            auto iter = mEntries.find(sessionId);
+
+            if (iter == mEntries.end())
+            {
+                return false;
+            }
+
+            entry = std::move(iter->second);
+            mEntries.erase(iter);
+        }
+
+        // An Update that already holds the entry sees removed and leaves the cells alone
+        MutexLockGrd lock(entry->lock);
+
+        Erase(sessionId, entry->cells);
+        entry->removed = true;
+
+        return true;
+    }
+}
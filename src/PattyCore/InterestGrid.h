@@ -0,0 +1,110 @@
+﻿#pragma once
+
+#include "Session.h"
+
+namespace PattyCore
+{
+    /*--------------------*
+     *    InterestGrid    *
+     *--------------------*/
+
+    // 세션마다 평면 위의 위치와 관심 반경을 두고, 어떤 위치에서 생긴 메시지를 그 위치를 관심 반경에 둔 세션들에만 보낸다
+    // 세션은 관심 영역이 걸치는 모든 셀에 들어가므로 발행은 위치가 속한 셀 하나만 훑는다
+    // 셀은 regionSpan x regionSpan 영역 단위로 numShards개의 잠금에 나눠 담으므로 발행은 다른 영역의 갱신을 막지 않는다
+    class InterestGrid
+    {
+    public:
+        static constexpr float defaultCellSize = 64.0f;
+        static constexpr size_t maxCellsPerSession = 256;   // 이보다 많은 셀에 걸치는 세션은 발행마다 따로 검사한다
+        static constexpr int32_t regionSpan = 8;            // 잠금 하나가 지키는 영역의 한 변, 셀 단위
+        static constexpr size_t numShards = 64;             // 영역들을 해시해서 나눠 갖는 잠금 수
+
+        struct Position
+        {
+            float   x = 0.0f;
+            float   y = 0.0f;
+        };
+
+    public:
+        // cellSize는 흔히 쓰는 관심 반경 정도가 알맞다, 작으면 세션이 들어가는 셀이 많아지고 크면 발행이 훑는 세션이 많아진다
+        explicit InterestGrid(const float cellSize = defaultCellSize);
+        InterestGrid(const InterestGrid&) = delete;
+        InterestGrid& operator=(const InterestGrid&) = delete;
+
+        // 등록된 세션이 없을 때만 바꿀 수 있다
+        bool SetCellSize(const float cellSize);
+
+        // 세션의 위치와 관심 반경을 등록하거나 갱신한다, 걸치는 셀이 그대로면 위치만 바꾼다
+        // 세션은 약하게 들고 있고 닫힌 세션은 등록하지 않는다
+        void Update(const Session::Ptr& session, const Position& position, const float radius);
+        bool Remove(const Session::Ptr& session);
+
+        // position이 관심 반경 안에 있는 세션들에 보내고 보낸 수를 돌려준다, 그중 닫힌 세션은 뺀다
+        size_t Publish(const Position& position, const Message& msg, const Session::Id ignoredId);
+        size_t GetNumSessions() const;
+
+    private:
+        using CellKey = uint64_t;   // (x << 32) | y, 셀 좌표는 int32
+
+        struct CellRange
+        {
+            int32_t     minX = 0;
+            int32_t     minY = 0;
+            int32_t     maxX = -1;
+            int32_t     maxY = -1;
+
+            bool operator==(const CellRange& other) const;
+        };
+
+        // 발행이 셀의 잠금만 잡도록 세션의 위치를 셀마다 복사해 둔다
+        struct Member
+        {
+            Session::Id     id = 0;
+            WPtr<Session>   session;
+            Position        position;
+            float           radiusSq = 0.0f;
+        };
+
+        using Cell = std::vector<Member>;
+        using CellMap = std::unordered_map<CellKey, Cell>;
+
+        struct Shard
+        {
+            CellMap         cells;
+            mutable SMutex  lock;
+        };
+
+        struct Entry
+        {
+            Mutex           lock;           // 같은 세션의 갱신과 제거를 직렬화한다
+            CellRange       cells;          // IsWide면 셀 대신 mWideMembers에 들어간다
+            bool            removed = false;
+        };
+
+        int32_t ToCell(const float coord) const;
+        CellRange ToCellRange(const Position& position, const float radius) const;
+        static CellKey MakeKey(const int32_t x, const int32_t y);
+        static int32_t ToRegion(const int32_t cell);
+        Shard& GetShard(const int32_t regionX, const int32_t regionY);
+
+        static bool IsWide(const CellRange& range);
+        static void RemoveFrom(Cell& cell, const Session::Id sessionId);
+
+        // range의 셀들을 영역 단위로 그 영역의 잠금을 잡고 방문한다
+        template<typename TFunc>
+        void ForEachCell(const CellRange& range, TFunc&& func);
+
+        void Insert(const Member& member, const CellRange& range);
+        void Replace(const Member& member, const CellRange& range);
+        void Erase(const Session::Id sessionId, const CellRange& range);
+        bool Remove(const Session::Id sessionId);
+
+    private:
+        float                                               mCellSize;
+        std::array<Shard, numShards>                        mShards;
+        Cell                                                mWideMembers;   // maxCellsPerSession보다 넓은 세션
+        mutable SMutex                                      mWideLock;
+        std::unordered_map<Session::Id, SPtr<Entry>>        mEntries;
+        mutable Mutex                                       mEntriesLock;   // 발행은 잡지 않는다
+    };
+}
@@ -0,0 +1,200 @@
+﻿#include "Pch.h"
+#include "MemoryPipe.h"
+
+namespace PattyCore
+{
+    std::pair<MemoryPipe::Ptr, MemoryPipe::Ptr> MemoryPipe::CreatePair(const Executor& first, const Executor& second)
+    {
+        Ptr firstEnd = std::make_shared<MemoryPipe>(first);
+        Ptr secondEnd = std::make_shared<MemoryPipe>(second);
+
+        // Both ends take the same lock so a write and the peer's read never race
+        secondEnd->mLock = firstEnd->mLock;
+        firstEnd->mPeer = secondEnd;
+        secondEnd->mPeer = firstEnd;
+
+        return { std::move(firstEnd), std::move(secondEnd) };
+    }
+
+    MemoryPipe::MemoryPipe(const Executor& executor)
+        : mExecutor(executor)
+        , mLock(std::make_shared<Mutex>())
+    {}
+
+    MemoryPipe::~MemoryPipe()
+    {
+        Close();
+    }
+
+    const MemoryPipe::Executor& MemoryPipe::GetExecutor() const noexcept
+    {
+        return mExecutor;
+    }
+
+    bool MemoryPipe::IsOpen() const
+    {
+        MutexLockGrd lock(*mLock);
+
+        return mIsOpen;
+    }
+
+    void MemoryPipe::Close()
+    {
+        MutexLockGrd lock(*mLock);
+
+        CloseLocked();
+    }
+
+    void MemoryPipe::StartRead(const asio::mutable_buffer& buffer, Completion&& completion)
+    {
+        MutexLockGrd lock(*mLock);
+
+        if (!mIsOpen)
+        {
+            completion.Post(asio::error::bad_descriptor, 0);
+            return;
+        }
+
+        if (mInboundBegin < mInbound.size())
+        {
+            completion.Post(ErrCode(), ConsumeLocked(buffer));
+            return;
+        }
+
+        if (mIsPeerClosed)
+        {
+            completion.Post(asio::error::eof, 0);
+            return;
+        }
+
+        assert(!mPendingRead);
+        mReadBuffer = buffer;
+        mPendingRead = std::move(completion);
+    }
+
+    void MemoryPipe::StartWrite(const std::vector<asio::const_buffer>& buffers, Completion&& completion)
+    {
+        MutexLockGrd lock(*mLock);
+
+        if (!mIsOpen)
+        {
+            completion.Post(asio::error::bad_descriptor, 0);
+            return;
+        }
+
+        Ptr peer = mPeer.lock();
+
+        if ((peer == nullptr) || !peer->mIsOpen)
+        {
+            completion.Post(asio::error::broken_pipe, 0);
+            return;
+        }
+
+        size_t numBytes = 0;
+
+        for (const asio::const_buffer& buffer : buffers)
+        {
+            const std::byte* data = static_cast<const std::byte*>(buffer.data());
+
+            peer->mInbound.insert(peer->mInbound.end(), data, data + buffer.size());
+            numBytes += buffer.size();
+        }
+
+        peer->DeliverLocked();
+        completion.Post(ErrCode(), numBytes);
+    }
+
+    void MemoryPipe::StartWait(Completion&& completion)
+    {
+        MutexLockGrd lock(*mLock);
+
+        if (!mIsOpen)
+        {
+            completion.Post(asio::error::bad_descriptor, 0);
+            return;
+        }
+
+        if ((mInboundBegin < mInbound.size()) || mIsPeerClosed)
+        {
+            completion.Post(ErrCode(), 0);
+            return;
+        }
+
+        assert(!mPendingWait);
+        mPendingWait = std::move(completion);
+    }
+
+    size_t MemoryPipe::ConsumeLocked(const asio::mutable_buffer& buffer)
+    {
+        const size_t numBytes = std::min(buffer.size(), mInbound.size() - mInboundBegin);
+
+        std::memcpy(buffer.data(), mInbound.data() + mInboundBegin, numBytes);
+        mInboundBegin += numBytes;
+
+        // Drop the consumed front once it is all consumed or outweighs the rest
+        if (mInboundBegin == mInbound.size())
+        {
+            mInbound.clear();
+            mInboundBegin = 0;
+        }
+        else if (mInboundBegin * 2 >= mInbound.size())
+        {
+            mInbound.erase(mInbound.begin(), mInbound.begin() + mInboundBegin);
+            mInboundBegin = 0;
+        }
+
+        return numBytes;
+    }
+
+    void MemoryPipe::DeliverLocked()
+    {
+        if (mPendingWait)
+        {
+            mPendingWait.Post(ErrCode(), 0);
+        }
+
+        if (!mPendingRead)
+        {
+            return;
+        }
+
+        if (mInboundBegin < mInbound.size())
+        {
+            mPendingRead.Post(ErrCode(), ConsumeLocked(mReadBuffer));
+        }
+        else if (mIsPeerClosed)
+        {
+            mPendingRead.Post(asio::error::eof, 0);
+        }
+    }
+
+    void MemoryPipe::CloseLocked()
+    {
+        if (!mIsOpen)
+        {
+            return;
+        }
+
+        mIsOpen = false;
+        mInbound.clear();
+        mInboundBegin = 0;
+
+        if (mPendingRead)
+        {
+            mPendingRead.Post(asio::error::operation_aborted, 0);
+        }
+
+        if (mPendingWait)
+        {
+            mPendingWait.Post(asio::error::operation_aborted, 0);
+        }
+
+        Ptr peer = mPeer.lock();
+
+        if (peer != nullptr)
+        {
+            peer->mIsPeerClosed = true;
+            peer->DeliverLocked();
+        }
+    }
+}
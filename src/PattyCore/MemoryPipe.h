@@ -0,0 +1,147 @@
+﻿#pragma once
+
+namespace PattyCore
+{
+    /*------------------*
+     *    MemoryPipe    *
+     *------------------*/
+
+    // 같은 프로세스 안의 두 끝을 잇는 바이트 스트림, 커널 소켓 없이 세션을 연결한다
+    // 완료 핸들러는 연결된 실행기(없으면 끝의 실행기)에 게시되므로 소켓과 같은 순서 보장을 따른다
+    // 쓰기는 상대의 수신 대기열에 바로 복사되고 흐름 제어는 하지 않는다
+    class MemoryPipe
+    {
+    public:
+        using Ptr = SPtr<MemoryPipe>;
+        using Executor = asio::any_io_executor;
+
+    private:
+        /*------------------*
+         *    Completion    *
+         *------------------*/
+
+        // 이동만 가능한 완료 핸들러를 담는다, (ErrCode, size_t)와 (ErrCode) 모두 받는다
+        class Completion
+        {
+        public:
+            Completion() = default;
+
+            template<typename THandler>
+            Completion(THandler&& handler, const Executor& fallback)
+                : mImpl(std::make_unique<Impl<std::decay_t<THandler>>>(std::forward<THandler>(handler), fallback))
+            {}
+
+            explicit operator bool() const noexcept { return mImpl != nullptr; }
+
+            // 한 번만 호출할 수 있다
+            void Post(const ErrCode& errCode, const size_t numBytes)
+            {
+                UPtr<ImplBase> impl = std::move(mImpl);
+                impl->Post(errCode, numBytes);
+            }
+
+        private:
+            struct ImplBase
+            {
+                virtual ~ImplBase() = default;
+                virtual void Post(const ErrCode& errCode, const size_t numBytes) = 0;
+            };
+
+            template<typename THandler>
+            struct Impl : ImplBase
+            {
+                template<typename TArg>
+                Impl(TArg&& handler, const Executor& fallback)
+                    : handler(std::forward<TArg>(handler))
+                    , fallback(fallback)
+                {}
+
+                void Post(const ErrCode& errCode, const size_t numBytes) override
+                {
+                    auto executor = asio::get_associated_executor(handler, fallback);
+
+                    asio::post(executor,
+                               [handler = std::move(handler), errCode, numBytes]() mutable
+                               {
+                                   if constexpr (std::is_invocable_v<THandler&, const ErrCode&, size_t>)
+                                   {
+                                       handler(errCode, numBytes);
+                                   }
+                                   else
+                                   {
+                                       handler(errCode);
+                                   }
+                               });
+                }
+
+                THandler    handler;
+                Executor    fallback;
+            };
+
+            UPtr<ImplBase>  mImpl;
+        };
+
+    public:
+        // first와 second는 각 끝의 기본 실행기
+        static std::pair<Ptr, Ptr> CreatePair(const Executor& first, const Executor& second);
+
+        explicit MemoryPipe(const Executor& executor);
+        ~MemoryPipe();
+        MemoryPipe(const MemoryPipe&) = delete;
+        MemoryPipe& operator=(const MemoryPipe&) = delete;
+
+        const Executor& GetExecutor() const noexcept;
+
+        template<typename THandler>
+        void AsyncReadSome(const asio::mutable_buffer& buffer, THandler&& handler)
+        {
+            StartRead(buffer, Completion(std::forward<THandler>(handler), mExecutor));
+        }
+
+        // 버퍼 시퀀스를 모두 쓰고 완료한다
+        template<typename TBuffers, typename THandler>
+        void AsyncWrite(const TBuffers& buffers, THandler&& handler)
+        {
+            const std::vector<asio::const_buffer> sequence(asio::buffer_sequence_begin(buffers), asio::buffer_sequence_end(buffers));
+
+            StartWrite(sequence, Completion(std::forward<THandler>(handler), mExecutor));
+        }
+
+        // 읽을 데이터가 있거나 상대가 닫으면 완료한다
+        template<typename THandler>
+        void AsyncWaitReadable(THandler&& handler)
+        {
+            StartWait(Completion(std::forward<THandler>(handler), mExecutor));
+        }
+
+        bool IsOpen() const;
+
+        // 기다리는 작업은 operation_aborted로, 상대가 기다리는 읽기는 eof로 완료된다
+        void Close();
+
+    private:
+        void StartRead(const asio::mutable_buffer& buffer, Completion&& completion);
+        void StartWrite(const std::vector<asio::const_buffer>& buffers, Completion&& completion);
+        void StartWait(Completion&& completion);
+
+        // 잠근 상태에서 호출한다
+        size_t ConsumeLocked(const asio::mutable_buffer& buffer);
+        void DeliverLocked();
+        void CloseLocked();
+
+    private:
+        const Executor          mExecutor;
+        SPtr<Mutex>             mLock;          // 두 끝이 공유한다
+        WPtr<MemoryPipe>        mPeer;
+
+        bool                    mIsOpen = true;
+        bool                    mIsPeerClosed = false;
+
+        std::vector<std::byte>  mInbound;       // 상대가 쓴 바이트
+        size_t                  mInboundBegin = 0;
+
+        asio::mutable_buffer    mReadBuffer;
+        Completion              mPendingRead;
+        Completion              mPendingWait;
+    };
+}
@@ -13,6 +13,32 @@ namespace PattyCore
         using Payload       = std::vector<std::byte>;
         using Ptr           = UPtr<Message>;
 
+        // PattyCore가 내부적으로 처리하는 메시지 id
+        // OnMessageReceived로 전달되지 않는다
+        enum class SystemId : Id
+        {
+            Begin           = 0xFFFF0000,
+            DatagramBind    = Begin,        // 데이터그램 채널 토큰 전달
+            StatsQuery,                     // 통계 요청, payload: StatsSnapshot::Format
+            StatsReply,                     // 통계 응답, payload: 문자열
+            FramingOffer,                   // Compact 프레이밍 제안, 세션에서 처리한다
+            FramingSwitch,                  // 이 메시지 이후로 송신 측이 Compact 프레이밍을 쓴다
+            ResumeRequest,                  // 재개 토큰 요청 또는 끊긴 세션의 재연결, 세션에서 처리한다
+            ResumeGrant,                    // 재개 토큰 발급 또는 재개 결과
+            ResumeAck,                      // 받은 메시지의 마지막 순번, 상대가 journal을 비운다
+            ChecksumOffer,                  // 프레임 체크섬 제안, 세션에서 처리한다
+            ChecksumSwitch,                 // 이 메시지 이후로 송신 측이 프레임마다 체크섬을 붙인다
+            ReplicaSnapshot,                // 복제 상태 전체, 서비스에서 처리한다
+            ReplicaDelta,                   // 응답한 tick과 달라진 바이트 구간
+            ReplicaAck,                     // 적용한 tick, 이후 델타의 기준이 된다
+            DatagramBound,                  // 데이터그램으로 상대의 끝점을 알았다, 상대는 hello 재전송을 멈춘다
+        };
+
+        static bool IsSystemId(const Id id)
+        {
+            return id >= static_cast<Id>(SystemId::Begin);
+        }
+
         /*--------------*
          *    Header    *
          *--------------*/
@@ -83,6 +109,7 @@ namespace PattyCore
 
         OwnerPtr    owner;
         Message     msg;
+        uint64_t    traceId = 0;    // Tracer::Id, 표본으로 뽑히지 않았으면 0
 
         OwnedMessage() = default;
 
@@ -0,0 +1,366 @@
+﻿#pragma once
+
+#include "Message.h"
+
+namespace PattyCore
+{
+    /*----------------*
+     *    VarArray    *
+     *----------------*/
+
+    // 가변 길이 구간
+    // 고정 영역에는 원소 개수(uint32)만 들어가고, 원소들은 고정 영역 뒤에 선언 순서대로 놓인다
+    template<typename TElem>
+    struct VarArray
+    {
+        static_assert(std::is_standard_layout<TElem>::value, "TElem must be standard-layout type");
+    };
+
+    using VarBytes = VarArray<std::byte>;
+
+    /*-----------------*
+     *    ArrayView    *
+     *-----------------*/
+
+    // payload 위의 가변 길이 구간, 원소는 정렬되지 않았을 수 있으므로 복사해서 읽는다
+    template<typename TElem>
+    class ArrayView
+    {
+    public:
+        ArrayView() = default;
+
+        ArrayView(const std::byte* data, const size_t size)
+            : mData(data)
+            , mSize(size)
+        {}
+
+        size_t size() const noexcept { return mSize; }
+        bool empty() const noexcept { return mSize == 0; }
+        const std::byte* data() const noexcept { return mData; }
+
+        TElem operator[](const size_t index) const
+        {
+            assert(index < mSize);
+
+            TElem elem;
+            std::memcpy(&elem, mData + index * sizeof(TElem), sizeof(TElem));
+
+            return elem;
+        }
+
+    private:
+        const std::byte*    mData = nullptr;
+        size_t              mSize = 0;
+    };
+
+    /*---------------------*
+     *    MessageSchema    *
+     *---------------------*/
+
+    // 메시지 payload 배치를 한 번 선언한다
+    // 고정 필드는 선언 순서대로 패딩 없이 놓이므로 operator<<로 같은 순서로 넣은 payload와 호환된다
+    //
+    // struct MoveSchema : MessageSchema<uint32_t, float, float, VarBytes>
+    // {
+    //     enum : size_t { EntityId, X, Y, Extra };
+    // };
+    template<typename... TFields>
+    struct MessageSchema
+    {
+        using LengthType = uint32_t;
+
+        template<typename TField>
+        struct FieldTraits
+        {
+            static_assert(std::is_standard_layout<TField>::value, "TField must be standard-layout type");
+
+            using Type = TField;
+            using Elem = TField;
+            static constexpr bool isVar = false;
+            static constexpr size_t slotSize = sizeof(TField);
+        };
+
+        template<typename TElem>
+        struct FieldTraits<VarArray<TElem>>
+        {
+            using Type = ArrayView<TElem>;
+            using Elem = TElem;
+            static constexpr bool isVar = true;
+            static constexpr size_t slotSize = sizeof(LengthType);
+        };
+
+        static constexpr size_t numFields = sizeof...(TFields);
+        static constexpr size_t numVarFields = (0 + ... + (FieldTraits<TFields>::isVar ? 1 : 0));
+        static constexpr size_t fixedSize = (0 + ... + FieldTraits<TFields>::slotSize);
+        static constexpr bool isFixedSize = (numVarFields == 0);
+
+        template<size_t Index>
+        using Field = std::tuple_element_t<Index, std::tuple<TFields...>>;
+
+        template<size_t Index>
+        using Traits = FieldTraits<Field<Index>>;
+
+        // 고정 영역 안에서 필드(가변 구간이면 길이)의 오프셋
+        template<size_t Index>
+        static constexpr size_t offset = []()
+            {
+                constexpr std::array<size_t, numFields> slotSizes = { FieldTraits<TFields>::slotSize... };
+                size_t result = 0;
+
+                for (size_t i = 0; i < Index; ++i)
+                {
+                    result += slotSizes[i];
+                }
+
+                return result;
+            }();
+
+        // 앞에 선언된 가변 구간의 수
+        template<size_t Index>
+        static constexpr size_t varIndex = []()
+            {
+                constexpr std::array<bool, numFields> isVars = { FieldTraits<TFields>::isVar... };
+                size_t result = 0;
+
+                for (size_t i = 0; i < Index; ++i)
+                {
+                    result += isVars[i] ? 1 : 0;
+                }
+
+                return result;
+            }();
+
+        // 가변 구간별 원소 개수로 payload 크기를 구한다
+        template<typename... TLengths>
+        static constexpr size_t CalculatePayloadSize(const TLengths... lengths)
+        {
+            static_assert(sizeof...(TLengths) == numVarFields, "A length is required for each VarArray");
+
+            const std::array<size_t, numVarFields + 1> counts = { static_cast<size_t>(lengths)..., 0 };
+            constexpr std::array<size_t, numVarFields + 1> elemSizes = VarElemSizes();
+            size_t size = fixedSize;
+
+            for (size_t i = 0; i < numVarFields; ++i)
+            {
+                size += counts[i] * elemSizes[i];
+            }
+
+            return size;
+        }
+
+        static constexpr std::array<size_t, numVarFields + 1> VarElemSizes()
+        {
+            constexpr std::array<bool, numFields + 1> isVars = { FieldTraits<TFields>::isVar..., false };
+            constexpr std::array<size_t, numFields + 1> elemSizes = { sizeof(typename FieldTraits<TFields>::Elem)..., 0 };
+            std::array<size_t, numVarFields + 1> result = {};
+            size_t count = 0;
+
+            for (size_t i = 0; i < numFields; ++i)
+            {
+                if (isVars[i])
+                {
+                    result[count++] = elemSizes[i];
+                }
+            }
+
+            return result;
+        }
+    };
+
+    /*-------------------*
+     *    MessageView    *
+     *-------------------*/
+
+    // 받은 payload를 복사하지 않고 읽는 뷰, 메시지보다 오래 살면 안 된다
+    // 생성할 때 가변 구간 길이만 읽어서 범위를 확인하고, 고정 필드는 상수 오프셋에서 바로 읽는다
+    template<typename TSchema>
+    class MessageView
+    {
+    public:
+        explicit MessageView(const Message& msg)
+            : MessageView(msg.payload.data(), msg.payload.size())
+        {}
+
+        MessageView(const std::byte* data, const size_t size)
+            : mData(data)
+        {
+            mValid = Validate(size);
+        }
+
+        // payload 크기가 선언과 정확히 맞을 때만 true
+        bool IsValid() const noexcept { return mValid; }
+
+        template<size_t Index>
+        typename TSchema::template Traits<Index>::Type Get() const
+        {
+            using Traits = typename TSchema::template Traits<Index>;
+            assert(mValid);
+
+            if constexpr (Traits::isVar)
+            {
+                constexpr size_t varIndex = TSchema::template varIndex<Index>;
+
+                return ArrayView<typename Traits::Elem>(mData + mSectionOffsets[varIndex],
+                                                        ReadLength<Index>());
+            }
+            else
+            {
+                typename Traits::Type value;
+                std::memcpy(&value, mData + TSchema::template offset<Index>, sizeof(value));
+
+                return value;
+            }
+        }
+
+    private:
+        template<size_t Index>
+        typename TSchema::LengthType ReadLength() const
+        {
+            typename TSchema::LengthType length;
+            std::memcpy(&length, mData + TSchema::template offset<Index>, sizeof(length));
+
+            return length;
+        }
+
+        bool Validate(const size_t size)
+        {
+            if (size < TSchema::fixedSize)
+            {
+                return false;
+            }
+
+            mSectionOffsets[0] = TSchema::fixedSize;
+            ComputeSections(std::make_index_sequence<TSchema::numFields>());
+
+            return mSectionOffsets[TSchema::numVarFields] == size;
+        }
+
+        template<size_t... Indices>
+        void ComputeSections(std::index_sequence<Indices...>)
+        {
+            (ComputeSection<Indices>(), ...);
+        }
+
+        template<size_t Index>
+        void ComputeSection()
+        {
+            using Traits = typename TSchema::template Traits<Index>;
+
+            if constexpr (Traits::isVar)
+            {
+                constexpr size_t varIndex = TSchema::template varIndex<Index>;
+
+                // 64비트 누적이라 길이 * 원소 크기가 넘치지 않는다
+                mSectionOffsets[varIndex + 1] = mSectionOffsets[varIndex]
+                                              + static_cast<uint64_t>(ReadLength<Index>()) * sizeof(typename Traits::Elem);
+            }
+        }
+
+    private:
+        const std::byte*    mData = nullptr;
+        bool                mValid = false;
+        std::array<uint64_t, TSchema::numVarFields + 1>
+                            mSectionOffsets = {};   // 가변 구간 시작 오프셋, 마지막은 payload 끝
+    };
+
+    /*----------------------*
+     *    MessageBuilder    *
+     *----------------------*/
+
+    // payload를 한 번에 최종 크기로 만들고 필드를 제자리에 쓴다
+    // 가변 구간의 원소 개수는 생성할 때 정해진다
+    template<typename TSchema>
+    class MessageBuilder
+    {
+    public:
+        template<typename... TLengths>
+        explicit MessageBuilder(Message& msg, const TLengths... lengths)
+            : mMsg(msg)
+        {
+            static_assert(sizeof...(TLengths) == TSchema::numVarFields, "A length is required for each VarArray");
+
+            const std::array<size_t, TSchema::numVarFields + 1> counts = { static_cast<size_t>(lengths)..., 0 };
+            constexpr std::array<size_t, TSchema::numVarFields + 1> elemSizes = TSchema::VarElemSizes();
+
+            mSectionOffsets[0] = TSchema::fixedSize;
+
+            for (size_t i = 0; i < TSchema::numVarFields; ++i)
+            {
+                assert(counts[i] <= std::numeric_limits<typename TSchema::LengthType>::max());
+                mSectionOffsets[i + 1] = mSectionOffsets[i] + counts[i] * elemSizes[i];
+            }
+
+            mMsg.payload.resize(mSectionOffsets[TSchema::numVarFields]);
+            mMsg.header.size = static_cast<Message::Size>(mMsg.CalculateSize());
+
+            WriteLengths(counts, std::make_index_sequence<TSchema::numFields>());
+        }
+
+        template<size_t Index>
+        MessageBuilder& Set(const typename TSchema::template Field<Index>& value)
+        {
+            static_assert(!TSchema::template Traits<Index>::isVar, "Use Write or GetSection for VarArray");
+
+            std::memcpy(mMsg.payload.data() + TSchema::template offset<Index>, &value, sizeof(value));
+
+            return *this;
+        }
+
+        // 가변 구간 전체를 elems로 채운다, count는 생성할 때 정한 개수와 같아야 한다
+        template<size_t Index, typename TElem>
+        MessageBuilder& Write(const TElem* elems, const size_t count)
+        {
+            using Traits = typename TSchema::template Traits<Index>;
+            static_assert(Traits::isVar, "Use Set for fixed fields");
+            static_assert(std::is_same<TElem, typename Traits::Elem>::value, "TElem must match the declared element type");
+
+            assert(count * sizeof(TElem) == GetSectionSize<Index>());
+
+            if (count > 0)
+            {
+                std::memcpy(GetSection<Index>(), elems, count * sizeof(TElem));
+            }
+
+            return *this;
+        }
+
+        // 가변 구간을 직접 채울 때 쓰는 시작 주소
+        template<size_t Index>
+        std::byte* GetSection()
+        {
+            static_assert(TSchema::template Traits<Index>::isVar, "Only VarArray has a section");
+
+            return mMsg.payload.data() + mSectionOffsets[TSchema::template varIndex<Index>];
+        }
+
+        template<size_t Index>
+        size_t GetSectionSize() const
+        {
+            constexpr size_t varIndex = TSchema::template varIndex<Index>;
+
+            return mSectionOffsets[varIndex + 1] - mSectionOffsets[varIndex];
+        }
+
+    private:
+        template<size_t... Indices>
+        void WriteLengths(const std::array<size_t, TSchema::numVarFields + 1>& counts, std::index_sequence<Indices...>)
+        {
+            (WriteLength<Indices>(counts), ...);
+        }
+
+        template<size_t Index>
+        void WriteLength(const std::array<size_t, TSchema::numVarFields + 1>& counts)
+        {
+            if constexpr (TSchema::template Traits<Index>::isVar)
+            {
+                const auto length = static_cast<typename TSchema::LengthType>(counts[TSchema::template varIndex<Index>]);
+                std::memcpy(mMsg.payload.data() + TSchema::template offset<Index>, &length, sizeof(length));
+            }
+        }
+
+    private:
+        Message&    mMsg;
+        std::array<size_t, TSchema::numVarFields + 1>
+                    mSectionOffsets = {};
+    };
+}
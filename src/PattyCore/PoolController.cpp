@@ -0,0 +1,98 @@
+﻿#include "Pch.h"
+#include "PoolController.h"
+
+namespace PattyCore
+{
+    PoolController::PoolController(ThreadPool& timerGroup, WorkStealingPool& pool, const Config& config)
+        : mTimer(timerGroup)
+        , mPool(pool)
+        , mConfig(config)
+    {
+        const size_t poolMax = mPool.GetMaxThreads();
+
+        mConfig.maxThreads = (mConfig.maxThreads == 0) ? poolMax : std::min(mConfig.maxThreads, poolMax);
+        mConfig.minThreads = std::clamp<size_t>(mConfig.minThreads, 1, mConfig.maxThreads);
+    }
+
+    void PoolController::Start()
+    {
+        mLastStats = mPool.GetStats();
+        mLastSample = SteadyNowNs();
+
+        PostProbe();
+        WaitIntervalAsync();
+    }
+
+    void PoolController::WaitIntervalAsync()
+    {
+        mTimer.expires_after(mConfig.interval);
+        mTimer.async_wait([this](const ErrCode& errCode)
+                          {
+                              if (errCode)
+                              {
+                                  std::cerr << "[POOL] Failed to wait interval: " << errCode << "\n";
+                                  return;
+                              }
+
+                              OnInterval();
+                              WaitIntervalAsync();
+                          });
+    }
+
+    void PoolController::OnInterval()
+    {
+        const int64_t now = SteadyNowNs();
+        const SchedulerStats stats = mPool.GetStats();
+        const size_t numActive = mPool.GetNumActive();
+
+        const int64_t elapsed = std::max<int64_t>(now - mLastSample, 1);
+        const uint64_t idleNs = stats.idleNs - mLastStats.idleNs;
+        const double utilization = std::clamp(1.0 - static_cast<double>(idleNs) / (static_cast<double>(elapsed) * numActive), 0.0, 1.0);
+
+        mLastStats = stats;
+        mLastSample = now;
+
+        // A probe that has not run yet has been waiting at least this long
+        const int64_t probePostedAt = mProbePostedAt.load();
+        const int64_t queueWait = (probePostedAt != 0) ? (now - probePostedAt) : mLastQueueWait.load();
+        const int64_t maxQueueWait = std::chrono::duration_cast<Nanoseconds>(mConfig.maxQueueWait).count();
+
+        size_t numTarget = numActive;
+
+        if ((queueWait > maxQueueWait) || (utilization > mConfig.growUtilization))
+        {
+            // Grow fast since queued messages are already late, shrink one at a time
+            numTarget = std::min(numActive + std::max<size_t>(numActive / 2, 1), mConfig.maxThreads);
+        }
+        else if ((utilization < mConfig.shrinkUtilization) && (queueWait < maxQueueWait / 2))
+        {
+            numTarget = std::max(numActive - 1, mConfig.minThreads);
+        }
+
+        if (numTarget != numActive)
+        {
+            mPool.Resize(numTarget);
+
+            std::cout << "[POOL] Message group resized: " << numActive << " -> " << numTarget
+                      << " (wait: " << (queueWait / 1000) << "us"
+                      << ", util: " << static_cast<int>(utilization * 100) << "%)\n";
+        }
+
+        if (probePostedAt == 0)
+        {
+            PostProbe();
+        }
+    }
+
+    void PoolController::PostProbe()
+    {
+        mProbePostedAt.store(SteadyNowNs());
+
+        asio::post(mPool,
+                   [this]()
+                   {
+                       mLastQueueWait.store(SteadyNowNs() - mProbePostedAt.load());
+                       mProbePostedAt.store(0);
+                   });
+    }
+}
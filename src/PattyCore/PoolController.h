@@ -0,0 +1,50 @@
+﻿#pragma once
+
+#include "WorkStealingPool.h"
+
+namespace PattyCore
+{
+    /*----------------------*
+     *    PoolController    *
+     *----------------------*/
+
+    // 주기적으로 큐 대기 시간과 사용률을 재서 WorkStealingPool의 활성 워커 수를 조절한다
+    // 큐 대기 시간은 프로브 작업을 게시하고 실행될 때까지 걸린 시간으로 잰다
+    class PoolController
+    {
+    public:
+        struct Config
+        {
+            Milliseconds    interval = Milliseconds(500);
+            size_t          minThreads = 1;
+            size_t          maxThreads = 0;                         // 0이면 풀의 최대 스레드 수
+            Microseconds    maxQueueWait = Microseconds(2000);      // 프로브가 이보다 오래 기다리면 늘린다
+            double          growUtilization = 0.85;                 // 사용률이 이보다 높으면 늘린다
+            double          shrinkUtilization = 0.4;                // 사용률이 이보다 낮고 대기가 짧으면 줄인다
+        };
+
+    public:
+        PoolController(ThreadPool& timerGroup, WorkStealingPool& pool, const Config& config);
+        PoolController(const PoolController&) = delete;
+        PoolController& operator=(const PoolController&) = delete;
+
+        void Start();
+
+    private:
+        void WaitIntervalAsync();
+        void OnInterval();
+        void PostProbe();
+
+    private:
+        Timer                   mTimer;
+        WorkStealingPool&       mPool;
+        Config                  mConfig;
+
+        std::atomic<int64_t>    mProbePostedAt = 0;     // 실행을 기다리는 프로브가 없으면 0
+        std::atomic<int64_t>    mLastQueueWait = 0;     // 나노초
+
+        // 타이머 핸들러에서만 접근
+        SchedulerStats          mLastStats;
+        int64_t                 mLastSample = 0;
+    };
+}
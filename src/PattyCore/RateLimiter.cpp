@@ -0,0 +1,103 @@
+﻿#include "Pch.h"
+#include "RateLimiter.h"
+
+namespace PattyCore
+{
+    CoarseClock::CoarseClock(ThreadPool& taskGroup, const Milliseconds resolution)
+        : mTimer(taskGroup)
+        , mResolution(resolution)
+        , mNow(0)
+    {
+        Tick();
+    }
+
+    void CoarseClock::Start()
+    {
+        if (mStarted.exchange(true))
+        {
+            return;
+        }
+
+        Tick();
+        WaitTickAsync();
+    }
+
+    void CoarseClock::Tick()
+    {
+        const int64_t now = std::chrono::duration_cast<Nanoseconds>(Clock::now().time_since_epoch()).count();
+
+        mNow.store(now, std::memory_order_relaxed);
+    }
+
+    void CoarseClock::WaitTickAsync()
+    {
+        mTimer.expires_after(mResolution);
+        mTimer.async_wait([this](const ErrCode& errCode)
+                          {
+                              if (errCode)
+                              {
+                                  std::cerr << "[CLOCK] Failed to wait tick: " << errCode << "\n";
+                                  return;
+                              }
+
+                              Tick();
+                              WaitTickAsync();
+                          });
+    }
+
+    int64_t TokenBucket::GetWaitTime(const Limit& limit, const int64_t now)
+    {
+        if (!limit.IsEnabled())
+        {
+            return 0;
+        }
+
+        Refill(limit, now);
+
+        if (mTokens >= nanosPerSecond)
+        {
+            return 0;
+        }
+
+        // Round up so the bucket holds a whole token when the wait is over
+        return (nanosPerSecond - mTokens + limit.rate - 1) / limit.rate;
+    }
+
+    void TokenBucket::Consume()
+    {
+        mTokens -= nanosPerSecond;
+    }
+
+    void TokenBucket::Refill(const Limit& limit, const int64_t now)
+    {
+        const uint32_t burst = (limit.burst > 0) ? limit.burst : limit.rate;
+        const int64_t capacity = static_cast<int64_t>(burst) * nanosPerSecond;
+
+        if (mTokens < 0)
+        {
+            mTokens = capacity;
+            mLastRefill = now;
+
+            return;
+        }
+
+        const int64_t elapsed = now - mLastRefill;
+
+        if (elapsed <= 0)
+        {
+            return;
+        }
+
+        mLastRefill = now;
+
+        // Compare before multiplying so a long idle gap cannot overflow
+        if (elapsed >= (capacity - mTokens) / limit.rate)
+        {
+            mTokens = capacity;
+        }
+        else
+        {
+            mTokens += elapsed * limit.rate;
+        }
+    }
+}
@@ -0,0 +1,76 @@
+﻿#pragma once
+
+namespace PattyCore
+{
+    /*-------------------*
+     *    CoarseClock    *
+     *-------------------*/
+
+    // 타이머가 주기적으로 갱신하는 공유 시계
+    // 메시지마다 Clock::now()를 호출하지 않도록 해상도만큼의 오차를 허용한다
+    class CoarseClock
+    {
+    public:
+        using Ptr = SPtr<CoarseClock>;
+
+        static constexpr Milliseconds defaultResolution = Milliseconds(1);
+
+    public:
+        CoarseClock(ThreadPool& taskGroup, const Milliseconds resolution = defaultResolution);
+        CoarseClock(const CoarseClock&) = delete;
+        CoarseClock& operator=(const CoarseClock&) = delete;
+
+        // 여러 번 호출해도 한 번만 시작한다
+        void Start();
+
+        // Clock 기준 나노초
+        int64_t Now() const noexcept
+        {
+            return mNow.load(std::memory_order_relaxed);
+        }
+
+    private:
+        void Tick();
+        void WaitTickAsync();
+
+    private:
+        Timer                   mTimer;
+        const Milliseconds      mResolution;
+        std::atomic<int64_t>    mNow;
+        std::atomic<bool>       mStarted = false;
+    };
+
+    /*-------------------*
+     *    TokenBucket    *
+     *-------------------*/
+
+    // 초당 rate개씩 채워지고 최대 burst개까지 쌓이는 토큰 버킷
+    // 한 스레드에서만 접근한다고 가정한다
+    class TokenBucket
+    {
+    public:
+        struct Limit
+        {
+            uint32_t    rate = 0;       // 초당 토큰 수, 0이면 제한하지 않는다
+            uint32_t    burst = 0;      // 0이면 rate와 같다
+
+            bool IsEnabled() const noexcept { return rate > 0; }
+        };
+
+    public:
+        TokenBucket() = default;
+
+        // 토큰이 하나 생길 때까지 기다려야 하는 나노초, 0이면 지금 소비할 수 있다
+        int64_t GetWaitTime(const Limit& limit, const int64_t now);
+        void Consume();
+
+    private:
+        void Refill(const Limit& limit, const int64_t now);
+
+    private:
+        static constexpr int64_t    nanosPerSecond = 1'000'000'000;
+
+        int64_t     mTokens = -1;           // 토큰 * nanosPerSecond, 처음 사용할 때 burst로 채운다
+        int64_t     mLastRefill = 0;
+    };
+}
@@ -0,0 +1,616 @@
+﻿#include "Pch.h"
+#include "Replicator.h"
+
+namespace PattyCore
+{
+    bool Replicator::Register(const StateId stateId, const size_t historySize)
+    {
+        SPtr<State> state = std::make_shared<State>();
+        state->historySize = std::max<size_t>(historySize, 1);
+
+        SMutexULock lock(mStatesLock);
+
+        return mStates.emplace(stateId, std::move(state)).second;
+    }
+
+    bool Replicator::Unregister(const StateId stateId)
+    {
+        SMutexULock lock(mStatesLock);
+
+        return mStates.erase(stateId) != 0;
+    }
+
+    bool Replicator::Subscribe(const StateId stateId, Session::Ptr session)
+    {
+        SPtr<State> state = FindState(stateId);
+
+        // A closed session is never unsubscribed by UnregisterSession again
+        if ((state == nullptr) || session->IsClosed())
+        {
+            return false;
+        }
+
+        const Session::Id sessionId = session->GetId();
+
+        MutexLockGrd lock(state->lock);
+
+        Subscribers& subscribers = state->subscribers;
+        auto iter = FindSubscriber(subscribers, sessionId);
+
+        if ((iter != subscribers.end()) && (iter->id == sessionId))
+        {
+            return false;
+        }
+
+        subscribers.insert(iter, Subscriber{ sessionId, session });
+
+        return true;
+    }
+
+    bool Replicator::Unsubscribe(const StateId stateId, const Session::Ptr& session)
+    {
+        SPtr<State> state = FindState(stateId);
+
+        if (state == nullptr)
+        {
+            return false;
+        }
+
+        const Session::Id sessionId = session->GetId();
+
+        MutexLockGrd lock(state->lock);
+
+        Subscribers& subscribers = state->subscribers;
+        auto iter = FindSubscriber(subscribers, sessionId);
+
+        if ((iter == subscribers.end()) || (iter->id != sessionId))
+        {
+            return false;
+        }
+
+        subscribers.erase(iter);
+
+        return true;
+    }
+
+    void Replicator::UnsubscribeAll(const Session::Ptr& session)
+    {
+        const Session::Id sessionId = session->GetId();
+
+        // A service replicates a handful of states, walking all of them is cheaper than a reverse index
+        SMutexSLock statesLock(mStatesLock);
+
+        for (auto& pair : mStates)
+        {
+            State& state = *pair.second;
+            MutexLockGrd lock(state.lock);
+
+            auto iter = FindSubscriber(state.subscribers, sessionId);
+
+            if ((iter != state.subscribers.end()) && (iter->id == sessionId))
+            {
+                state.subscribers.erase(iter);
+            }
+        }
+    }
+
+    Replicator::Tick Replicator::Commit(const StateId stateId, const std::byte* data, const size_t size)
+    {
+        SPtr<State> state = FindState(stateId);
+
+        if (state == nullptr)
+        {
+            return 0;
+        }
+
+        MutexLockGrd lock(state->lock);
+
+        // The oldest snapshot's storage is reused for the new one
+        Snapshot current;
+
+        if (state->history.size() >= state->historySize)
+        {
+            current = std::move(state->history.front());
+            state->history.pop_front();
+        }
+
+        current.tick = ++state->tick;
+        current.bytes.assign(data, data + size);
+        state->history.push_back(std::move(current));
+
+        const Snapshot& target = state->history.back();
+
+        // A pending update for the state is replaced, so a slow subscriber holds at most one
+        // Every update is relative to an acknowledged state, dropping the replaced one loses nothing
+        const Session::ConflationKey conflationKey = updateKeyBegin | stateId;
+
+        // Subscribers acknowledging the same tick share one encoded delta
+        std::vector<std::pair<Tick, Message>> deltas;
+        Message snapshotMsg;
+        bool hasSnapshotMsg = false;
+
+        // A session that closed between Subscribe and UnsubscribeAll would otherwise stay forever
+        Subscribers& subscribers = state->subscribers;
+
+        subscribers.erase(std::remove_if(subscribers.begin(), subscribers.end(),
+                                         [](const Subscriber& subscriber)
+                                         {
+                                             const Session::Ptr session = subscriber.session.lock();
+
+                                             return (session == nullptr) || session->IsClosed();
+                                         }),
+                          subscribers.end());
+
+        for (Subscriber& subscriber : subscribers)
+        {
+            const Session::Ptr session = subscriber.session.lock();
+
+            if (session == nullptr)
+            {
+                continue;
+            }
+
+            const Snapshot* base = FindSnapshot(*state, subscriber.ackedTick);
+
+            // Nothing acknowledged yet, or the acknowledged state has left the history
+            if (base == nullptr)
+            {
+                if (!hasSnapshotMsg)
+                {
+                    snapshotMsg = MakeSnapshotMessage(stateId, target);
+                    hasSnapshotMsg = true;
+                }
+
+                session->SendConflatedAsync(Message(snapshotMsg), conflationKey);
+                continue;
+            }
+
+            auto iter = std::find_if(deltas.begin(), deltas.end(),
+                                     [base](const auto& pair)
+                                     {
+                                         return pair.first == base->tick;
+                                     });
+
+            if (iter == deltas.end())
+            {
+                deltas.emplace_back(base->tick, MakeDeltaMessage(stateId, *base, target));
+                iter = std::prev(deltas.end());
+            }
+
+            session->SendConflatedAsync(Message(iter->second), conflationKey);
+        }
+
+        return target.tick;
+    }
+
+    void Replicator::Acknowledge(const StateId stateId, const Session::Id sessionId, const Tick tick)
+    {
+        SPtr<State> state = FindState(stateId);
+
+        if (state == nullptr)
+        {
+            return;
+        }
+
+        MutexLockGrd lock(state->lock);
+
+        auto iter = FindSubscriber(state->subscribers, sessionId);
+
+        if ((iter == state->subscribers.end()) || (iter->id != sessionId) || (tick > state->tick))
+        {
+            return;
+        }
+
+        iter->ackedTick = std::max(iter->ackedTick, tick);
+    }
+
+    void Replicator::EncodeDelta(const std::byte* base, const size_t baseSize,
+                                 const std::byte* target, const size_t targetSize,
+                                 std::vector<std::byte>& out)
+    {
+        auto appendRun = [&out, target](const size_t offset, const size_t length)
+            {
+                const uint32_t header[2] = { static_cast<uint32_t>(offset), static_cast<uint32_t>(length) };
+                const size_t begin = out.size();
+
+                out.resize(begin + runHeaderSize + length);
+                std::memcpy(out.data() + begin, header, runHeaderSize);
+                std::memcpy(out.data() + begin + runHeaderSize, target + offset, length);
+            };
+
+        const size_t commonSize = std::min(baseSize, targetSize);
+        size_t pos = 0;
+
+        while (pos < commonSize)
+        {
+            // Unchanged state is the common case, skip it a word at a time
+            while (pos + sizeof(uint64_t) <= commonSize)
+            {
+                uint64_t baseWord;
+                uint64_t targetWord;
+                std::memcpy(&baseWord, base + pos, sizeof(uint64_t));
+                std::memcpy(&targetWord, target + pos, sizeof(uint64_t));
+
+                if (baseWord != targetWord)
+                {
+                    break;
+                }
+
+                pos += sizeof(uint64_t);
+            }
+
+            while ((pos < commonSize) && (base[pos] == target[pos]))
+            {
+                ++pos;
+            }
+
+            if (pos == commonSize)
+            {
+                break;
+            }
+
+            // The run ends once enough equal bytes follow to pay for another run header
+            const size_t begin = pos;
+            size_t end = pos + 1;
+            size_t numEqual = 0;
+
+            for (pos = end; (pos < commonSize) && (numEqual < runHeaderSize); ++pos)
+            {
+                if (base[pos] != target[pos])
+                {
+                    end = pos + 1;
+                    numEqual = 0;
+                }
+                else
+                {
+                    ++numEqual;
+                }
+            }
+
+            appendRun(begin, end - begin);
+            pos = end;
+        }
+
+        if (targetSize > commonSize)
+        {
+            appendRun(commonSize, targetSize - commonSize);
+        }
+    }
+
+    bool Replicator::ApplyDelta(const std::vector<std::byte>& base,
+                                const std::byte* delta, const size_t deltaSize,
+                                const size_t targetSize,
+                                std::vector<std::byte>& out)
+    {
+        // Only appended runs can grow the state, checked before the size is trusted for an allocation
+        if (static_cast<uint64_t>(targetSize) > static_cast<uint64_t>(base.size()) + deltaSize)
+        {
+            return false;
+        }
+
+        out.assign(base.begin(), base.begin() + std::min(base.size(), targetSize));
+        out.resize(targetSize);
+
+        size_t pos = 0;
+
+        while (pos < deltaSize)
+        {
+            if (deltaSize - pos < runHeaderSize)
+            {
+                return false;
+            }
+
+            uint32_t header[2];
+            std::memcpy(header, delta + pos, runHeaderSize);
+            pos += runHeaderSize;
+
+            const size_t offset = header[0];
+            const size_t length = header[1];
+
+            // 64-bit sums, a crafted header cannot wrap around
+            if ((deltaSize - pos < length) || (static_cast<uint64_t>(offset) + length > targetSize))
+            {
+                return false;
+            }
+
+            std::memcpy(out.data() + offset, delta + pos, length);
+            pos += length;
+        }
+
+        return true;
+    }
+
+    SPtr<Replicator::State> Replicator::FindState(const StateId stateId) const
+    {
+        SMutexSLock lock(mStatesLock);
+
+        auto iter = mStates.find(stateId);
+
+        if (iter == mStates.end())
+        {
+            return nullptr;
+        }
+
+        return iter->second;
+    }
+
+    const Replicator::Snapshot* Replicator::FindSnapshot(const State& state, const Tick tick)
+    {
+        if ((tick == 0) || state.history.empty() || (tick < state.history.front().tick))
+        {
+            return nullptr;
+        }
+
+        // Ticks in the history are consecutive
+        const size_t index = static_cast<size_t>(tick - state.history.front().tick);
+
+        if (index >= state.history.size())
+        {
+            return nullptr;
+        }
+
+        return &state.history[index];
+    }
+
+    Replicator::Subscribers::iterator Replicator::FindSubscriber(Subscribers& subscribers, const Session::Id sessionId)
+    {
+        return std::lower_bound(subscribers.begin(), subscribers.end(), sessionId,
+                                [](const Subscriber& subscriber, const Session::Id id)
+                                {
+                                    return subscriber.id < id;
+                                });
+    }
+
+    Message Replicator::MakeSnapshotMessage(const StateId stateId, const Snapshot& snapshot)
+    {
+        Message msg;
+        msg.header.id = static_cast<Message::Id>(Message::SystemId::ReplicaSnapshot);
+
+        MessageBuilder<ReplicaSnapshotSchema> builder(msg, snapshot.bytes.size());
+        builder.Set<ReplicaSnapshotSchema::StateId>(stateId)
+               .Set<ReplicaSnapshotSchema::Tick>(snapshot.tick)
+               .Write<ReplicaSnapshotSchema::State>(snapshot.bytes.data(), snapshot.bytes.size());
+
+        return msg;
+    }
+
+    Message Replicator::MakeDeltaMessage(const StateId stateId, const Snapshot& base, const Snapshot& target)
+    {
+        static thread_local std::vector<std::byte> runs;
+        runs.clear();
+
+        EncodeDelta(base.bytes.data(), base.bytes.size(), target.bytes.data(), target.bytes.size(), runs);
+
+        Message msg;
+        msg.header.id = static_cast<Message::Id>(Message::SystemId::ReplicaDelta);
+
+        MessageBuilder<ReplicaDeltaSchema> builder(msg, runs.size());
+        builder.Set<ReplicaDeltaSchema::StateId>(stateId)
+               .Set<ReplicaDeltaSchema::Tick>(target.tick)
+               .Set<ReplicaDeltaSchema::BaseTick>(base.tick)
+               .Set<ReplicaDeltaSchema::Size>(static_cast<uint32_t>(target.bytes.size()))
+               .Write<ReplicaDeltaSchema::Runs>(runs.data(), runs.size());
+
+        return msg;
+    }
+
+    ReplicaSet::Tick ReplicaSet::Apply(const Session::Id sessionId, const Message& msg, StateId& stateId)
+    {
+        const bool isSnapshot = (msg.header.id == static_cast<Message::Id>(Message::SystemId::ReplicaSnapshot));
+
+        if (isSnapshot)
+        {
+            Replicator::Snapshot snapshot;
+
+            // Decoded before the lock and before any replica exists for the id
+            if (!DecodeSnapshot(msg, snapshot, stateId))
+            {
+                return 0;
+            }
+
+            MutexLockGrd lock(mLock);
+
+            const Key key = MakeKey(sessionId, stateId);
+            auto iter = mReplicas.find(key);
+            Usage& usage = mUsages[sessionId];
+
+            if (iter == mReplicas.end())
+            {
+                // A peer cannot make the set track an unbounded number of states
+                if (usage.numStates >= maxStatesPerSession)
+                {
+                    return 0;
+                }
+
+                iter = mReplicas.emplace(key, Replica()).first;
+                ++usage.numStates;
+            }
+
+            if (!Store(iter->second, usage, std::move(snapshot)))
+            {
+                if (iter->second.history.empty())
+                {
+                    mReplicas.erase(iter);
+                    --usage.numStates;
+                }
+
+                if (usage.numStates == 0)
+                {
+                    mUsages.erase(sessionId);
+                }
+
+                return 0;
+            }
+
+            return iter->second.history.back().tick;
+        }
+
+        // The state id leads both payloads
+        if (msg.payload.size() < sizeof(StateId))
+        {
+            return 0;
+        }
+
+        StateId peekedId;
+        std::memcpy(&peekedId, msg.payload.data(), sizeof(peekedId));
+
+        MutexLockGrd lock(mLock);
+
+        // A delta needs a base, so only a snapshot may create the replica
+        auto iter = mReplicas.find(MakeKey(sessionId, peekedId));
+
+        if (iter == mReplicas.end())
+        {
+            return 0;
+        }
+
+        return ApplyDelta(iter->second, mUsages[sessionId], msg, stateId);
+    }
+
+    bool ReplicaSet::Read(const Session::Id sessionId, const StateId stateId, std::vector<std::byte>& out, Tick& tick) const
+    {
+        MutexLockGrd lock(mLock);
+
+        auto iter = mReplicas.find(MakeKey(sessionId, stateId));
+
+        if ((iter == mReplicas.end()) || iter->second.history.empty())
+        {
+            return false;
+        }
+
+        const Replicator::Snapshot& latest = iter->second.history.back();
+        out = latest.bytes;
+        tick = latest.tick;
+
+        return true;
+    }
+
+    void ReplicaSet::Erase(const Session::Id sessionId)
+    {
+        MutexLockGrd lock(mLock);
+
+        if (mUsages.erase(sessionId) == 0)
+        {
+            return;
+        }
+
+        for (auto iter = mReplicas.begin(); iter != mReplicas.end();)
+        {
+            if ((iter->first >> 32) == sessionId)
+            {
+                iter = mReplicas.erase(iter);
+            }
+            else
+            {
+                ++iter;
+            }
+        }
+    }
+
+    ReplicaSet::Key ReplicaSet::MakeKey(const Session::Id sessionId, const StateId stateId)
+    {
+        return (static_cast<Key>(sessionId) << 32) | stateId;
+    }
+
+    bool ReplicaSet::DecodeSnapshot(const Message& msg, Replicator::Snapshot& snapshot, StateId& stateId)
+    {
+        const MessageView<ReplicaSnapshotSchema> view(msg);
+
+        if (!view.IsValid())
+        {
+            return false;
+        }
+
+        const ArrayView<std::byte> state = view.Get<ReplicaSnapshotSchema::State>();
+
+        snapshot.tick = view.Get<ReplicaSnapshotSchema::Tick>();
+        snapshot.bytes.assign(state.data(), state.data() + state.size());
+
+        stateId = view.Get<ReplicaSnapshotSchema::StateId>();
+
+        // Tick 0 means no state, acknowledging it would read as a failure
+        return snapshot.tick != 0;
+    }
+
+    ReplicaSet::Tick ReplicaSet::ApplyDelta(Replica& replica, Usage& usage, const Message& msg, StateId& stateId)
+    {
+        const MessageView<ReplicaDeltaSchema> view(msg);
+
+        if (!view.IsValid())
+        {
+            return 0;
+        }
+
+        const Tick baseTick = view.Get<ReplicaDeltaSchema::BaseTick>();
+
+        auto baseIter = std::find_if(replica.history.begin(), replica.history.end(),
+                                     [baseTick](const Replicator::Snapshot& snapshot)
+                                     {
+                                         return snapshot.tick == baseTick;
+                                     });
+
+        if (baseIter == replica.history.end())
+        {
+            return 0;
+        }
+
+        const ArrayView<std::byte> runs = view.Get<ReplicaDeltaSchema::Runs>();
+
+        Replicator::Snapshot snapshot;
+        snapshot.tick = view.Get<ReplicaDeltaSchema::Tick>();
+
+        if (!Replicator::ApplyDelta(baseIter->bytes, runs.data(), runs.size(), view.Get<ReplicaDeltaSchema::Size>(), snapshot.bytes))
+        {
+            return 0;
+        }
+
+        // Acknowledgements only move forward, the sender never picks an older base again
+        for (auto iter = replica.history.begin(); iter != baseIter; ++iter)
+        {
+            replica.numBytes -= iter->bytes.size();
+            usage.numBytes -= iter->bytes.size();
+        }
+
+        replica.history.erase(replica.history.begin(), baseIter);
+
+        if (!Store(replica, usage, std::move(snapshot)))
+        {
+            return 0;
+        }
+
+        stateId = view.Get<ReplicaDeltaSchema::StateId>();
+
+        return replica.history.back().tick;
+    }
+
+    bool ReplicaSet::Store(Replica& replica, Usage& usage, Replicator::Snapshot&& snapshot)
+    {
+        // Updates arrive in tick order, a stale one would only rewind the replica
+        if (!replica.history.empty() && (snapshot.tick <= replica.history.back().tick))
+        {
+            return true;
+        }
+
+        const size_t size = snapshot.bytes.size();
+
+        // Even dropping this replica's whole history would not make room, leave it as it was
+        if (size > maxBytesPerSession - (usage.numBytes - replica.numBytes))
+        {
+            return false;
+        }
+
+        while ((replica.history.size() >= maxHistory) ||
+               (usage.numBytes + size > maxBytesPerSession))
+        {
+            replica.numBytes -= replica.history.front().bytes.size();
+            usage.numBytes -= replica.history.front().bytes.size();
+            replica.history.pop_front();
+        }
+
+        replica.numBytes += size;
+        usage.numBytes += size;
+        replica.history.push_back(std::move(snapshot));
+
+        return true;
+    }
+}
@@ -0,0 +1,205 @@
+﻿#pragma once
+
+#include "Session.h"
+
+namespace PattyCore
+{
+    /*------------------*
+     *    Replicator    *
+     *------------------*/
+
+    // 등록한 상태를 구독한 세션들에 복제한다
+    // 처음에는 전체 스냅숏을, 이후 Commit마다 그 세션이 마지막으로 응답한 tick과 달라진 바이트 구간만 보낸다
+    // 응답한 상태는 상대가 가지고 있으므로 연결이 끊겼다 재개되거나 중간 메시지가 교체되어도 델타를 적용할 수 있다
+    class Replicator
+    {
+    public:
+        using StateId = uint32_t;
+        using Tick = uint64_t;                                  // 0은 아직 없다는 뜻
+
+        // 상태마다 대기열에 갱신과 응답이 하나씩만 남도록 이 키에 상태 id를 더해서 보낸다
+        static constexpr Session::ConflationKey updateKeyBegin = 0xFFFFFFFF00000000;
+        static constexpr Session::ConflationKey ackKeyBegin = 0xFFFFFFFE00000000;
+        static constexpr size_t defaultHistorySize = 32;
+        static constexpr size_t runHeaderSize = sizeof(uint32_t) * 2;  // 델타 구간의 (offset, length)
+
+        /*----------------*
+         *    Snapshot    *
+         *----------------*/
+
+        struct Snapshot
+        {
+            Tick                    tick = 0;
+            std::vector<std::byte>  bytes;
+        };
+
+    public:
+        Replicator() = default;
+        Replicator(const Replicator&) = delete;
+        Replicator& operator=(const Replicator&) = delete;
+
+        // historySize는 델타의 기준으로 남겨 두는 지난 상태 수, 응답이 이보다 늦으면 스냅숏을 다시 보낸다
+        bool Register(const StateId stateId, const size_t historySize = defaultHistorySize);
+        bool Unregister(const StateId stateId);
+
+        // 구독한 뒤 첫 Commit에서 스냅숏을 받는다, 닫힌 세션은 구독할 수 없다
+        // 세션을 약하게 들고 있어서 닫힌 구독자는 Commit에서 빠진다
+        bool Subscribe(const StateId stateId, Session::Ptr session);
+        bool Unsubscribe(const StateId stateId, const Session::Ptr& session);
+        void UnsubscribeAll(const Session::Ptr& session);
+
+        // 새 상태를 기록하고 구독자마다 스냅숏이나 델타를 보낸다, 등록되지 않은 상태면 0
+        Tick Commit(const StateId stateId, const std::byte* data, const size_t size);
+
+        template<typename TState>
+        Tick Commit(const StateId stateId, const TState& state)
+        {
+            static_assert(std::is_standard_layout<TState>::value, "TState must be standard-layout type");
+
+            return Commit(stateId, reinterpret_cast<const std::byte*>(&state), sizeof(TState));
+        }
+
+        // 세션이 tick의 상태를 적용했다, 이후 델타는 이 상태를 기준으로 만든다
+        void Acknowledge(const StateId stateId, const Session::Id sessionId, const Tick tick);
+
+        // base에서 target으로 달라진 바이트를 (offset, length, bytes) 구간들로 out 뒤에 붙인다
+        // 구간 사이의 같은 바이트가 구간 헤더보다 짧으면 한 구간으로 합친다
+        static void EncodeDelta(const std::byte* base, const size_t baseSize,
+                                const std::byte* target, const size_t targetSize,
+                                std::vector<std::byte>& out);
+
+        // base에 델타를 적용해서 targetSize 크기의 상태를 out에 만든다, 구간이 범위를 벗어나면 false
+        static bool ApplyDelta(const std::vector<std::byte>& base,
+                               const std::byte* delta, const size_t deltaSize,
+                               const size_t targetSize,
+                               std::vector<std::byte>& out);
+
+    private:
+        struct Subscriber
+        {
+            Session::Id     id;
+            WPtr<Session>   session;
+            Tick            ackedTick = 0;      // 0이면 스냅숏을 보낸다
+        };
+
+        using Subscribers = std::vector<Subscriber>;    // 세션 id 순으로 정렬
+
+        struct State
+        {
+            Mutex                   lock;
+            size_t                  historySize = defaultHistorySize;
+            Tick                    tick = 0;
+            std::deque<Snapshot>    history;            // 오래된 것부터, back()이 현재 상태
+            Subscribers             subscribers;
+        };
+
+        SPtr<State> FindState(const StateId stateId) const;
+
+        static const Snapshot* FindSnapshot(const State& state, const Tick tick);
+        static Subscribers::iterator FindSubscriber(Subscribers& subscribers, const Session::Id sessionId);
+        static Message MakeSnapshotMessage(const StateId stateId, const Snapshot& snapshot);
+        static Message MakeDeltaMessage(const StateId stateId, const Snapshot& base, const Snapshot& target);
+
+    private:
+        std::unordered_map<StateId, SPtr<State>>    mStates;
+        mutable SMutex                              mStatesLock;
+    };
+
+    /*------------------*
+     *    ReplicaSet    *
+     *------------------*/
+
+    // 받는 쪽에서 세션, 상태별로 복제본을 유지한다
+    // 상대가 응답을 받기 전까지 그 tick을 기준으로 델타를 보낼 수 있으므로 최근 상태 몇 개를 같이 들고 있다
+    class ReplicaSet
+    {
+    public:
+        using StateId = Replicator::StateId;
+        using Tick = Replicator::Tick;
+
+        static constexpr size_t maxHistory = Replicator::defaultHistorySize * 2;
+        static constexpr size_t maxStatesPerSession = 256;
+        static constexpr size_t maxBytesPerSession = 64 << 20;    // 세션의 모든 복제본이 들고 있는 지난 상태까지 합친 크기
+
+    public:
+        ReplicaSet() = default;
+        ReplicaSet(const ReplicaSet&) = delete;
+        ReplicaSet& operator=(const ReplicaSet&) = delete;
+
+        // SystemId::ReplicaSnapshot, ReplicaDelta를 적용하고 응답할 tick을 돌려준다
+        // 형식이 틀렸거나 기준 상태가 없어서 적용하지 못하면 0, 이때는 복제본을 만들지 않는다
+        // 세션마다 상태 수와 바이트에 상한이 있다, 넘치면 오래된 상태부터 버리고 그래도 넘치면 0
+        Tick Apply(const Session::Id sessionId, const Message& msg, StateId& stateId);
+
+        // 가장 최근에 적용한 상태를 복사한다
+        bool Read(const Session::Id sessionId, const StateId stateId, std::vector<std::byte>& out, Tick& tick) const;
+
+        template<typename TState>
+        bool Read(const Session::Id sessionId, const StateId stateId, TState& state) const
+        {
+            static_assert(std::is_standard_layout<TState>::value, "TState must be standard-layout type");
+
+            std::vector<std::byte> bytes;
+            Tick tick = 0;
+
+            if (!Read(sessionId, stateId, bytes, tick) || (bytes.size() != sizeof(TState)))
+            {
+                return false;
+            }
+
+            std::memcpy(&state, bytes.data(), sizeof(TState));
+
+            return true;
+        }
+
+        void Erase(const Session::Id sessionId);
+
+    private:
+        using Key = uint64_t;   // (세션 id << 32) | 상태 id
+
+        struct Replica
+        {
+            std::deque<Replicator::Snapshot>    history;    // tick 순, back()이 최신
+            size_t                              numBytes = 0;
+        };
+
+        struct Usage
+        {
+            size_t  numStates = 0;
+            size_t  numBytes = 0;
+        };
+
+        static Key MakeKey(const Session::Id sessionId, const StateId stateId);
+
+        static bool DecodeSnapshot(const Message& msg, Replicator::Snapshot& snapshot, StateId& stateId);
+        static Tick ApplyDelta(Replica& replica, Usage& usage, const Message& msg, StateId& stateId);
+        static bool Store(Replica& replica, Usage& usage, Replicator::Snapshot&& snapshot);
+
+    private:
+        std::unordered_map<Key, Replica>        mReplicas;
+        std::unordered_map<Session::Id, Usage>  mUsages;
+        mutable Mutex                           mLock;
+    };
+
+    /*---------------------*
+     *    ReplicaSchema    *
+     *---------------------*/
+
+    // SystemId::ReplicaSnapshot의 payload
+    struct ReplicaSnapshotSchema : MessageSchema<Replicator::StateId, Replicator::Tick, VarBytes>
+    {
+        enum : size_t { StateId, Tick, State };
+    };
+
+    // SystemId::ReplicaDelta의 payload, Runs는 Replicator::EncodeDelta의 출력
+    struct ReplicaDeltaSchema : MessageSchema<Replicator::StateId, Replicator::Tick, Replicator::Tick, uint32_t, VarBytes>
+    {
+        enum : size_t { StateId, Tick, BaseTick, Size, Runs };
+    };
+
+    // SystemId::ReplicaAck의 payload
+    struct ReplicaAckSchema : MessageSchema<Replicator::StateId, Replicator::Tick>
+    {
+        enum : size_t { StateId, Tick };
+    };
+}
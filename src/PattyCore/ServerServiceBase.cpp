@@ -4,16 +4,51 @@
 namespace PattyCore
 {
     ServerServiceBase::ServerServiceBase(const ThreadPoolGroup::Info& info, uint16_t port)
+        : ServerServiceBase(info, StreamEndpoint(Tcp::endpoint(Tcp::v4(), port)))
+    {}
+
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+    ServerServiceBase::ServerServiceBase(const ThreadPoolGroup::Info& info, const Local::endpoint& endpoint)
+        : ServerServiceBase(info, PrepareLocalEndpoint(endpoint))
+    {}
+#endif // ASIO_HAS_LOCAL_SOCKETS
+
+    ServerServiceBase::ServerServiceBase(const ThreadPoolGroup::Info& info, const StreamEndpoint& endpoint)
         : ServiceBase(info)
-        , mAcceptor(mThreadPoolGroup.GetSessionGroup(), Tcp::endpoint(Tcp::v4(), port))
+        , mAcceptor(mThreadPoolGroup.GetSessionGroup(), endpoint)
         , mSocket(mThreadPoolGroup.GetSocketGroup())
     {}
 
     void ServerServiceBase::Start()
     {
         AcceptAsync();
-        std::cout << "[SERVER] Started!\n";
+        std::cout << "[SERVER] Started! (io: " << GetIoBackend() << ")\n";
+    }
+
+    void ServerServiceBase::StartDatagram(uint16_t port)
+    {
+        OpenDatagramChannel(Udp::endpoint(Udp::v4(), port), true);
+        std::cout << "[SERVER] Datagram started!\n";
+    }
+
+    MemoryPipe::Ptr ServerServiceBase::AcceptLoopback(const MemoryPipe::Executor& clientExecutor)
+    {
+        auto [serverEnd, clientEnd] = MemoryPipe::CreatePair(mThreadPoolGroup.GetSocketGroup().get_executor(), clientExecutor);
+
+        CreateSession(std::move(serverEnd));
+
+        return clientEnd;
+    }
+
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+    StreamEndpoint ServerServiceBase::PrepareLocalEndpoint(const Local::endpoint& endpoint)
+    {
+        // A socket file left by a previous run makes bind fail
+        std::remove(endpoint.path().c_str());
+
+        return StreamEndpoint(endpoint);
     }
+#endif // ASIO_HAS_LOCAL_SOCKETS
 
     void ServerServiceBase::AcceptAsync()
     {
@@ -24,7 +59,7 @@ namespace PattyCore
                                });
     }
 
-    void ServerServiceBase::OnAccepted(const ErrCode& errCode, Tcp::socket socket)
+    void ServerServiceBase::OnAccepted(const ErrCode& errCode, StreamSocket socket)
     {
         if (errCode)
         {
@@ -32,7 +67,7 @@ namespace PattyCore
             return;
         }
 
-        mSocket = Tcp::socket(mThreadPoolGroup.GetSocketGroup());
+        mSocket = StreamSocket(mThreadPoolGroup.GetSocketGroup());
         AcceptAsync();
 
         CreateSession(std::move(socket));
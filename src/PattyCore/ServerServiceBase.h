@@ -12,16 +12,32 @@ namespace PattyCore
     {
     public:
         ServerServiceBase(const ThreadPoolGroup::Info& info, uint16_t port);
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+        ServerServiceBase(const ThreadPoolGroup::Info& info, const Local::endpoint& endpoint);
+#endif // ASIO_HAS_LOCAL_SOCKETS
 
         void Start();
+        void StartDatagram(uint16_t port);
+
+        // 같은 프로세스의 클라이언트를 커널 소켓 없이 받는다, 클라이언트가 쓸 끝을 돌려준다
+        MemoryPipe::Ptr AcceptLoopback(const MemoryPipe::Executor& clientExecutor);
+
+    protected:
+        virtual bool AcceptsResumption() const override { return true; }
 
     private:
+        ServerServiceBase(const ThreadPoolGroup::Info& info, const StreamEndpoint& endpoint);
+
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+        static StreamEndpoint PrepareLocalEndpoint(const Local::endpoint& endpoint);
+#endif // ASIO_HAS_LOCAL_SOCKETS
+
         void AcceptAsync();
-        void OnAccepted(const ErrCode& errCode, Tcp::socket socket);
+        void OnAccepted(const ErrCode& errCode, StreamSocket socket);
 
     protected:
-        Tcp::acceptor       mAcceptor;
-        Tcp::socket         mSocket;
+        StreamAcceptor      mAcceptor;
+        StreamSocket        mSocket;
 
     };
 }
@@ -4,18 +4,29 @@
 namespace PattyCore
 {
     ServiceBase::ThreadPoolGroup::ThreadPoolGroup(const Info& info)
-        : mSocketGroup(info.numSocketThreads)
+        : mInfo(info)
+        , mSocketGroup(info.numSocketThreads)
         , mSessionGroup(info.numSessionThreads)
-        , mMessageGroup(info.numMessageThreads)
+        , mMessageGroup(info.numMessageThreads, info.maxMessageThreads)
         , mTaskGroup(info.numTaskThreads)
         , mSocketGrd(asio::make_work_guard(mSocketGroup))
         , mSessionGrd(asio::make_work_guard(mSessionGroup))
-        , mMessageGrd(asio::make_work_guard(mMessageGroup))
         , mTaskGrd(asio::make_work_guard(mTaskGroup))
-    {}
+    {
+        if (info.socketPoll.spinInterval.count() != 0)
+        {
+            mSocketPoller = std::make_shared<BusyPoller>(mSocketGroup, info.numSocketThreads, info.socketPoll);
+            mSocketPoller->Start();
+        }
+    }
 
     void ServiceBase::ThreadPoolGroup::Stop()
     {
+        if (mSocketPoller)
+        {
+            mSocketPoller->Stop();
+        }
+
         mSocketGroup.stop();
         mSessionGroup.stop();
         mMessageGroup.stop();
@@ -40,7 +51,7 @@ namespace PattyCore
         return mSessionGroup; 
     }
 
-    ThreadPool& ServiceBase::ThreadPoolGroup::GetMessageGroup() 
+    WorkStealingPool& ServiceBase::ThreadPoolGroup::GetMessageGroup() 
     { 
         return mMessageGroup; 
     }
@@ -50,15 +61,36 @@ namespace PattyCore
         return mTaskGroup; 
     }
 
+    const BusyPoller::Ptr& ServiceBase::ThreadPoolGroup::GetSocketPoller() const
+    {
+        return mSocketPoller;
+    }
+
+    const ServiceBase::ThreadPoolGroup::Info& ServiceBase::ThreadPoolGroup::GetInfo() const
+    {
+        return mInfo;
+    }
+
     ServiceBase::ServiceBase(const ThreadPoolGroup::Info& info)
         : mThreadPoolGroup(info)
         , mSessionStrand(asio::make_strand(mThreadPoolGroup.GetSessionGroup()))
+        , mSendPolicy(std::make_shared<Session::SendPolicy>())
+        , mReceivePolicy(std::make_shared<Session::ReceivePolicy>())
+        , mResumePolicy(std::make_shared<Session::ResumePolicy>())
+        , mServiceStats(std::make_shared<ServiceStats>())
+        , mStatsTimer(mThreadPoolGroup.GetTaskGroup())
+        , mCoarseClock(std::make_shared<CoarseClock>(mThreadPoolGroup.GetTaskGroup()))
     {}
 
     ServiceBase::~ServiceBase() {}
 
     void ServiceBase::Stop()
     {
+        if (mDatagramChannel)
+        {
+            mDatagramChannel->Close();
+        }
+
         mThreadPoolGroup.Stop();
     }
 
@@ -67,25 +99,115 @@ namespace PattyCore
         mThreadPoolGroup.Join();
     }
 
-    void ServiceBase::CreateSession(Tcp::socket&& socket)
+    const char* ServiceBase::GetIoBackend()
+    {
+#if defined(ASIO_HAS_IO_URING) && defined(ASIO_DISABLE_EPOLL)
+        return "io_uring";
+#elif defined(ASIO_HAS_IOCP)
+        return "iocp";
+#elif defined(ASIO_HAS_EPOLL)
+        return "epoll";
+#elif defined(ASIO_HAS_KQUEUE)
+        return "kqueue";
+#else
+        return "select";
+#endif
+    }
+
+    Session::Ptr ServiceBase::CreateSession(Transport&& transport)
+    {
+        std::call_once(mSessionContextOnce,
+                       [this]()
+                       {
+                           mSessionContext = CreateSessionContext();
+                       });
+
+        Session::Ptr session = Session::Create(std::move(transport),
+                                               AssignId(),
+                                               asio::make_strand(mThreadPoolGroup.GetSocketGroup()),
+                                               mSessionContext);
+
+        // A session that may resume a detached one is registered once its first frame decides
+        if (!mSessionContext->onEstablished)
+        {
+            OnSessionCreated(session);
+        }
+
+        return session;
+    }
+
+    Session::Context::Ptr ServiceBase::CreateSessionContext()
     {
-        auto onSessionClosed = [this](const ErrCode& errCode, Session::Ptr session)
+        auto context = std::make_shared<Session::Context>();
+
+        context->onClosed = [this](const ErrCode& errCode, Session::Ptr session)
             {
                 OnSessionClosed(errCode, std::move(session));
             };
 
-        auto onMessageReceived = [this](OwnedMessage&& ownedMsg)
+        context->onReceived = [this](MessageBatch&& batch)
             {
-                DispatchReceivedMessage(std::move(ownedMsg));
+                DispatchReceivedBatch(std::move(batch));
             };
 
-        Session::Ptr session = Session::Create(std::move(socket),
-                                               AssignId(),
-                                               std::move(onSessionClosed),
-                                               asio::make_strand(mThreadPoolGroup.GetSocketGroup()),
-                                               std::move(onMessageReceived));
+        context->sendPolicy = mSendPolicy;
+        context->receivePolicy = mReceivePolicy;
+        context->clock = mCoarseClock;
+        context->serviceStats = mServiceStats;
+        context->captureLog = mCaptureLog;
+        context->tracer = mTracer;
+        context->busyPoller = mThreadPoolGroup.GetSocketPoller();
+        context->lean = mLeanSessions;
+
+        if (mResumesSessions)
+        {
+            context->resumePolicy = mResumePolicy;
+
+            context->onDetached = [this](Session::Ptr session)
+                {
+                    ReattachAsync(session);
+
+                    asio::post(mThreadPoolGroup.GetSessionGroup(),
+                               [this, session = std::move(session)]() mutable
+                               {
+                                   OnSessionDetached(std::move(session));
+                               });
+                };
+
+            context->onResumed = [this](Session::Ptr session, const bool resumed)
+                {
+                    asio::post(mThreadPoolGroup.GetSessionGroup(),
+                               [this, session = std::move(session), resumed]() mutable
+                               {
+                                   OnSessionResumed(std::move(session), resumed);
+                               });
+                };
+        }
+
+        if (mResumesSessions && AcceptsResumption())
+        {
+            context->onEstablished = [this](Session::Ptr session)
+                {
+                    OnSessionCreated(std::move(session));
+                };
+
+            context->findResumable = [this](const Session::ResumeToken token)
+                {
+                    return FindResumableSession(token);
+                };
+
+            context->issueResumeToken = [this](const Session::Ptr& session)
+                {
+                    return IssueResumeToken(session);
+                };
+        }
 
-        OnSessionCreated(std::move(session));
+        if (mReceivePolicy->IsEnabled())
+        {
+            mCoarseClock->Start();
+        }
+
+        return context;
     }
 
     void ServiceBase::BroadcastMessageAsync(Message&& msg, Session::Ptr ignored)
@@ -107,6 +229,239 @@ namespace PattyCore
                    });
     }
 
+    bool ServiceBase::SubscribeTopic(const TopicMap::Id topicId, Session::Ptr session)
+    {
+        return mTopicMap.Subscribe(topicId, std::move(session));
+    }
+
+    bool ServiceBase::UnsubscribeTopic(const TopicMap::Id topicId, const Session::Ptr& session)
+    {
+        return mTopicMap.Unsubscribe(topicId, session);
+    }
+
+    void ServiceBase::PublishMessageAsync(const TopicMap::Id topicId, Message&& msg, Session::Ptr ignored)
+    {
+        const Session::Id ignoredId = (ignored) ? ignored->GetId() : -1;
+
+        // Fan-out to a large topic runs on a task thread rather than the caller's
+        asio::post(mThreadPoolGroup.GetTaskGroup(),
+                   [this, topicId, msg = std::move(msg), ignoredId]()
+                   {
+                       mTopicMap.Publish(topicId, msg, ignoredId);
+                   });
+    }
+
+    void ServiceBase::UpdateInterest(Session::Ptr session, const InterestGrid::Position& position, const float radius)
+    {
+        mInterestGrid.Update(session, position, radius);
+    }
+
+    bool ServiceBase::RemoveInterest(const Session::Ptr& session)
+    {
+        return mInterestGrid.Remove(session);
+    }
+
+    void ServiceBase::PublishNearbyAsync(const InterestGrid::Position& position, Message&& msg, Session::Ptr ignored)
+    {
+        const Session::Id ignoredId = (ignored) ? ignored->GetId() : -1;
+
+        // Same as a topic, a crowded spot fans out on a task thread
+        asio::post(mThreadPoolGroup.GetTaskGroup(),
+                   [this, position, msg = std::move(msg), ignoredId]()
+                   {
+                       mInterestGrid.Publish(position, msg, ignoredId);
+                   });
+    }
+
+    void ServiceBase::ForEachSessionParallel(SessionWork work, OnWorkDone onDone, const size_t minChunkSize)
+    {
+        SPtr<ParallelWork> parallelWork = std::make_shared<ParallelWork>();
+        parallelWork->work = std::move(work);
+        parallelWork->onDone = std::move(onDone);
+
+        asio::post(mSessionStrand,
+                   [this, parallelWork = std::move(parallelWork), minChunkSize]()
+                   {
+                       // Chunks run on a snapshot, sessions closed meanwhile are still visited
+                       std::vector<Session::Ptr>& sessions = parallelWork->sessions;
+                       sessions.reserve(mSessionMap.size());
+
+                       for (auto& pair : mSessionMap)
+                       {
+                           sessions.push_back(pair.second);
+                       }
+
+                       const size_t numSessions = sessions.size();
+                       const size_t maxChunks = std::max<size_t>(mThreadPoolGroup.GetInfo().numTaskThreads, 1) * chunksPerTaskThread;
+                       const size_t numChunks = std::clamp<size_t>(numSessions / std::max<size_t>(minChunkSize, 1), 1, maxChunks);
+                       const size_t chunkSize = std::max<size_t>((numSessions + numChunks - 1) / numChunks, 1);
+
+                       // An empty session set still runs one empty chunk so onDone is called
+                       parallelWork->numPendingChunks.store(std::max<size_t>((numSessions + chunkSize - 1) / chunkSize, 1));
+
+                       size_t begin = 0;
+
+                       do
+                       {
+                           const size_t end = std::min(begin + chunkSize, numSessions);
+
+                           asio::post(mThreadPoolGroup.GetTaskGroup(),
+                                      [this, parallelWork, begin, end]()
+                                      {
+                                          RunSessionChunk(parallelWork, begin, end);
+                                      });
+
+                           begin = end;
+                       } while (begin < numSessions);
+                   });
+    }
+
+    void ServiceBase::CollectStatsAsync(OnStatsCollected onCollected)
+    {
+        asio::post(mSessionStrand,
+                   [this, onCollected = std::move(onCollected)]() mutable
+                   {
+                       auto collection = std::make_shared<StatsCollection>();
+                       collection->onCollected = std::move(onCollected);
+
+                       StatsSnapshot& snapshot = collection->snapshot;
+                       snapshot.service = mServiceStats->Read();
+                       snapshot.messageGroup = mThreadPoolGroup.GetMessageGroup().GetStats();
+
+                       if (const BusyPoller::Ptr& socketPoller = mThreadPoolGroup.GetSocketPoller())
+                       {
+                           snapshot.socketPoll = socketPoller->GetStats();
+                       }
+
+                       if (mSessionMap.empty())
+                       {
+                           FinishStatsCollection(std::move(collection));
+                           return;
+                       }
+
+                       // Each session fills its own entry, so the entries need no lock
+                       snapshot.sessions.resize(mSessionMap.size());
+                       collection->numPendingSessions.store(mSessionMap.size());
+
+                       size_t index = 0;
+
+                       for (auto& pair : mSessionMap)
+                       {
+                           pair.second->ReadStatsAsync([this, collection, index](StatsSnapshot::SessionEntry&& entry)
+                                                       {
+                                                           collection->snapshot.sessions[index] = std::move(entry);
+
+                                                           if (collection->numPendingSessions.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                                                           {
+                                                               FinishStatsCollection(collection);
+                                                           }
+                                                       });
+                           ++index;
+                       }
+                   });
+    }
+
+    void ServiceBase::FinishStatsCollection(SPtr<StatsCollection> collection)
+    {
+        asio::post(mSessionStrand,
+                   [this, collection = std::move(collection)]()
+                   {
+                       StatsSnapshot& snapshot = collection->snapshot;
+                       snapshot.SortSessions();
+
+                       if (mHandlerProfiler != nullptr)
+                       {
+                           snapshot.handlers = mHandlerProfiler->Collect();
+                       }
+
+                       collection->onCollected(std::move(snapshot));
+                   });
+    }
+
+    void ServiceBase::StartStatsDump(const Milliseconds interval, const StatsSnapshot::Format format, const size_t maxSessions)
+    {
+        WaitStatsDumpAsync(interval, format, maxSessions);
+    }
+
+    bool ServiceBase::StartCapture(const std::string& path, const size_t capacity)
+    {
+        CaptureLog::Ptr captureLog = std::make_shared<CaptureLog>(path, capacity);
+
+        if (!captureLog->IsOpen())
+        {
+            return false;
+        }
+
+        mCaptureLog = std::move(captureLog);
+        std::cout << "[CAPTURE] Started: " << path << "\n";
+
+        return true;
+    }
+
+    void ServiceBase::StartTracing(const uint32_t sampleInterval, const size_t eventsPerThread)
+    {
+        mTracer = std::make_shared<Tracer>(sampleInterval, eventsPerThread);
+        std::cout << "[TRACE] Started: 1/" << sampleInterval << " messages\n";
+    }
+
+    bool ServiceBase::ExportTrace(const std::string& path) const
+    {
+        if (mTracer == nullptr)
+        {
+            return false;
+        }
+
+        return mTracer->Export(path);
+    }
+
+    void ServiceBase::StartPoolController(const PoolController::Config& config)
+    {
+        assert(mPoolController == nullptr);
+
+        mPoolController = std::make_unique<PoolController>(mThreadPoolGroup.GetTaskGroup(),
+                                                           mThreadPoolGroup.GetMessageGroup(),
+                                                           config);
+        mPoolController->Start();
+    }
+
+    void ServiceBase::StartHandlerProfiling(const HandlerProfiler::Config& config)
+    {
+        assert(mHandlerProfiler == nullptr);
+
+        mHandlerProfiler = std::make_unique<HandlerProfiler>(mThreadPoolGroup.GetTaskGroup(), config);
+        mHandlerProfiler->Start();
+    }
+
+    void ServiceBase::OpenDatagramChannel(const Udp::endpoint& local, const bool offersBinding)
+    {
+        assert(mDatagramChannel == nullptr);
+
+        auto onDatagramReceived = [this](const DatagramChannel::Header& header, const Udp::endpoint& remote, Message&& msg)
+            {
+                OnDatagramReceived(header, remote, std::move(msg));
+            };
+
+        mDatagramChannel = std::make_shared<DatagramChannel>(mThreadPoolGroup.GetSocketGroup(),
+                                                             local,
+                                                             std::move(onDatagramReceived));
+        mOffersDatagramBinding = offersBinding;
+        mDatagramChannel->Start();
+    }
+
+    void ServiceBase::RunSessionChunk(const SPtr<ParallelWork>& parallelWork, const size_t begin, const size_t end)
+    {
+        for (size_t idx = begin; idx < end; ++idx)
+        {
+            parallelWork->work(parallelWork->sessions[idx]);
+        }
+
+        // The last chunk to finish joins
+        if ((parallelWork->numPendingChunks.fetch_sub(1) == 1) && parallelWork->onDone)
+        {
+            parallelWork->onDone();
+        }
+    }
+
     Session::Id ServiceBase::AssignId() const
     {
         static std::atomic<Session::Id> id = 10000;
@@ -117,13 +472,431 @@ namespace PattyCore
 
     void ServiceBase::DispatchReceivedMessage(OwnedMessage&& ownedMsg)
     {
+        if (Message::IsSystemId(ownedMsg.msg.header.id))
+        {
+            HandleSystemMessage(std::move(ownedMsg));
+            return;
+        }
+
+        const int64_t postedAt = (ownedMsg.traceId != 0) ? SteadyNowNs() : 0;
+
         asio::post(mThreadPoolGroup.GetMessageGroup(),
-                   [this, ownedMsg = std::move(ownedMsg)]() mutable
+                   [this, ownedMsg = std::move(ownedMsg), postedAt]() mutable
                    {
-                       OnMessageReceived(std::move(ownedMsg));
+                       const Tracer::Id traceId = ownedMsg.traceId;
+
+                       if (traceId != 0)
+                       {
+                           mTracer->Record("message", "dispatch", traceId, postedAt, SteadyNowNs());
+                       }
+
+                       {
+                           Tracer::Scope scope(mTracer.get(), traceId, "message", "handler");
+                           HandlerProfiler::Scope profile(mHandlerProfiler.get(), ownedMsg);
+                           OnMessageReceived(std::move(ownedMsg));
+                       }
+
+                       mServiceStats->Add(ServiceCounter::MessagesHandled);
                    });
     }
 
+    void ServiceBase::DispatchReceivedBatch(MessageBatch&& batch)
+    {
+        if (!mDeliversBatches)
+        {
+            for (OwnedMessage& ownedMsg : batch)
+            {
+                DispatchReceivedMessage(std::move(ownedMsg));
+            }
+
+            return;
+        }
+
+        // System messages are handled here, the rest is compacted in arrival order
+        size_t numUserMsgs = 0;
+        bool isTraced = false;
+
+        for (size_t idx = 0; idx < batch.size(); ++idx)
+        {
+            if (Message::IsSystemId(batch[idx].msg.header.id))
+            {
+                HandleSystemMessage(std::move(batch[idx]));
+                continue;
+            }
+
+            if (numUserMsgs != idx)
+            {
+                batch[numUserMsgs] = std::move(batch[idx]);
+            }
+
+            isTraced |= (batch[numUserMsgs].traceId != 0);
+            ++numUserMsgs;
+        }
+
+        batch.resize(numUserMsgs);
+
+        if (batch.empty())
+        {
+            return;
+        }
+
+        const int64_t postedAt = isTraced ? SteadyNowNs() : 0;
+
+        asio::post(mThreadPoolGroup.GetMessageGroup(),
+                   [this, batch = std::move(batch), postedAt]() mutable
+                   {
+                       const size_t numMsgs = batch.size();
+
+                       if (postedAt != 0)
+                       {
+                           const int64_t now = SteadyNowNs();
+
+                           for (const OwnedMessage& ownedMsg : batch)
+                           {
+                               if (ownedMsg.traceId != 0)
+                               {
+                                   mTracer->Record("message", "dispatch", ownedMsg.traceId, postedAt, now);
+                               }
+                           }
+                       }
+
+                       OnMessagesReceived(std::move(batch));
+                       mServiceStats->Add(ServiceCounter::MessagesHandled, numMsgs);
+                   });
+    }
+
+    void ServiceBase::OnMessagesReceived(MessageBatch batch)
+    {
+        for (OwnedMessage& ownedMsg : batch)
+        {
+            Tracer::Scope scope(mTracer.get(), ownedMsg.traceId, "message", "handler");
+            HandlerProfiler::Scope profile(mHandlerProfiler.get(), ownedMsg);
+            OnMessageReceived(std::move(ownedMsg));
+        }
+    }
+
+    void ServiceBase::HandleSystemMessage(OwnedMessage&& ownedMsg)
+    {
+        const Message::SystemId systemId = static_cast<Message::SystemId>(ownedMsg.msg.header.id);
+
+        switch (systemId)
+        {
+        case Message::SystemId::DatagramBind:
+            AcceptDatagramBinding(std::move(ownedMsg));
+            break;
+
+        case Message::SystemId::DatagramBound:
+            ownedMsg.owner->ConfirmDatagram();
+            break;
+
+        case Message::SystemId::StatsQuery:
+            HandleStatsQuery(std::move(ownedMsg));
+            break;
+
+        case Message::SystemId::StatsReply:
+            break;
+
+        case Message::SystemId::ReplicaSnapshot:
+        case Message::SystemId::ReplicaDelta:
+            HandleReplicaUpdate(std::move(ownedMsg));
+            break;
+
+        case Message::SystemId::ReplicaAck:
+            HandleReplicaAck(std::move(ownedMsg));
+            break;
+
+        default:
+            std::cerr << ownedMsg << " Unknown system message\n";
+            break;
+        }
+    }
+
+    void ServiceBase::OfferDatagramBinding(const Session::Ptr& session)
+    {
+        // Session ids are sequential, so no part of the token may be derived from one
+        static thread_local std::mt19937_64 engine(std::random_device{}());
+
+        DatagramChannel::Token token = 0;
+
+        {
+            SMutexULock lock(mDatagramSessionLock);
+
+            while ((token == 0) || (mDatagramSessionMap.count(token) != 0))
+            {
+                token = engine();
+            }
+
+            mDatagramSessionMap[token] = session;
+        }
+
+        // The remote endpoint is learned from the first datagram carrying the token
+        session->BindDatagram(mDatagramChannel, token, Udp::endpoint());
+
+        Message msg;
+        msg.header.id = static_cast<Message::Id>(Message::SystemId::DatagramBind);
+
+        MessageBuilder<DatagramBindSchema> builder(msg);
+        builder.Set<DatagramBindSchema::Token>(token)
+               .Set<DatagramBindSchema::Port>(mDatagramChannel->GetPort());
+
+        session->SendAsync(std::move(msg), Session::Priority::Control);
+    }
+
+    void ServiceBase::AcceptDatagramBinding(OwnedMessage&& ownedMsg)
+    {
+        if ((mDatagramChannel == nullptr) || mOffersDatagramBinding)
+        {
+            return;
+        }
+
+        const MessageView<DatagramBindSchema> view(ownedMsg.msg);
+
+        if (!view.IsValid())
+        {
+            std::cerr << ownedMsg << " Malformed datagram bind\n";
+            return;
+        }
+
+        const DatagramChannel::Token token = view.Get<DatagramBindSchema::Token>();
+        const uint16_t port = view.Get<DatagramBindSchema::Port>();
+
+        Session::Ptr& session = ownedMsg.owner;
+        session->BindDatagram(mDatagramChannel, token, Udp::endpoint(session->GetAddress(), port));
+
+        {
+            SMutexULock lock(mDatagramSessionLock);
+            mDatagramSessionMap[token] = session;
+        }
+
+        SendDatagramHello(session, 0);
+    }
+
+    void ServiceBase::SendDatagramHello(const Session::Ptr& session, const size_t attempt)
+    {
+        if (session->IsClosed() || session->IsDatagramConfirmed())
+        {
+            return;
+        }
+
+        if (attempt == maxDatagramHellos)
+        {
+            std::cerr << "[" << session->GetId() << "] Datagram bind not acknowledged\n";
+            return;
+        }
+
+        // Any datagram lets the peer learn our endpoint, an empty bind message is enough
+        Message hello;
+        hello.header.id = static_cast<Message::Id>(Message::SystemId::DatagramBind);
+
+        session->SendDatagramAsync(std::move(hello));
+
+        auto timer = std::make_shared<Timer>(mThreadPoolGroup.GetTaskGroup(), datagramHelloInterval);
+        timer->async_wait([this, timer, weakSession = WPtr<Session>(session), attempt](const ErrCode& errCode)
+                          {
+                              if (errCode)
+                              {
+                                  return;
+                              }
+
+                              if (Session::Ptr session = weakSession.lock())
+                              {
+                                  SendDatagramHello(session, attempt + 1);
+                              }
+                          });
+    }
+
+    void ServiceBase::HandleStatsQuery(OwnedMessage&& ownedMsg)
+    {
+        if (!mAllowsStatsQuery)
+        {
+            return;
+        }
+
+        // The reply exposes every session's address and counters
+        if (!AllowsStatsQuery(ownedMsg.owner))
+        {
+            std::cerr << ownedMsg << " Stats query rejected\n";
+            return;
+        }
+
+        StatsSnapshot::Format format = StatsSnapshot::Format::Text;
+
+        if (!ownedMsg.msg.payload.empty())
+        {
+            ownedMsg.msg >> format;
+        }
+
+        CollectStatsAsync([session = std::move(ownedMsg.owner), format](StatsSnapshot&& snapshot)
+                          {
+                              const std::string text = snapshot.ToString(format, maxStatsQuerySessions);
+
+                              Message reply;
+                              reply.header.id = static_cast<Message::Id>(Message::SystemId::StatsReply);
+                              reply.payload.resize(text.size());
+                              std::memcpy(reply.payload.data(), text.data(), text.size());
+                              reply.header.size = static_cast<Message::Size>(reply.CalculateSize());
+
+                              session->SendAsync(std::move(reply), Session::Priority::Control);
+                          });
+    }
+
+    bool ServiceBase::AllowsStatsQuery(const Session::Ptr& session) const
+    {
+        if (session->IsLocal())
+        {
+            return true;
+        }
+
+        return UnmapAddress(session->GetAddress()).is_loopback();
+    }
+
+    void ServiceBase::HandleReplicaUpdate(OwnedMessage&& ownedMsg)
+    {
+        // Otherwise any peer could make the service store state on its behalf
+        if (!mAcceptsReplicas)
+        {
+            return;
+        }
+
+        Session::Ptr& session = ownedMsg.owner;
+        Replicator::StateId stateId = 0;
+
+        const Replicator::Tick tick = mReplicaSet.Apply(session->GetId(), ownedMsg.msg, stateId);
+
+        // Without an acknowledgement the sender keeps diffing against the last applied state
+        if (tick == 0)
+        {
+            std::cerr << ownedMsg << " Failed to apply replica\n";
+            return;
+        }
+
+        Message ack;
+        ack.header.id = static_cast<Message::Id>(Message::SystemId::ReplicaAck);
+
+        MessageBuilder<ReplicaAckSchema> builder(ack);
+        builder.Set<ReplicaAckSchema::StateId>(stateId)
+               .Set<ReplicaAckSchema::Tick>(tick);
+
+        // Only the newest acknowledgement matters
+        session->SendConflatedAsync(std::move(ack), Replicator::ackKeyBegin | stateId, Session::Priority::Control);
+
+        asio::post(mThreadPoolGroup.GetMessageGroup(),
+                   [this, session = std::move(session), stateId, tick]() mutable
+                   {
+                       OnReplicaUpdated(std::move(session), stateId, tick);
+                   });
+    }
+
+    void ServiceBase::HandleReplicaAck(OwnedMessage&& ownedMsg)
+    {
+        const MessageView<ReplicaAckSchema> view(ownedMsg.msg);
+
+        if (!view.IsValid())
+        {
+            std::cerr << ownedMsg << " Malformed replica ack\n";
+            return;
+        }
+
+        mReplicator.Acknowledge(view.Get<ReplicaAckSchema::StateId>(), ownedMsg.owner->GetId(), view.Get<ReplicaAckSchema::Tick>());
+    }
+
+    void ServiceBase::WaitStatsDumpAsync(const Milliseconds interval, const StatsSnapshot::Format format, const size_t maxSessions)
+    {
+        mStatsTimer.expires_after(interval);
+        mStatsTimer.async_wait([this, interval, format, maxSessions](const ErrCode& errCode)
+                               {
+                                   if (errCode)
+                                   {
+                                       std::cerr << "[STATS] Failed to wait stats timer: " << errCode << "\n";
+                                       return;
+                                   }
+
+                                   CollectStatsAsync([format, maxSessions](StatsSnapshot&& snapshot)
+                                                     {
+                                                         std::cout << snapshot.ToString(format, maxSessions) << "\n";
+                                                     });
+
+                                   WaitStatsDumpAsync(interval, format, maxSessions);
+                               });
+    }
+
+    void ServiceBase::OnDatagramReceived(const DatagramChannel::Header& header, const Udp::endpoint& remote, Message&& msg)
+    {
+        Session::Ptr session;
+
+        {
+            SMutexSLock lock(mDatagramSessionLock);
+
+            auto iter = mDatagramSessionMap.find(header.token);
+
+            if (iter == mDatagramSessionMap.end())
+            {
+                return;
+            }
+
+            session = iter->second.lock();
+        }
+
+        bool learned = false;
+
+        // Stale, reordered or foreign datagrams are dropped
+        if ((session == nullptr) || !session->AcceptDatagram(header, remote, learned))
+        {
+            return;
+        }
+
+        // Over the stream, since the reply must not depend on the datagram path it confirms
+        if (learned)
+        {
+            Message bound;
+            bound.header.id = static_cast<Message::Id>(Message::SystemId::DatagramBound);
+
+            session->SendAsync(std::move(bound), Session::Priority::Control);
+        }
+
+        if (Message::IsSystemId(msg.header.id))
+        {
+            return;
+        }
+
+        const size_t numBytes = DatagramChannel::headerSize + msg.CalculateSize();
+
+        session->ReceiveDatagramAsync(std::move(msg), numBytes);
+    }
+
+    Session::ResumeToken ServiceBase::IssueResumeToken(const Session::Ptr& session)
+    {
+        // This one lets a connection take over a session, so it is never derived from the session
+        static thread_local std::mt19937_64 engine(std::random_device{}());
+
+        MutexLockGrd lock(mResumeSessionLock);
+
+        Session::ResumeToken token = 0;
+
+        while ((token == 0) || (mResumeSessionMap.count(token) != 0))
+        {
+            token = engine();
+        }
+
+        mResumeSessionMap[token] = session;
+
+        return token;
+    }
+
+    Session::Ptr ServiceBase::FindResumableSession(const Session::ResumeToken token)
+    {
+        MutexLockGrd lock(mResumeSessionLock);
+
+        auto iter = mResumeSessionMap.find(token);
+
+        if (iter == mResumeSessionMap.end())
+        {
+            return nullptr;
+        }
+
+        return iter->second.lock();
+    }
+
     void ServiceBase::OnSessionCreated(Session::Ptr session)
     {
         asio::post(mSessionStrand,
@@ -139,6 +912,12 @@ namespace PattyCore
 
         assert(mSessionMap.count(id) == 0);
         mSessionMap[id] = std::move(session);
+        mServiceStats->Add(ServiceCounter::SessionsOpened);
+
+        if (mDatagramChannel && mOffersDatagramBinding)
+        {
+            OfferDatagramBinding(mSessionMap[id]);
+        }
 
         asio::post(mThreadPoolGroup.GetSessionGroup(),
                    [this, session = mSessionMap[id]]() mutable
@@ -167,6 +946,23 @@ namespace PattyCore
 
         assert(mSessionMap.count(id) == 1);
         mSessionMap.erase(id);
+        mServiceStats->Add(ServiceCounter::SessionsClosed);
+        mTopicMap.UnsubscribeAll(session);
+        mInterestGrid.Remove(session);
+        mReplicator.UnsubscribeAll(session);
+        mReplicaSet.Erase(id);
+
+        if (mDatagramChannel)
+        {
+            SMutexULock lock(mDatagramSessionLock);
+            mDatagramSessionMap.erase(session->GetDatagramToken());
+        }
+
+        if (mResumesSessions)
+        {
+            MutexLockGrd lock(mResumeSessionLock);
+            mResumeSessionMap.erase(session->GetResumeToken());
+        }
 
         asio::post(mThreadPoolGroup.GetSessionGroup(),
                    [this, session = std::move(session)]() mutable
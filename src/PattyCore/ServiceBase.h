@@ -1,6 +1,11 @@
 ﻿#pragma once
 
 #include "Session.h"
+#include "TopicMap.h"
+#include "Replicator.h"
+#include "InterestGrid.h"
+#include "PoolController.h"
+#include "HandlerProfiler.h"
 
 namespace PattyCore
 {
@@ -24,6 +29,10 @@ namespace PattyCore
                 uint8_t     numSessionThreads;
                 uint8_t     numMessageThreads;
                 uint8_t     numTaskThreads;
+                uint8_t     maxMessageThreads = 0;  // numMessageThreads보다 크면 PoolController가 이 범위에서 조절할 수 있다
+
+                // spinInterval이 0이 아니면 소켓 스레드마다 코어 하나를 써서 수신 뒤 그 시간 동안 커널에서 잠들지 않는다
+                BusyPoller::Config  socketPoll;
             };
 
         public:
@@ -32,25 +41,34 @@ namespace PattyCore
             void Stop();
             void Join();
 
-            ThreadPool&     GetSocketGroup();
-            ThreadPool&     GetSessionGroup();
-            ThreadPool&     GetMessageGroup();
-            ThreadPool&     GetTaskGroup();
+            ThreadPool&         GetSocketGroup();
+            ThreadPool&         GetSessionGroup();
+            WorkStealingPool&   GetMessageGroup();
+            ThreadPool&         GetTaskGroup();
+
+            // socketPoll.spinInterval이 0이면 nullptr
+            const BusyPoller::Ptr& GetSocketPoller() const;
+
+            const Info&         GetInfo() const;
 
         private:
-            ThreadPool      mSocketGroup;   // 소켓 입출력 스레드
-            ThreadPool      mSessionGroup;  // 세션 관리 스레드
-            ThreadPool      mMessageGroup;  // 메시지 처리 스레드
-            ThreadPool      mTaskGroup;     // 범용 비동기 작업 스레드
-
-            WorkGrd         mSocketGrd;
-            WorkGrd         mSessionGrd;
-            WorkGrd         mMessageGrd;
-            WorkGrd         mTaskGrd;
+            const Info          mInfo;
+
+            ThreadPool          mSocketGroup;   // 소켓 입출력 스레드
+            ThreadPool          mSessionGroup;  // 세션 관리 스레드
+            WorkStealingPool    mMessageGroup;  // 메시지 처리 스레드, 핸들러 비용이 고르지 않아 작업을 훔친다
+            ThreadPool          mTaskGroup;     // 범용 비동기 작업 스레드
+
+            WorkGrd             mSocketGrd;
+            WorkGrd             mSessionGrd;
+            WorkGrd             mTaskGrd;
+
+            BusyPoller::Ptr     mSocketPoller;
         };
 
     protected:
         using OwnedMessage = Session::OwnedMessage;
+        using MessageBatch = Session::MessageBatch;
 
     public:
         ServiceBase(const ThreadPoolGroup::Info& threadsInfo);
@@ -59,17 +77,134 @@ namespace PattyCore
         void Stop();
         void Join();
 
+        static const char* GetIoBackend();
+
+        // StartTracing 이후 기록된 구간을 trace event JSON으로 쓴다
+        bool ExportTrace(const std::string& path) const;
+
     protected:
-        virtual void OnSessionRegistered(Session::Ptr session) {}
-        virtual void OnSessionUnregistered(Session::Ptr session) {}
-        virtual void OnMessageReceived(OwnedMessage ownedMsg) {}
+        virtual void OnSessionRegistered(Session::Ptr /*session*/) {}
+        virtual void OnSessionUnregistered(Session::Ptr /*session*/) {}
 
-        void CreateSession(Tcp::socket&& socket);
+        // mResumesSessions가 true일 때 호출된다, 끊긴 세션은 재개되거나 제한 시간 뒤에 등록 해제된다
+        virtual void OnSessionDetached(Session::Ptr /*session*/) {}
+        virtual void OnSessionResumed(Session::Ptr /*session*/, const bool /*resumed*/) {}
+        virtual void OnMessageReceived(OwnedMessage /*ownedMsg*/) {}
+
+        // 상대가 복제하는 상태가 tick으로 갱신되었다, mReplicaSet에서 읽는다
+        virtual void OnReplicaUpdated(Session::Ptr /*session*/, const Replicator::StateId /*stateId*/, const Replicator::Tick /*tick*/) {}
+
+        // mDeliversBatches가 true일 때 호출된다, 기본 구현은 메시지마다 OnMessageReceived를 호출한다
+        // 재정의하면 추적 구간의 handler는 직접 Tracer::Scope로, 핸들러 시간은 HandlerProfiler::Scope로 기록해야 한다
+        virtual void OnMessagesReceived(MessageBatch batch);
+
+        Session::Ptr CreateSession(Transport&& transport);
         void BroadcastMessageAsync(Message&& msg, Session::Ptr ignored = nullptr);
 
+        bool SubscribeTopic(const TopicMap::Id topicId, Session::Ptr session);
+        bool UnsubscribeTopic(const TopicMap::Id topicId, const Session::Ptr& session);
+
+        // 태스크 스레드에서 구독자들에 보낸다
+        void PublishMessageAsync(const TopicMap::Id topicId, Message&& msg, Session::Ptr ignored = nullptr);
+
+        // 세션의 위치와 관심 반경을 갱신한다, 이후 PublishNearbyAsync는 관심 반경 안의 위치에서 발행한 메시지만 보낸다
+        void UpdateInterest(Session::Ptr session, const InterestGrid::Position& position, const float radius);
+        bool RemoveInterest(const Session::Ptr& session);
+
+        // 태스크 스레드에서 position을 관심 반경에 둔 세션들에 보낸다
+        void PublishNearbyAsync(const InterestGrid::Position& position, Message&& msg, Session::Ptr ignored = nullptr);
+
+        using SessionWork = std::function<void(const Session::Ptr&)>;
+        using OnWorkDone = std::function<void()>;
+
+        // 등록된 세션을 나눠서 태스크 스레드들에서 work를 실행하고, 모두 끝나면 태스크 스레드에서 onDone을 호출한다
+        // work는 여러 스레드에서 동시에 호출된다
+        void ForEachSessionParallel(SessionWork work, OnWorkDone onDone, const size_t minChunkSize = defaultMinChunkSize);
+
+        using OnStatsCollected = std::function<void(StatsSnapshot&&)>;
+
+        // 세션마다 그 세션의 스트랜드에서 통계를 읽어 모은 뒤 onCollected를 호출한다
+        void CollectStatsAsync(OnStatsCollected onCollected);
+        void StartStatsDump(const Milliseconds interval, const StatsSnapshot::Format format, const size_t maxSessions);
+
+        // 이후 생성되는 세션의 수신 프레임을 path에 기록한다, Start 전에 호출해야 한다
+        bool StartCapture(const std::string& path, const size_t capacity);
+
+        // 이후 생성되는 세션에서 sampleInterval개의 메시지마다 하나를 추적한다, Start 전에 호출해야 한다
+        void StartTracing(const uint32_t sampleInterval, const size_t eventsPerThread);
+
+        // 메시지 스레드 그룹의 활성 스레드 수를 부하에 따라 조절한다, 최대치는 Info::maxMessageThreads
+        void StartPoolController(const PoolController::Config& config);
+
+        // 메시지 id별 핸들러 시간을 통계에 더하고 slowThreshold를 넘겨 실행 중인 핸들러를 알린다, Start 전에 호출해야 한다
+        // mDeliversBatches일 때 OnMessagesReceived를 재정의했다면 메시지마다 HandlerProfiler::Scope(mHandlerProfiler.get(), ...)로
+        // 감싸야 한다, 감싸지 않은 핸들러는 통계에도 watchdog에도 잡히지 않는다
+        void StartHandlerProfiling(const HandlerProfiler::Config& config);
+
+        // offersBinding이 true면 등록되는 세션마다 토큰을 발급해서 TCP로 전달한다
+        void OpenDatagramChannel(const Udp::endpoint& local, const bool offersBinding);
+
+        // mAllowsStatsQuery가 true일 때 StatsQuery에 응답할 세션이면 true
+        // 기본 구현은 같은 프로세스나 루프백 주소에서 연결한 세션만 허용한다
+        virtual bool AllowsStatsQuery(const Session::Ptr& session) const;
+
+        // 재개 토큰을 발급하고 재연결을 받는 쪽이면 true
+        virtual bool AcceptsResumption() const { return false; }
+
+        // 끊긴 세션에 새 연결을 붙인다, 연결하는 쪽이 재정의한다
+        virtual void ReattachAsync(Session::Ptr /*session*/) {}
+
     private:
+        /*--------------------*
+         *    ParallelWork    *
+         *--------------------*/
+
+        struct ParallelWork
+        {
+            std::vector<Session::Ptr>   sessions;
+            SessionWork                 work;
+            OnWorkDone                  onDone;
+            std::atomic<size_t>         numPendingChunks = 0;
+        };
+
+        static constexpr size_t     defaultMinChunkSize = 256;
+        static constexpr size_t     chunksPerTaskThread = 4;    // 비용이 고르지 않아도 스레드들이 비슷하게 끝나도록 잘게 나눈다
+
+        void RunSessionChunk(const SPtr<ParallelWork>& parallelWork, const size_t begin, const size_t end);
+
+        /*-----------------------*
+         *    StatsCollection    *
+         *-----------------------*/
+
+        struct StatsCollection
+        {
+            StatsSnapshot           snapshot;
+            OnStatsCollected        onCollected;
+            std::atomic<size_t>     numPendingSessions = 0;
+        };
+
+        void FinishStatsCollection(SPtr<StatsCollection> collection);
+
+        // 첫 세션을 만들 때 한 번 만들어서 모든 세션이 공유한다
+        Session::Context::Ptr CreateSessionContext();
+
         Session::Id AssignId() const;
         void DispatchReceivedMessage(OwnedMessage&& ownedMsg);
+        void DispatchReceivedBatch(MessageBatch&& batch);
+        void HandleSystemMessage(OwnedMessage&& ownedMsg);
+
+        void OfferDatagramBinding(const Session::Ptr& session);
+        void AcceptDatagramBinding(OwnedMessage&& ownedMsg);
+        void SendDatagramHello(const Session::Ptr& session, const size_t attempt);
+        void HandleStatsQuery(OwnedMessage&& ownedMsg);
+        void HandleReplicaUpdate(OwnedMessage&& ownedMsg);
+        void HandleReplicaAck(OwnedMessage&& ownedMsg);
+
+        void WaitStatsDumpAsync(const Milliseconds interval, const StatsSnapshot::Format format, const size_t maxSessions);
+        void OnDatagramReceived(const DatagramChannel::Header& header, const Udp::endpoint& remote, Message&& msg);
+
+        Session::ResumeToken IssueResumeToken(const Session::Ptr& session);
+        Session::Ptr FindResumableSession(const Session::ResumeToken token);
 
         void OnSessionCreated(Session::Ptr session);
         void RegisterSession(Session::Ptr session);
@@ -81,5 +216,54 @@ namespace PattyCore
 
         Session::Map        mSessionMap;
         Strand              mSessionStrand;
+
+        TopicMap            mTopicMap;
+        InterestGrid        mInterestGrid;  // 셀 크기는 세션을 등록하기 전에 SetCellSize로 바꾼다
+
+        Replicator          mReplicator;    // 보내는 쪽, 등록한 상태를 구독한 세션들에 복제한다
+        ReplicaSet          mReplicaSet;    // 받는 쪽, mAcceptsReplicas가 true면 세션별로 상대의 상태를 유지한다
+
+        // 세션 생성 전에 설정해야 한다
+        SPtr<Session::SendPolicy>   mSendPolicy;
+        SPtr<Session::ReceivePolicy> mReceivePolicy;
+        SPtr<Session::ResumePolicy> mResumePolicy;
+
+        SPtr<ServiceStats>          mServiceStats;
+        bool                        mAllowsStatsQuery = false;  // StatsQuery 메시지에 응답할지 여부
+        bool                        mAcceptsReplicas = false;   // true면 상대가 보내는 복제 상태를 mReplicaSet에 적용한다
+        bool                        mDeliversBatches = false;   // true면 소켓 읽기 한 번의 메시지들을 한 번에 게시한다
+        bool                        mLeanSessions = false;      // true면 유휴 세션이 수신 버퍼와 빈 송신 대기열의 메모리를 놓는다
+        bool                        mResumesSessions = false;   // true면 연결이 끊긴 세션을 mResumePolicy에 따라 이어 간다
+                                                                // 받는 쪽은 상대의 첫 프레임을 받은 뒤에 세션을 등록한다
+
+        CaptureLog::Ptr             mCaptureLog;
+        Tracer::Ptr                 mTracer;
+        UPtr<HandlerProfiler>       mHandlerProfiler;   // StartHandlerProfiling 전에는 nullptr
+
+    private:
+        using DatagramSessionMap = std::unordered_map<DatagramChannel::Token, WPtr<Session>>;
+
+        // hello 데이터그램은 잃어버릴 수 있으므로 DatagramBound를 받을 때까지 다시 보낸다
+        static constexpr Milliseconds   datagramHelloInterval = Milliseconds(200);
+        static constexpr size_t         maxDatagramHellos = 25;
+
+        // StatsQuery 응답에 담는 최대 세션 수
+        static constexpr size_t         maxStatsQuerySessions = 64;
+        using ResumeSessionMap = std::unordered_map<Session::ResumeToken, WPtr<Session>>;
+
+        Session::Context::Ptr       mSessionContext;
+        std::once_flag              mSessionContextOnce;
+
+        Timer                       mStatsTimer;
+        CoarseClock::Ptr            mCoarseClock;   // 수신 한도가 있을 때만 갱신된다
+        UPtr<PoolController>        mPoolController;
+
+        DatagramChannel::Ptr        mDatagramChannel;
+        bool                        mOffersDatagramBinding = false;
+        DatagramSessionMap          mDatagramSessionMap;
+        SMutex                      mDatagramSessionLock;
+
+        ResumeSessionMap            mResumeSessionMap;
+        Mutex                       mResumeSessionLock;
     };
 }
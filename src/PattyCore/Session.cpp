@@ -3,245 +3,1617 @@
 
 namespace PattyCore
 {
+    namespace
+    {
+        // TCP가 아니면 비어 있는 끝점을 돌려준다
+        Tcp::endpoint ToTcpEndpoint(const StreamEndpoint& endpoint)
+        {
+            Tcp::endpoint tcpEndpoint;
+            const int family = endpoint.protocol().family();
+
+            if ((family == Tcp::v4().family()) || (family == Tcp::v6().family()))
+            {
+                std::memcpy(tcpEndpoint.data(), endpoint.data(), endpoint.size());
+                tcpEndpoint.resize(endpoint.size());
+            }
+
+            return tcpEndpoint;
+        }
+    }
+
     Session::~Session()
     {
-        std::cout << *this << " Session destroyed: " << GetEndpoint() << "\n";
+        delete mDatagramLink.load();
+
+        std::cout << *this << " Session destroyed: ";
+        WriteEndpoint(std::cout);
+        std::cout << "\n";
     }
 
-    Session::Ptr Session::Create(Tcp::socket&& socket,
-                                 const Id id,
-                                 OnClosed onClosed,
-                                 Strand&& writeStrand,
-                                 OnReceived onReceived)
+    Session::Ptr Session::Create(Transport&& transport, const Id id, Strand&& strand, Context::Ptr context)
     {
-        Ptr newSession = Ptr(new Session(std::move(socket),
-                                         id,
-                                         std::move(onClosed),
-                                         std::move(writeStrand),
-                                         std::move(onReceived)));
-        newSession->ReceiveAsync(newSession);
+        Ptr newSession = Ptr(new Session(std::move(transport), id, std::move(strand), std::move(context)));
+
+        asio::post(newSession->mStrand,
+                   [self = newSession]()
+                   {
+                       self->WriteNextAsync();
+                       self->ReceiveAsync();
+                   });
 
         return newSession;
     }
 
     void Session::SendAsync(Message&& sendMsg)
     {
-        Message::Ptr msg = std::make_unique<Message>(std::move(sendMsg));
+        const Priority priority = mContext->sendPolicy->GetPriority(sendMsg.header.id);
+
+        SendAsync(std::move(sendMsg), priority);
+    }
+
+    void Session::SendAsync(Message&& sendMsg, const Priority priority)
+    {
+        assert(priority < Priority::Count);
+
+        Outgoing outgoing;
+        outgoing.msg = std::make_unique<Message>(std::move(sendMsg));
+
+        PostOutgoing(std::move(outgoing), priority);
+    }
+
+    void Session::SendConflatedAsync(Message&& sendMsg, const ConflationKey key)
+    {
+        const Priority priority = mContext->sendPolicy->GetPriority(sendMsg.header.id);
+
+        SendConflatedAsync(std::move(sendMsg), key, priority);
+    }
+
+    void Session::SendConflatedAsync(Message&& sendMsg, const ConflationKey key, const Priority priority)
+    {
+        assert(priority < Priority::Count);
+
+        Outgoing outgoing;
+        outgoing.msg = std::make_unique<Message>(std::move(sendMsg));
+        outgoing.conflated = true;
+        outgoing.conflationKey = key;
+
+        PostOutgoing(std::move(outgoing), priority);
+    }
+
+    void Session::PostOutgoing(Outgoing&& outgoing, const Priority priority)
+    {
+        // A reply sent from a traced handler continues its trace
+        if (mContext->tracer)
+        {
+            outgoing.traceId = Tracer::GetCurrentId();
+            outgoing.enqueuedAt = (outgoing.traceId != 0) ? SteadyNowNs() : 0;
+        }
+
+        mStats.sendQueueDepth.fetch_add(1, std::memory_order_relaxed);
 
-        asio::post(mWriteStrand,
-                   [self = shared_from_this(), msg = std::move(msg)]() mutable
+        asio::post(mStrand,
+                   [self = shared_from_this(), outgoing = std::move(outgoing), priority]() mutable
                    {
-                       self->WriteHeaderAsync(std::move(msg));
+                       if (outgoing.conflated)
+                       {
+                           self->EnqueueConflated(std::move(outgoing), priority);
+                       }
+                       else
+                       {
+                           self->EnqueueMessage(std::move(outgoing), priority);
+                       }
                    });
     }
 
     void Session::Close()
+    {
+        asio::dispatch(mStrand,
+                       [self = shared_from_this()]()
+                       {
+                           self->CloseOnStrand();
+                       });
+    }
+
+    void Session::CloseOnStrand()
+    {
+        const State state = mState.load();
+
+        if ((state == State::Closed) || (state == State::HandingOff))
+        {
+            return;
+        }
+
+        mState = State::Closed;
+
+        ErrCode errCode;
+
+        // A detached session closed its transport already
+        if (state != State::Detached)
+        {
+            mTransport.Close(errCode);
+        }
+
+        if (mResumeTimer)
+        {
+            mResumeTimer->cancel();
+        }
+
+        if (mResume && mResume->detachTimer)
+        {
+            mResume->detachTimer->cancel();
+        }
+
+        // A session still waiting for its first frame was never registered
+        if (state == State::Handshaking)
+        {
+            return;
+        }
+
+        mContext->onClosed(errCode, shared_from_this());
+    }
+
+    void Session::OnTransportError()
+    {
+        if ((mState == State::Open) && mResume && (mResume->token != 0))
+        {
+            Detach();
+            return;
+        }
+
+        CloseOnStrand();
+    }
+
+    void Session::Detach()
     {
         ErrCode errCode;
+        mTransport.Close(errCode);
 
+        ++mGeneration;
+        mState = State::Detached;
+
+        if (mResumeTimer)
         {
-            SMutexULock lock(mSocketLock);
+            mResumeTimer->cancel();
+        }
 
-            if (!mSocket.is_open())
+        // The message being written may or may not have reached the peer, its count on resume decides
+        if (mWriting.msg != nullptr)
+        {
+            if (!mWriting.internal)
             {
-                return;
+                JournalMessage(std::move(mWriting.msg));
+                mStats.sendQueueDepth.fetch_sub(1, std::memory_order_relaxed);
             }
 
-            mSocket.close(errCode);
+            mWriting = Outgoing();
         }
 
-        mOnClosed(errCode, shared_from_this());
+        // A partial frame is sent again by the peer since it is not counted yet
+        std::vector<std::byte>().swap(mReceiveBuffer);
+        mReceiveBegin = 0;
+        mReceiveEnd = 0;
+
+        mSendFraming = Framing::Mode::Fixed;
+        mReceiveFraming = Framing::Mode::Fixed;
+        mSwitchRequested = false;
+        mSendsChecksum = false;
+        mReceivesChecksum = false;
+        mChecksumRequested = false;
+
+        mResume->handshake = Outgoing();
+        mResume->awaitingGrant = false;
+        mResume->resendNext = 1;
+        mResume->resendLast = 0;
+
+        std::cout << *this << " Session detached\n";
+
+        WaitDetachedAsync();
+        mContext->onDetached(shared_from_this());
     }
 
-    Session::Id Session::GetId() const noexcept
+    void Session::WaitDetachedAsync()
     {
-        return mId;
+        if (mResume->detachTimer == nullptr)
+        {
+            mResume->detachTimer = std::make_unique<Timer>(mTransport.GetExecutor());
+        }
+
+        mResume->detachTimer->expires_after(mContext->resumePolicy->timeout);
+        mResume->detachTimer->async_wait(asio::bind_executor(mStrand,
+                                                             [self = shared_from_this(), generation = mGeneration](const ErrCode& errCode)
+                                                             {
+                                                                 // Cancelled by Close or by a reattach
+                                                                 if ((errCode == asio::error::operation_aborted) ||
+                                                                     (generation != self->mGeneration))
+                                                                 {
+                                                                     return;
+                                                                 }
+
+                                                                 std::cerr << *self << " Resume timed out\n";
+                                                                 self->CloseOnStrand();
+                                                             }));
     }
 
-    const Tcp::endpoint& Session::GetEndpoint() const noexcept
+    void Session::InstallTransport(Transport&& transport)
     {
-        return mEndpoint;
+        mTransport = std::move(transport);
+
+        if (mContext->busyPoller)
+        {
+            mContext->busyPoller->ApplySocketOptions(mTransport);
+        }
+
+        ++mGeneration;
+        mState = State::Open;
+
+        mResume->detachTimer->cancel();
+        RecordActivity();
     }
 
-    std::ostream& operator<<(std::ostream& os, const Session& session)
+    void Session::OfferCompactFraming()
     {
-        os << "[" << session.GetId() << "]";
+        if (!mContext->sendPolicy->allowsCompactFraming)
+        {
+            return;
+        }
 
-        return os;
+        Message offer;
+        offer.header.id = static_cast<Message::Id>(Message::SystemId::FramingOffer);
+
+        SendAsync(std::move(offer), Priority::Control);
     }
 
-    Session::Session(Tcp::socket&& socket,
-                     const Id id,
-                     OnClosed&& onClosed,
-                     Strand&& writeStrand,
-                     OnReceived&& onReceived)
-        : mSocket(std::move(socket))
-        , mId(id)
-        , mEndpoint(mSocket.remote_endpoint())
-        , mOnClosed(std::move(onClosed))
-        , mWriteStrand(std::move(writeStrand))
-        , mOnReceived(std::move(onReceived))
+    void Session::Reattach(Transport&& transport)
+    {
+        asio::post(mStrand,
+                   [self = shared_from_this(), transport = std::move(transport)]() mutable
+                   {
+                       if (self->mState != State::Detached)
+                       {
+                           ErrCode errCode;
+                           transport.Close(errCode);
+
+                           return;
+                       }
+
+                       self->InstallTransport(std::move(transport));
+
+                       // Nothing else is written until the peer says where to resume from
+                       self->mResume->handshake = self->MakeResumeMessage(Message::SystemId::ResumeRequest, false);
+                       self->mResume->awaitingGrant = true;
+
+                       std::cout << *self << " Session reattached\n";
+
+                       self->WriteNextAsync();
+                       self->ReceiveAsync();
+                   });
+    }
+
+    bool Session::IsDetached() const
+    {
+        return mState == State::Detached;
+    }
+
+    bool Session::IsClosed() const
     {
-        std::cout << *this << " Session created: " << GetEndpoint() << "\n";
+        return mState == State::Closed;
     }
 
-    void Session::WriteHeaderAsync(Message::Ptr msg)
+    Session::ResumeToken Session::GetResumeToken() const
     {
-        SMutexSLock lock(mSocketLock);
-        Message::Header& header = msg->header;
+        if (mResume == nullptr)
+        {
+            return 0;
+        }
 
-        asio::async_write(mSocket,
-                          asio::buffer(&header, sizeof(Message::Header)),
-                          asio::bind_executor(mWriteStrand,
-                                              [self = shared_from_this(), msg = std::move(msg)]
-                                              (const ErrCode& errCode, const size_t numBytes) mutable
-                                              {
-                                                  self->OnHeaderWritten(errCode, numBytes, std::move(msg));
-                                              }));
+        return mResume->token;
     }
 
-    void Session::OnHeaderWritten(const ErrCode& errCode, const size_t numBytes, Message::Ptr msg)
+    void Session::OfferFrameChecksum()
     {
-        if (errCode)
+        if (!mContext->sendPolicy->allowsFrameChecksum)
         {
-            std::cerr << *this << " Failed to write header : " << errCode << "\n";
+            return;
         }
-        else
+
+        Message offer;
+        offer.header.id = static_cast<Message::Id>(Message::SystemId::ChecksumOffer);
+
+        SendAsync(std::move(offer), Priority::Control);
+    }
+
+    void Session::BindDatagram(DatagramChannel::Ptr channel, const DatagramChannel::Token token, const Udp::endpoint& remote)
+    {
+        UPtr<DatagramLink> newLink = std::make_unique<DatagramLink>();
+        newLink->channel = channel;
+        newLink->token = token;
+        newLink->remote = remote;
+
+        DatagramLink* link = nullptr;
+
+        if (mDatagramLink.compare_exchange_strong(link, newLink.get()))
         {
-            assert(sizeof(Message::Header) == numBytes);
+            newLink.release();
 
-            // The size of payload is bigger than 0
-            if (msg->header.size > sizeof(Message::Header))
-            {
-                WritePayloadAsync(std::move(msg));
+            return;
+        }
 
-                return;
+        // Senders may already hold the published link, so a rebind updates it in place
+        MutexLockGrd lock(link->lock);
+
+        link->channel = std::move(channel);
+        link->token = token;
+        link->remote = remote;
+    }
+
+    bool Session::SendDatagramAsync(Message&& sendMsg)
+    {
+        DatagramLink* link = mDatagramLink.load();
+
+        if (link == nullptr)
+        {
+            return false;
+        }
+
+        MutexLockGrd lock(link->lock);
+
+        // The remote endpoint is unknown until the peer sends its first datagram
+        if (link->remote.port() == 0)
+        {
+            return false;
+        }
+
+        DatagramChannel::Header header;
+        header.token = link->token;
+        header.sequence = ++link->sendSequence;
+
+        return link->channel->SendAsync(link->remote, header, sendMsg);
+    }
+
+    bool Session::AcceptDatagram(const DatagramChannel::Header& header, const Udp::endpoint& remote, bool& learned)
+    {
+        learned = false;
+
+        DatagramLink* link = mDatagramLink.load();
+
+        if (link == nullptr)
+        {
+            return false;
+        }
+
+        MutexLockGrd lock(link->lock);
+
+        // The token is visible on the wire, so it alone must not be able to move the link elsewhere
+        if (link->remote.port() == 0)
+        {
+            if (UnmapAddress(remote.address()) != UnmapAddress(GetAddress()))
+            {
+                return false;
             }
         }
+        else if (remote != link->remote)
+        {
+            return false;
+        }
+
+        if (!DatagramChannel::IsNewer(header.sequence, link->receivedSequence))
+        {
+            return false;
+        }
+
+        if (link->remote.port() == 0)
+        {
+            link->remote = remote;
+            learned = true;
+        }
 
-        OnMessageWritten(errCode);
+        link->receivedSequence = header.sequence;
+
+        return true;
     }
 
-    void Session::WritePayloadAsync(Message::Ptr msg)
+    DatagramChannel::Token Session::GetDatagramToken() const
     {
-        SMutexSLock lock(mSocketLock);
-        Message::Payload& payload = msg->payload;
+        DatagramLink* link = mDatagramLink.load();
+
+        if (link == nullptr)
+        {
+            return 0;
+        }
 
-        asio::async_write(mSocket,
-                          asio::buffer(payload),
-                          [self = shared_from_this(), msg = std::move(msg)]
-                          (const ErrCode& errCode, const size_t numBytes) mutable
-                          {
-                              self->OnPayloadWritten(errCode, numBytes, std::move(msg));
-                          });
+        MutexLockGrd lock(link->lock);
+
+        return link->token;
     }
 
-    void Session::OnPayloadWritten(const ErrCode& errCode, const size_t numBytes, Message::Ptr msg)
+    void Session::ReceiveDatagramAsync(Message&& msg, const size_t numBytes)
     {
-        if (errCode)
+        // The rate limiter belongs to the strand, like the stream reads it also meters
+        asio::post(mStrand, [self = shared_from_this(), msg = std::move(msg), numBytes]() mutable
+                   {
+                       self->OnDatagramRead(std::move(msg), numBytes);
+                   });
+    }
+
+    void Session::ConfirmDatagram()
+    {
+        DatagramLink* link = mDatagramLink.load();
+
+        if (link == nullptr)
         {
-            std::cerr << *this << " Failed to write payload: " << errCode << "\n";
+            return;
         }
-        else
+
+        MutexLockGrd lock(link->lock);
+        link->confirmed = true;
+    }
+
+    bool Session::IsDatagramConfirmed() const
+    {
+        DatagramLink* link = mDatagramLink.load();
+
+        if (link == nullptr)
         {
-            assert(numBytes == msg->payload.size());
+            return false;
         }
 
-        OnMessageWritten(errCode);
+        MutexLockGrd lock(link->lock);
+
+        return link->confirmed;
     }
 
-    void Session::OnMessageWritten(const ErrCode& errCode)
+    Session::Id Session::GetId() const noexcept
     {
-        if (errCode)
+        return mId;
+    }
+
+    bool Session::IsLocal() const noexcept
+    {
+        return mIsLocal;
+    }
+
+    asio::ip::address Session::GetAddress() const
+    {
+        if (IsLocal())
         {
-            Close();
+            return asio::ip::address_v4::loopback();
+        }
+
+        return mRemote.address();
+    }
+
+    StatsSnapshot::SessionEntry Session::GetStats() const
+    {
+        const TimePoint lastActivity(TimePoint::duration(mStats.lastActivity.load(std::memory_order_relaxed)));
+        const TimePoint now = Clock::now();
+
+        std::ostringstream endpoint;
+        WriteEndpoint(endpoint);
+
+        StatsSnapshot::SessionEntry entry;
+        entry.id = mId;
+        entry.endpoint = endpoint.str();
+        entry.messagesIn = mStats.messagesIn.load(std::memory_order_relaxed);
+        entry.messagesOut = mStats.messagesOut.load(std::memory_order_relaxed);
+        entry.bytesIn = mStats.bytesIn.load(std::memory_order_relaxed);
+        entry.bytesOut = mStats.bytesOut.load(std::memory_order_relaxed);
+        entry.sendQueueDepth = mStats.sendQueueDepth.load(std::memory_order_relaxed);
+        entry.idleMs = std::chrono::duration_cast<Milliseconds>(now - lastActivity).count();
+
+        return entry;
+    }
+
+    void Session::ReadStatsAsync(OnStatsRead onRead)
+    {
+        asio::post(mStrand,
+                   [self = shared_from_this(), onRead = std::move(onRead)]()
+                   {
+                       onRead(self->GetStats());
+                   });
+    }
+
+    Session::Priority Session::SendPolicy::GetPriority(const Message::Id id) const
+    {
+        auto iter = priorities.find(id);
+
+        if (iter == priorities.end())
+        {
+            return Priority::Normal;
         }
+
+        return iter->second;
     }
 
-    void Session::ReceiveAsync(Ptr self)
+    bool Session::ReceivePolicy::IsEnabled() const
     {
-        assert(mReadMsg.owner == nullptr);
-        mReadMsg.owner = std::move(self);
+        if (sessionLimit.IsEnabled())
+        {
+            return true;
+        }
 
-        ReadHeaderAsync();
+        return std::any_of(limits.begin(), limits.end(),
+                           [](const auto& pair)
+                           {
+                               return pair.second.IsEnabled();
+                           });
     }
 
-    void Session::ReadHeaderAsync()
+    std::ostream& operator<<(std::ostream& os, const Session& session)
     {
-        SMutexSLock lock(mSocketLock);
+        os << "[" << session.GetId() << "]";
 
-        asio::async_read(mSocket,
-                         asio::buffer(&mReadMsg.msg.header, sizeof(Message::Header)),
-                         [this](const ErrCode& errCode, const size_t numBytes)
-                         {
-                             OnHeaderRead(errCode, numBytes);
-                         });
+        return os;
     }
 
-    void Session::OnHeaderRead(const ErrCode& errCode, const size_t numBytes)
+    std::ostream& operator<<(std::ostream& os, const StreamEndpoint& endpoint)
     {
-        if (errCode)
+        const int family = endpoint.protocol().family();
+
+        if ((family == Tcp::v4().family()) || (family == Tcp::v6().family()))
         {
-            std::cerr << *this << " Failed to read header: " << errCode << "\n";
+            os << ToTcpEndpoint(endpoint);
         }
         else
         {
-            assert(numBytes == sizeof(Message::Header));
-            assert(mReadMsg.msg.header.size >= sizeof(Message::Header));
+            os << "local";
+        }
 
-            // The size of payload is bigger than 0
-            if (mReadMsg.msg.header.size > sizeof(Message::Header))
-            {
-                mReadMsg.msg.payload.resize(mReadMsg.msg.header.size - sizeof(Message::Header));
-                ReadPayloadAsync();
+        return os;
+    }
 
-                return;
-            }
+    asio::ip::address UnmapAddress(const asio::ip::address& address)
+    {
+        // A dual-stack acceptor reports IPv4 peers as mapped IPv6 addresses
+        if (address.is_v6() && address.to_v6().is_v4_mapped())
+        {
+            return asio::ip::make_address_v4(asio::ip::v4_mapped, address.to_v6());
         }
 
-        OnMessageRead(errCode);
+        return address;
     }
 
-    void Session::ReadPayloadAsync()
+    Session::Session(Transport&& transport, const Id id, Strand&& strand, Context::Ptr&& context)
+        : mTransport(std::move(transport))
+        , mStrand(std::move(strand))
+        , mState(context->onEstablished ? State::Handshaking : State::Open)
+        , mId(id)
+        , mRemote(ToTcpEndpoint(mTransport.GetRemoteEndpoint()))
+        , mIsLocal(mRemote.port() == 0)
+        , mContext(std::move(context))
+        , mLaneCredits(mContext->sendPolicy->weights)
     {
-        SMutexSLock lock(mSocketLock);
+        RecordActivity();
+
+        if (mContext->busyPoller)
+        {
+            mContext->busyPoller->ApplySocketOptions(mTransport);
+        }
 
-        asio::async_read(mSocket,
-                         asio::buffer(mReadMsg.msg.payload),
-                         [this](const ErrCode& errCode, const size_t numBytes)
-                         {
-                             OnPayloadRead(errCode, numBytes);
-                         });
+        // Asked before anything else can be queued, so the request is the first frame the peer reads
+        if (mContext->resumePolicy && !mContext->onEstablished)
+        {
+            mResume = std::make_unique<ResumeState>();
+            mResume->handshake = MakeResumeMessage(Message::SystemId::ResumeRequest, false);
+        }
+
+        std::cout << *this << " Session created: ";
+        WriteEndpoint(std::cout);
+        std::cout << "\n";
     }
 
-    void Session::OnPayloadRead(const ErrCode& errCode, const size_t numBytes)
+    bool Session::SendLane::IsEmpty() const
     {
-        if (errCode)
+        return head == msgs.size();
+    }
+
+    void Session::SendLane::Push(Outgoing&& outgoing)
+    {
+        // Reclaim the consumed front once it outweighs the rest, so a lane that never drains stays bounded
+        if ((head >= 32) && (head * 2 >= msgs.size()))
         {
-            std::cerr << *this << " Failed to read payload: " << errCode << "\n";
+            msgs.erase(msgs.begin(), msgs.begin() + head);
+            head = 0;
         }
-        else
+
+        msgs.push_back(std::move(outgoing));
+    }
+
+    Session::Outgoing Session::SendLane::Pop()
+    {
+        assert(!IsEmpty());
+        Outgoing outgoing = std::move(msgs[head++]);
+
+        if (IsEmpty())
         {
-            assert(mReadMsg.msg.payload.size() == numBytes);
+            msgs.clear();
+            head = 0;
         }
 
-        OnMessageRead(errCode);
+        return outgoing;
     }
 
-    void Session::OnMessageRead(const ErrCode& errCode)
+    void Session::EnqueueMessage(Outgoing&& outgoing, const Priority priority)
     {
-        Ptr self = std::move(mReadMsg.owner);
+        mSendLanes[static_cast<size_t>(priority)].Push(std::move(outgoing));
 
-        if (errCode)
+        WriteNextAsync();
+    }
+
+    void Session::EnqueueConflated(Outgoing&& outgoing, const Priority priority)
+    {
+        auto [iter, inserted] = mConflated.try_emplace(outgoing.conflationKey);
+
+        // The newer value takes over the queued one's place in its lane
+        if (!inserted)
         {
-            Close();
+            iter->second = std::move(outgoing);
+
+            mStats.sendQueueDepth.fetch_sub(1, std::memory_order_relaxed);
+            mContext->serviceStats->Add(ServiceCounter::MessagesConflated);
 
             return;
         }
 
-        mReadMsg.owner = self;
-        mOnReceived(std::move(mReadMsg));
+        Outgoing placeholder;
+        placeholder.conflated = true;
+        placeholder.conflationKey = outgoing.conflationKey;
+
+        iter->second = std::move(outgoing);
+
+        EnqueueMessage(std::move(placeholder), priority);
+    }
+
+    void Session::TakeConflated()
+    {
+        auto iter = mConflated.find(mWriting.conflationKey);
+        assert(iter != mConflated.end());
+
+        mWriting = std::move(iter->second);
+        mConflated.erase(iter);
+
+        // Once written, the next value for the key queues anew
+        if (mContext->lean && mConflated.empty())
+        {
+            decltype(mConflated)().swap(mConflated);
+        }
+    }
 
-        ReceiveAsync(std::move(self));
+    void Session::WriteNextAsync()
+    {
+        // The next message is picked when the current write completes, a detached session keeps its queue
+        if ((mState != State::Open) || (mWriting.msg != nullptr))
+        {
+            return;
+        }
+
+        if (PopNextMessage())
+        {
+            WriteMessageAsync();
+        }
+    }
+
+    bool Session::PopNextMessage()
+    {
+        assert(mWriting.msg == nullptr);
+
+        if (mResume)
+        {
+            if (PopResumeMessage())
+            {
+                return true;
+            }
+
+            if (mResume->awaitingGrant)
+            {
+                return false;
+            }
+        }
+
+        const SendPolicy& policy = *mContext->sendPolicy;
+        const size_t numLanes = mSendLanes.size();
+
+        // Strict: the highest non-empty lane wins
+        // Weighted: the highest non-empty lane with credits wins, credits are refilled when exhausted
+        for (int round = 0; round < 2; ++round)
+        {
+            for (size_t lane = 0; lane < numLanes; ++lane)
+            {
+                SendLane& sendLane = mSendLanes[lane];
+
+                if (sendLane.IsEmpty())
+                {
+                    continue;
+                }
+
+                if (!policy.strict)
+                {
+                    if (mLaneCredits[lane] == 0)
+                    {
+                        continue;
+                    }
+
+                    --mLaneCredits[lane];
+                }
+
+                mWriting = sendLane.Pop();
+
+                if (mWriting.conflated)
+                {
+                    TakeConflated();
+                }
+
+                // A lean session gives back the lane's storage once it drains
+                if (mContext->lean && sendLane.IsEmpty())
+                {
+                    std::vector<Outgoing>().swap(sendLane.msgs);
+                }
+
+                return true;
+            }
+
+            mLaneCredits = policy.weights;
+
+            // A lane with zero weight still gets one write per round so it never starves
+            for (uint8_t& credit : mLaneCredits)
+            {
+                credit = std::max<uint8_t>(credit, 1);
+            }
+        }
+
+        return false;
+    }
+
+    bool Session::PopResumeMessage()
+    {
+        ResumeState& resume = *mResume;
+
+        if (resume.handshake.msg != nullptr)
+        {
+            mWriting = std::move(resume.handshake);
+            resume.handshake = Outgoing();
+
+            return true;
+        }
+
+        if (resume.awaitingGrant || (resume.resendNext > resume.resendLast))
+        {
+            return false;
+        }
+
+        // The journal keeps its copy in case this connection drops as well
+        assert(resume.resendNext >= resume.journalBegin);
+        const Message& journaled = *resume.journal[resume.resendNext - resume.journalBegin];
+
+        mWriting = Outgoing();
+        mWriting.msg = std::make_unique<Message>(journaled);
+        mWriting.internal = true;
+        ++resume.resendNext;
+
+        return true;
+    }
+
+    void Session::WriteMessageAsync()
+    {
+        mWritingHeaderSize = Framing::EncodeHeader(mSendFraming, mWriting.msg->header, mWritingHeader.data());
+
+        if (mWriting.traceId != 0)
+        {
+            mWriteStart = SteadyNowNs();
+        }
+
+        const std::vector<std::byte>& payload = mWriting.msg->payload;
+        const size_t checksumSize = mSendsChecksum ? Framing::checksumSize : 0;
+
+        if (mSendsChecksum)
+        {
+            Framing::EncodeChecksum(mWritingHeader.data(), mWritingHeaderSize, payload.data(), payload.size(), mWritingChecksum.data());
+        }
+
+        // Header, payload and checksum in one write so frames never interleave
+        // This is also why a Control message waits for a Bulk frame already on the wire, see Priority
+        const std::array<asio::const_buffer, 3> buffers =
+        {
+            asio::buffer(mWritingHeader.data(), mWritingHeaderSize),
+            asio::buffer(payload),
+            asio::buffer(mWritingChecksum.data(), checksumSize),
+        };
+
+        mTransport.AsyncWrite(buffers,
+                              asio::bind_executor(mStrand,
+                                                  [self = shared_from_this(), generation = mGeneration]
+                                                  (const ErrCode& errCode, const size_t numBytes)
+                                                  {
+                                                      if (generation == self->mGeneration)
+                                                      {
+                                                          self->OnMessageWritten(errCode, numBytes);
+                                                      }
+                                                  }));
+    }
+
+    void Session::OnMessageWritten(const ErrCode& errCode, const size_t numBytes)
+    {
+        if (errCode)
+        {
+            std::cerr << *this << " Failed to write message: " << errCode << "\n";
+            OnTransportError();
+
+            return;
+        }
+
+        assert(numBytes == mWritingHeaderSize + mWriting.msg->payload.size() + (mSendsChecksum ? Framing::checksumSize : 0));
+
+        // Everything written after a switch marker uses the new format
+        switch (static_cast<Message::SystemId>(mWriting.msg->header.id))
+        {
+        case Message::SystemId::FramingSwitch:
+            mSendFraming = Framing::Mode::Compact;
+            break;
+
+        case Message::SystemId::ChecksumSwitch:
+            mSendsChecksum = true;
+            break;
+
+        default:
+            break;
+        }
+
+        if (mWriting.traceId != 0)
+        {
+            const Tracer::Ptr& tracer = mContext->tracer;
+
+            tracer->Record("socket", "send.queue", mWriting.traceId, mWriting.enqueuedAt, mWriteStart);
+            tracer->Record("socket", "write", mWriting.traceId, mWriteStart, SteadyNowNs());
+        }
+
+        const bool internal = mWriting.internal;
+
+        if (!internal)
+        {
+            JournalMessage(std::move(mWriting.msg));
+            mStats.sendQueueDepth.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        mWriting = Outgoing();
+
+        mStats.messagesOut.fetch_add(1, std::memory_order_relaxed);
+        mStats.bytesOut.fetch_add(numBytes, std::memory_order_relaxed);
+        mContext->serviceStats->Add(ServiceCounter::MessagesOut, 1, ServiceCounter::BytesOut, numBytes);
+        RecordActivity();
+
+        WriteNextAsync();
+    }
+
+    void Session::ReceiveAsync()
+    {
+        // An idle lean session waits for readability without a buffer, a partial frame keeps it
+        if (mContext->lean && (mReceiveBegin == mReceiveEnd))
+        {
+            std::vector<std::byte>().swap(mReceiveBuffer);
+
+            mTransport.AsyncWaitReadable(asio::bind_executor(mStrand,
+                                                             [self = shared_from_this(), generation = mGeneration](const ErrCode& errCode)
+                                                             {
+                                                                 if (generation == self->mGeneration)
+                                                                 {
+                                                                     self->OnReadable(errCode);
+                                                                 }
+                                                             }));
+
+            return;
+        }
+
+        ReadAsync();
+    }
+
+    void Session::OnReadable(const ErrCode& errCode)
+    {
+        if (errCode)
+        {
+            std::cerr << *this << " Failed to wait readable: " << errCode << "\n";
+            OnTransportError();
+
+            return;
+        }
+
+        ReadAsync();
+    }
+
+    void Session::ReadAsync()
+    {
+        if (mReceiveBuffer.empty())
+        {
+            mReceiveBuffer.resize(receiveBufferSize);
+        }
+
+        // Make room at the end, a partial frame is moved to the front first
+        if (mReceiveEnd == mReceiveBuffer.size())
+        {
+            if (mReceiveBegin > 0)
+            {
+                std::memmove(mReceiveBuffer.data(), mReceiveBuffer.data() + mReceiveBegin, mReceiveEnd - mReceiveBegin);
+                mReceiveEnd -= mReceiveBegin;
+                mReceiveBegin = 0;
+            }
+            else
+            {
+                mReceiveBuffer.resize(mReceiveBuffer.size() * 2);
+            }
+        }
+
+        mTransport.AsyncReadSome(asio::buffer(mReceiveBuffer.data() + mReceiveEnd, mReceiveBuffer.size() - mReceiveEnd),
+                                 asio::bind_executor(mStrand,
+                                                     [self = shared_from_this(), generation = mGeneration](const ErrCode& errCode, const size_t numBytes)
+                                                     {
+                                                         if (generation == self->mGeneration)
+                                                         {
+                                                             self->OnRead(errCode, numBytes);
+                                                         }
+                                                     }));
+    }
+
+    void Session::OnRead(const ErrCode& errCode, const size_t numBytes)
+    {
+        if (errCode)
+        {
+            std::cerr << *this << " Failed to read: " << errCode << "\n";
+            OnTransportError();
+
+            return;
+        }
+
+        mReceiveEnd += numBytes;
+
+        if (mContext->busyPoller)
+        {
+            mContext->busyPoller->MarkActive();
+        }
+
+        if (mContext->tracer)
+        {
+            mReadStart = SteadyNowNs();
+        }
+
+        ProcessReceived();
+    }
+
+    void Session::ProcessReceived()
+    {
+        const ParseResult result = ParseFrames();
+
+        // Frames parsed before a pause or an error are still delivered
+        if (!mReceivedBatch.empty())
+        {
+            mContext->onReceived(std::move(mReceivedBatch));
+            mReceivedBatch.clear();
+        }
+
+        switch (result)
+        {
+        case ParseResult::NeedMore:
+            ReceiveAsync();
+            break;
+
+        case ParseResult::Paused:
+            // Not reading lets TCP flow control push back on the sender
+            WaitResumeAsync();
+            break;
+
+        case ParseResult::Malformed:
+            std::cerr << *this << " Malformed frame header\n";
+            Close();
+            break;
+
+        case ParseResult::OverLimit:
+            std::cerr << *this << " Receive rate limit exceeded\n";
+            Close();
+            break;
+
+        case ParseResult::Corrupted:
+            std::cerr << *this << " Frame checksum mismatch\n";
+            mContext->serviceStats->Add(ServiceCounter::FramesCorrupted);
+            Close();
+            break;
+
+        case ParseResult::TooLarge:
+            std::cerr << *this << " Frame exceeds the maximum message size\n";
+            Close();
+            break;
+
+        case ParseResult::HandingOff:
+            break;
+        }
+    }
+
+    Session::ParseResult Session::ParseFrames()
+    {
+        ParseResult parseResult = ParseResult::NeedMore;
+
+        while (mReceiveBegin < mReceiveEnd)
+        {
+            const std::byte* data = mReceiveBuffer.data() + mReceiveBegin;
+            const size_t numBytes = mReceiveEnd - mReceiveBegin;
+
+            Message::Header header;
+            size_t headerSize = 0;
+
+            const Framing::Result result = Framing::DecodeHeader(mReceiveFraming, data, numBytes, header, headerSize);
+
+            if (result == Framing::Result::Malformed)
+            {
+                return ParseResult::Malformed;
+            }
+
+            if (result == Framing::Result::Incomplete)
+            {
+                break;
+            }
+
+            // Both framings end up here, so neither can make the buffer grow past the limit
+            if (header.size > mContext->receivePolicy->maxMessageSize)
+            {
+                return ParseResult::TooLarge;
+            }
+
+            const size_t payloadSize = header.size - sizeof(Message::Header);
+            const size_t checksumSize = mReceivesChecksum ? Framing::checksumSize : 0;
+            const size_t frameSize = headerSize + payloadSize + checksumSize;
+
+            if (numBytes < frameSize)
+            {
+                // Grow up front so the rest of a large frame arrives in as few reads as possible
+                if (frameSize > mReceiveBuffer.size())
+                {
+                    std::memmove(mReceiveBuffer.data(), data, numBytes);
+                    mReceiveBegin = 0;
+                    mReceiveEnd = numBytes;
+                    mReceiveBuffer.resize(frameSize);
+                }
+
+                break;
+            }
+
+            // Checked before anything else so a corrupt frame is never admitted or counted
+            if ((checksumSize != 0) && !Framing::VerifyChecksum(data, headerSize + payloadSize))
+            {
+                return ParseResult::Corrupted;
+            }
+
+            if (!AdmitMessage(header.id))
+            {
+                const ReceivePolicy::Action action = mContext->receivePolicy->overLimit;
+
+                if (action == ReceivePolicy::Action::Disconnect)
+                {
+                    return ParseResult::OverLimit;
+                }
+
+                if (action == ReceivePolicy::Action::Delay)
+                {
+                    // The frame stays buffered and is admitted again after the delay
+                    mContext->serviceStats->Add(ServiceCounter::MessagesDelayed);
+                    parseResult = ParseResult::Paused;
+
+                    break;
+                }
+
+                mContext->serviceStats->Add(ServiceCounter::MessagesDropped);
+                mReceiveBegin += frameSize;
+                CountReceived(header.id);
+
+                continue;
+            }
+
+            Message msg;
+            msg.header = header;
+            msg.payload.assign(data + headerSize, data + headerSize + payloadSize);
+
+            mReceiveBegin += frameSize;
+
+            // May switch the receive format, so the next frame is decoded in the new one
+            OnMessageRead(std::move(msg), frameSize);
+
+            // The detached session owns the transport and the rest of the buffer now
+            if (mState == State::HandingOff)
+            {
+                return ParseResult::HandingOff;
+            }
+        }
+
+        if (mReceiveBegin == mReceiveEnd)
+        {
+            mReceiveBegin = 0;
+            mReceiveEnd = 0;
+        }
+
+        return parseResult;
+    }
+
+    bool Session::AdmitMessage(const Message::Id id)
+    {
+        const ReceivePolicy& policy = *mContext->receivePolicy;
+        const bool hasIdLimits = !policy.limits.empty();
+
+        if (!policy.sessionLimit.IsEnabled() && !hasIdLimits)
+        {
+            return true;
+        }
+
+        const int64_t now = mContext->clock->Now();
+        int64_t waitTime = mSessionBucket.GetWaitTime(policy.sessionLimit, now);
+        TokenBucket* idBucket = nullptr;
+
+        if (hasIdLimits)
+        {
+            auto iter = policy.limits.find(id);
+
+            if (iter != policy.limits.end())
+            {
+                idBucket = &mIdBuckets[id];
+                waitTime = std::max(waitTime, idBucket->GetWaitTime(iter->second, now));
+            }
+        }
+
+        if (waitTime > 0)
+        {
+            // The clock advances in coarse ticks, so never wait less than one of them
+            mResumeDelay = std::max<Nanoseconds>(Nanoseconds(waitTime), CoarseClock::defaultResolution);
+
+            return false;
+        }
+
+        if (policy.sessionLimit.IsEnabled())
+        {
+            mSessionBucket.Consume();
+        }
+
+        if (idBucket != nullptr)
+        {
+            idBucket->Consume();
+        }
+
+        return true;
+    }
+
+    void Session::WaitResumeAsync()
+    {
+        if (mResumeTimer == nullptr)
+        {
+            mResumeTimer = std::make_unique<Timer>(mTransport.GetExecutor());
+        }
+
+        mResumeTimer->expires_after(mResumeDelay);
+        mResumeTimer->async_wait(asio::bind_executor(mStrand,
+                                                     [self = shared_from_this(), generation = mGeneration](const ErrCode& errCode)
+                                                     {
+                                                         // Cancelled by Close or by a detach
+                                                         if ((errCode == asio::error::operation_aborted) ||
+                                                             (generation != self->mGeneration))
+                                                         {
+                                                             return;
+                                                         }
+
+                                                         if (errCode)
+                                                         {
+                                                             std::cerr << *self << " Failed to wait resume timer: " << errCode << "\n";
+                                                             self->Close();
+
+                                                             return;
+                                                         }
+
+                                                         self->ProcessReceived();
+                                                     }));
+    }
+
+    void Session::OnMessageRead(Message&& msg, const size_t numBytes)
+    {
+        mStats.messagesIn.fetch_add(1, std::memory_order_relaxed);
+        mStats.bytesIn.fetch_add(numBytes, std::memory_order_relaxed);
+        mContext->serviceStats->Add(ServiceCounter::MessagesIn, 1, ServiceCounter::BytesIn, numBytes);
+        RecordActivity();
+
+        if ((mState == State::Handshaking) && HandleFirstFrame(msg))
+        {
+            return;
+        }
+
+        if (HandleFramingMessage(msg) || HandleResumeMessage(msg))
+        {
+            return;
+        }
+
+        CountReceived(msg.header.id);
+
+        // System messages carry per-connection state such as tokens, replaying them means nothing
+        if (mContext->captureLog && !Message::IsSystemId(msg.header.id))
+        {
+            mContext->captureLog->Append(mId, msg);
+        }
+
+        const Tracer::Ptr& tracer = mContext->tracer;
+        const Tracer::Id traceId = tracer ? tracer->Sample() : 0;
+
+        if (traceId != 0)
+        {
+            tracer->Record("socket", "read", traceId, mReadStart, SteadyNowNs());
+        }
+
+        mReceivedBatch.emplace_back(shared_from_this(), std::move(msg)).traceId = traceId;
+    }
+
+    void Session::OnDatagramRead(Message&& msg, const size_t numBytes)
+    {
+        if (mState != State::Open)
+        {
+            return;
+        }
+
+        if (!AdmitMessage(msg.header.id))
+        {
+            if (mContext->receivePolicy->overLimit == ReceivePolicy::Action::Disconnect)
+            {
+                std::cerr << *this << " Receive rate limit exceeded\n";
+                Close();
+
+                return;
+            }
+
+            mContext->serviceStats->Add(ServiceCounter::MessagesDropped);
+
+            return;
+        }
+
+        mStats.messagesIn.fetch_add(1, std::memory_order_relaxed);
+        mStats.bytesIn.fetch_add(numBytes, std::memory_order_relaxed);
+        mContext->serviceStats->Add(ServiceCounter::MessagesIn, 1, ServiceCounter::BytesIn, numBytes);
+        RecordActivity();
+
+        MessageBatch batch;
+        batch.emplace_back(shared_from_this(), std::move(msg));
+
+        mContext->onReceived(std::move(batch));
+    }
+
+    bool Session::HandleFramingMessage(const Message& msg)
+    {
+        switch (static_cast<Message::SystemId>(msg.header.id))
+        {
+        case Message::SystemId::FramingOffer:
+            SwitchToCompactFraming();
+            return true;
+
+        case Message::SystemId::FramingSwitch:
+            // The peer encodes every frame after this one compactly
+            mReceiveFraming = Framing::Mode::Compact;
+            SwitchToCompactFraming();
+            return true;
+
+        case Message::SystemId::ChecksumOffer:
+            SwitchToFrameChecksum();
+            return true;
+
+        case Message::SystemId::ChecksumSwitch:
+            // Every frame after this one carries a checksum
+            mReceivesChecksum = true;
+            SwitchToFrameChecksum();
+            return true;
+
+        default:
+            return false;
+        }
+    }
+
+    void Session::SwitchToCompactFraming()
+    {
+        // Without consent the offer is ignored, so both sides keep the fixed header
+        if (!mContext->sendPolicy->allowsCompactFraming || mSwitchRequested.exchange(true))
+        {
+            return;
+        }
+
+        Message marker;
+        marker.header.id = static_cast<Message::Id>(Message::SystemId::FramingSwitch);
+
+        SendAsync(std::move(marker), Priority::Control);
+    }
+
+    void Session::SwitchToFrameChecksum()
+    {
+        if (!mContext->sendPolicy->allowsFrameChecksum || mChecksumRequested.exchange(true))
+        {
+            return;
+        }
+
+        Message marker;
+        marker.header.id = static_cast<Message::Id>(Message::SystemId::ChecksumSwitch);
+
+        SendAsync(std::move(marker), Priority::Control);
+    }
+
+    bool Session::HandleFirstFrame(const Message& msg)
+    {
+        const bool isRequest = (msg.header.id == static_cast<Message::Id>(Message::SystemId::ResumeRequest));
+        const MessageView<ResumeRequestSchema> view(msg);
+
+        if (isRequest && view.IsValid() && (view.Get<ResumeRequestSchema::Token>() != 0))
+        {
+            Ptr target = mContext->findResumable(view.Get<ResumeRequestSchema::Token>());
+
+            if ((target != nullptr) && (target.get() != this))
+            {
+                // Nothing is pending on this side, so the target can take the transport from its own strand
+                mState = State::HandingOff;
+
+                asio::post(target->mStrand,
+                           [target, self = shared_from_this(), peerReceived = view.Get<ResumeRequestSchema::ReceivedSequence>()]()
+                           {
+                               target->ResumeFrom(self, peerReceived);
+                           });
+
+                return true;
+            }
+        }
+
+        // Any other first frame starts a new session, a request for a token is answered with one
+        Establish(isRequest);
+
+        return isRequest;
+    }
+
+    void Session::Establish(const bool grantsResumption)
+    {
+        mState = State::Open;
+
+        if (grantsResumption)
+        {
+            mResume = std::make_unique<ResumeState>();
+            mResume->token = mContext->issueResumeToken(shared_from_this());
+            mResume->handshake = MakeResumeMessage(Message::SystemId::ResumeGrant, false);
+
+            WriteNextAsync();
+        }
+
+        mContext->onEstablished(shared_from_this());
+    }
+
+    void Session::ResumeFrom(const Ptr& transient, const Sequence peerReceived)
+    {
+        // The peer may notice a drop first, or the old connection is half open, the token proves it is gone
+        if (mState == State::Open)
+        {
+            Detach();
+        }
+
+        // Expired, already taken over, or the peer missed more than the journal holds
+        if ((mState != State::Detached) || !CanResend(peerReceived))
+        {
+            asio::post(transient->mStrand,
+                       [transient]()
+                       {
+                           transient->Establish(true);
+                           transient->ProcessReceived();
+                       });
+
+            return;
+        }
+
+        std::vector<std::byte> pending(transient->mReceiveBuffer.begin() + transient->mReceiveBegin,
+                                       transient->mReceiveBuffer.begin() + transient->mReceiveEnd);
+
+        InstallTransport(std::move(transient->mTransport));
+        transient->mState = State::Closed;
+
+        mReceiveEnd = pending.size();
+        mReceiveBuffer = std::move(pending);
+        mReceiveBuffer.resize(std::max(mReceiveEnd, receiveBufferSize));
+
+        ResendFrom(peerReceived);
+        mResume->handshake = MakeResumeMessage(Message::SystemId::ResumeGrant, true);
+
+        std::cout << *this << " Session resumed from " << peerReceived << "\n";
+
+        WriteNextAsync();
+        mContext->onResumed(shared_from_this(), true);
+
+        // Frames that arrived with the request are parsed before the next read
+        ProcessReceived();
+    }
+
+    bool Session::HandleResumeMessage(const Message& msg)
+    {
+        switch (static_cast<Message::SystemId>(msg.header.id))
+        {
+        case Message::SystemId::ResumeRequest:
+            // Only the first frame of a connection can resume
+            return true;
+
+        case Message::SystemId::ResumeGrant:
+            OnResumeGranted(msg);
+            return true;
+
+        case Message::SystemId::ResumeAck:
+        {
+            const MessageView<ResumeAckSchema> view(msg);
+
+            if (mResume && view.IsValid())
+            {
+                AcknowledgeSent(view.Get<ResumeAckSchema::ReceivedSequence>());
+            }
+
+            return true;
+        }
+
+        default:
+            return false;
+        }
+    }
+
+    void Session::OnResumeGranted(const Message& msg)
+    {
+        const MessageView<ResumeGrantSchema> view(msg);
+
+        if ((mResume == nullptr) || !view.IsValid())
+        {
+            return;
+        }
+
+        const ResumeToken token = view.Get<ResumeGrantSchema::Token>();
+        const Sequence peerReceived = view.Get<ResumeGrantSchema::ReceivedSequence>();
+        const bool resumed = (view.Get<ResumeGrantSchema::Resumed>() != 0);
+
+        // The first grant of a new session
+        if (!mResume->awaitingGrant)
+        {
+            mResume->token = token;
+            return;
+        }
+
+        mResume->awaitingGrant = false;
+
+        if (resumed && (token == mResume->token))
+        {
+            if (!CanResend(peerReceived))
+            {
+                std::cerr << *this << " Resume journal overflowed\n";
+                Close();
+
+                return;
+            }
+
+            ResendFrom(peerReceived);
+            std::cout << *this << " Session resumed from " << peerReceived << "\n";
+        }
+        else
+        {
+            // The peer lost our state and registered a new session, counting starts over
+            mResume->ResetSequences();
+            mResume->token = token;
+        }
+
+        WriteNextAsync();
+        mContext->onResumed(shared_from_this(), resumed);
+    }
+
+    void Session::CountReceived(const Message::Id id)
+    {
+        if ((mResume == nullptr) || Message::IsSystemId(id))
+        {
+            return;
+        }
+
+        const size_t ackInterval = mContext->resumePolicy->ackInterval;
+
+        ++mResume->receivedSeq;
+
+        if ((ackInterval == 0) || (mResume->receivedSeq % ackInterval != 0) || (mResume->token == 0))
+        {
+            return;
+        }
+
+        Message ack;
+        ack.header.id = static_cast<Message::Id>(Message::SystemId::ResumeAck);
+
+        MessageBuilder<ResumeAckSchema> builder(ack);
+        builder.Set<ResumeAckSchema::ReceivedSequence>(mResume->receivedSeq);
+
+        SendAsync(std::move(ack), Priority::Control);
+    }
+
+    void Session::JournalMessage(Message::Ptr&& msg)
+    {
+        if ((mResume == nullptr) || Message::IsSystemId(msg->header.id))
+        {
+            return;
+        }
+
+        ResumeState& resume = *mResume;
+
+        ++resume.sentSeq;
+        resume.journal.push_back(std::move(msg));
+
+        // Bounded, a peer that missed the dropped front can no longer resume
+        if (resume.journal.size() > mContext->resumePolicy->journalCapacity)
+        {
+            resume.journal.pop_front();
+            ++resume.journalBegin;
+        }
+    }
+
+    void Session::AcknowledgeSent(const Sequence peerReceived)
+    {
+        ResumeState& resume = *mResume;
+
+        while (!resume.journal.empty() && (resume.journalBegin <= peerReceived))
+        {
+            resume.journal.pop_front();
+            ++resume.journalBegin;
+        }
+    }
+
+    bool Session::CanResend(const Sequence peerReceived) const
+    {
+        return mResume && (peerReceived <= mResume->sentSeq) && (peerReceived + 1 >= mResume->journalBegin);
+    }
+
+    void Session::ResendFrom(const Sequence peerReceived)
+    {
+        AcknowledgeSent(peerReceived);
+
+        mResume->resendNext = peerReceived + 1;
+        mResume->resendLast = mResume->sentSeq;
+    }
+
+    Session::Outgoing Session::MakeResumeMessage(const Message::SystemId id, const bool resumed) const
+    {
+        const ResumeState& resume = *mResume;
+
+        Outgoing outgoing;
+        outgoing.msg = std::make_unique<Message>();
+        outgoing.msg->header.id = static_cast<Message::Id>(id);
+        outgoing.internal = true;
+
+        if (id == Message::SystemId::ResumeRequest)
+        {
+            MessageBuilder<ResumeRequestSchema> builder(*outgoing.msg);
+            builder.Set<ResumeRequestSchema::Token>(resume.token)
+                   .Set<ResumeRequestSchema::ReceivedSequence>(resume.receivedSeq);
+        }
+        else
+        {
+            MessageBuilder<ResumeGrantSchema> builder(*outgoing.msg);
+            builder.Set<ResumeGrantSchema::Token>(resume.token)
+                   .Set<ResumeGrantSchema::ReceivedSequence>(resume.receivedSeq)
+                   .Set<ResumeGrantSchema::Resumed>(resumed ? 1 : 0);
+        }
+
+        return outgoing;
+    }
+
+    void Session::ResumeState::ResetSequences()
+    {
+        sentSeq = 0;
+        receivedSeq = 0;
+        journal.clear();
+        journalBegin = 1;
+        resendNext = 1;
+        resendLast = 0;
+    }
+
+    void Session::RecordActivity()
+    {
+        const int64_t now = Clock::now().time_since_epoch().count();
+
+        mStats.lastActivity.store(now, std::memory_order_relaxed);
+    }
+
+    void Session::WriteEndpoint(std::ostream& os) const
+    {
+        if (IsLocal())
+        {
+            os << "local";
+        }
+        else
+        {
+            os << mRemote;
+        }
     }
 }
@@ -1,6 +1,15 @@
 ﻿#pragma once
 
 #include "Message.h"
+#include "MessageSchema.h"
+#include "DatagramChannel.h"
+#include "Statistics.h"
+#include "CaptureLog.h"
+#include "Framing.h"
+#include "RateLimiter.h"
+#include "Tracer.h"
+#include "Transport.h"
+#include "BusyPoller.h"
 
 namespace PattyCore
 {
@@ -15,59 +24,415 @@ namespace PattyCore
         using Id = uint32_t;
         using Ptr = SPtr<Session>;
         using Map = std::unordered_map<Id, Ptr>;
-        using OwnedMessage = OwnedMessage<Session>;
+        using OwnedMessage = PattyCore::OwnedMessage<Session>;
         using OnClosed = std::function<void(const ErrCode&, Ptr)>;
-        using OnReceived = std::function<void(OwnedMessage&&)>;
+        using MessageBatch = std::vector<OwnedMessage>;
+        using OnReceived = std::function<void(MessageBatch&&)>;     // 소켓 읽기 한 번에 파싱된 메시지들
+        using OnSessionEvent = std::function<void(Ptr)>;
+        using Sequence = uint64_t;          // 재개 대상 메시지의 순번, 시스템 메시지는 세지 않는다
+        using ResumeToken = uint64_t;       // 0은 토큰이 없다는 뜻
+        using OnResumed = std::function<void(Ptr, const bool resumed)>;
+        using FindResumable = std::function<Ptr(const ResumeToken)>;
+        using IssueResumeToken = std::function<ResumeToken(const Ptr&)>;
+        using ConflationKey = uint64_t;     // 같은 키로 보낸 메시지는 아직 쓰지 않았으면 최신 것으로 덮어쓴다
+                                            // 0xFFFFFFFE00000000 이상의 키는 PattyCore가 쓴다
+
+        // 레인은 프레임 사이에서만 고른다, 이미 쓰기 시작한 프레임은 끊지 않으므로
+        // Control 메시지도 쓰는 중인 프레임 하나가 끝날 때까지 기다린다 (최악은 가장 큰 Bulk 프레임 / 대역폭)
+        // Control의 지연을 짧게 유지하려면 Bulk 메시지를 적당한 크기(예: 64KB 이하)로 나눠 보내야 한다
+        enum class Priority : uint8_t
+        {
+            Control,    // 입력 응답, 핑 등 지연에 민감한 메시지
+            Normal,
+            Bulk,       // 상태 동기화 등 대용량 메시지
+            Count,
+        };
+
+        /*------------------*
+         *    SendPolicy    *
+         *------------------*/
+
+        struct SendPolicy
+        {
+            using Ptr = SPtr<const SendPolicy>;
+            using PriorityMap = std::unordered_map<Message::Id, Priority>;
+            using Weights = std::array<uint8_t, static_cast<size_t>(Priority::Count)>;
+
+            PriorityMap     priorities;                 // 메시지 id별 기본 우선순위
+            bool            strict = false;             // true면 높은 우선순위 레인을 항상 먼저 쓴다
+            Weights         weights = { 8, 4, 1 };      // strict가 아닐 때 레인별 연속 쓰기 횟수
+            bool            allowsCompactFraming = false;   // 상대도 허용하면 Compact 프레이밍으로 전환한다
+            bool            allowsFrameChecksum = false;    // 상대도 허용하면 프레임마다 CRC32C를 붙이고 검사한다
+
+            Priority GetPriority(const Message::Id id) const;
+        };
+
+        /*---------------------*
+         *    ReceivePolicy    *
+         *---------------------*/
+
+        // 디스패치 전에 적용하는 수신 한도
+        struct ReceivePolicy
+        {
+            using Ptr = SPtr<const ReceivePolicy>;
+            using LimitMap = std::unordered_map<Message::Id, TokenBucket::Limit>;
+
+            enum class Action : uint8_t
+            {
+                Delay,          // 토큰이 생길 때까지 읽기를 멈춘다
+                Drop,           // 한도를 넘은 메시지를 버린다
+                Disconnect,     // 세션을 닫는다
+            };
+
+            TokenBucket::Limit  sessionLimit;           // 세션의 모든 메시지에 적용
+            LimitMap            limits;                 // 메시지 id별 한도, sessionLimit과 함께 적용
+            Action              overLimit = Action::Delay;
+
+            // 헤더를 포함한 메시지 크기의 상한, 넘는 헤더를 받으면 버퍼를 키우기 전에 세션을 닫는다
+            // 깨진 헤더의 size를 그대로 믿으면 4GB 가까이 할당하거나 오지 않을 바이트를 기다리게 된다
+            size_t              maxMessageSize = 1 << 20;
+
+            bool IsEnabled() const;
+        };
+
+        /*--------------------*
+         *    ResumePolicy    *
+         *--------------------*/
+
+        // 연결이 끊겨도 세션을 남겨 두고 재연결한 쪽에 못 받은 메시지만 다시 보낸다
+        // 순번은 헤더에 싣지 않고 양쪽이 시스템 메시지가 아닌 프레임을 같은 순서로 세어서 정한다
+        struct ResumePolicy
+        {
+            using Ptr = SPtr<const ResumePolicy>;
+
+            size_t          journalCapacity = 1024;                 // 다시 보내려고 들고 있는 송신 메시지 수
+            size_t          ackInterval = 256;                      // 이만큼 받을 때마다 상대의 journal을 비우게 한다
+            Milliseconds    timeout = Milliseconds(30'000);         // 끊긴 세션이 재연결을 기다리는 시간
+            Milliseconds    retryInterval = Milliseconds(1'000);    // 클라이언트의 재연결 간격
+        };
+
+        /*---------------*
+         *    Context    *
+         *---------------*/
+
+        // 서비스의 모든 세션이 공유하는 상태, 세션은 포인터 하나만 들고 있다
+        struct Context
+        {
+            using Ptr = SPtr<const Context>;
+
+            OnClosed            onClosed;
+            OnReceived          onReceived;
+            SendPolicy::Ptr     sendPolicy;
+            ReceivePolicy::Ptr  receivePolicy;
+            CoarseClock::Ptr    clock;
+            SPtr<ServiceStats>  serviceStats;
+            CaptureLog::Ptr     captureLog;                 // nullptr이면 캡처하지 않는다
+            Tracer::Ptr         tracer;                     // nullptr이면 추적하지 않는다
+            BusyPoller::Ptr     busyPoller;                 // 있으면 수신할 때마다 소켓 스레드의 스피너를 깨운다
+            bool                lean = false;               // true면 유휴 중에는 수신 버퍼를 놓아 둔다
+
+            ResumePolicy::Ptr   resumePolicy;               // nullptr이면 연결이 끊기면 바로 닫는다
+            OnSessionEvent      onDetached;
+            OnResumed           onResumed;                  // resumed가 false면 상대가 세션을 새로 시작했다
+
+            // 재개를 받는 쪽만 채운다, 세션은 첫 프레임을 보고 새 세션인지 끊긴 세션의 재연결인지 정한다
+            OnSessionEvent      onEstablished;
+            FindResumable       findResumable;
+            IssueResumeToken    issueResumeToken;
+        };
+
+    public:
+        static constexpr size_t receiveBufferSize = 4 * 1024;   // 큰 프레임을 받으면 늘어난다
 
     public:
         ~Session();
 
-        static Ptr Create(Tcp::socket&& socket,
-                          const Id id,
-                          OnClosed onClosed,
-                          Strand&& writeStrand,
-                          OnReceived onReceived);
+        // 입출력과 닫기는 모두 strand에서 처리한다, transport는 소켓이나 MemoryPipe
+        // context에 resumePolicy만 있으면 연결한 쪽으로 보고 첫 프레임으로 재개 토큰을 요청한다
+        static Ptr Create(Transport&& transport, const Id id, Strand&& strand, Context::Ptr context);
 
         void SendAsync(Message&& sendMsg);
+        void SendAsync(Message&& sendMsg, const Priority priority);
 
+        // 위치나 시세처럼 최신 값만 의미 있는 메시지를 보낸다
+        // 같은 키의 메시지가 대기열에 남아 있으면 그 자리에서 교체하므로 느린 상대에게도 키마다 하나만 쌓인다
+        void SendConflatedAsync(Message&& sendMsg, const ConflationKey key);
+        void SendConflatedAsync(Message&& sendMsg, const ConflationKey key, const Priority priority);
+
+        // 스트랜드 밖에서 호출하면 비동기로 닫는다
         void Close();
 
+        // 상대에게 Compact 프레이밍을 제안한다, 상대가 지원하지 않으면 Fixed로 계속 통신한다
+        void OfferCompactFraming();
+
+        // 상대에게 프레임 체크섬을 제안한다, 양쪽이 허용해야 켜진다
+        void OfferFrameChecksum();
+
+        // 끊긴 세션을 새 연결로 이어 간다, 끊긴 상태가 아니면 transport를 닫는다
+        void Reattach(Transport&& transport);
+
+        bool IsDetached() const;
+        bool IsClosed() const;
+        ResumeToken GetResumeToken() const;
+
+        void BindDatagram(DatagramChannel::Ptr channel, const DatagramChannel::Token token, const Udp::endpoint& remote);
+        bool SendDatagramAsync(Message&& sendMsg);
+
+        // 끝점을 모를 때는 스트림과 같은 주소에서 온 첫 데이터그램으로 한 번만 정하고 이후에는 그 끝점만 받는다
+        // learned는 이번 데이터그램으로 끝점을 정했으면 true
+        bool AcceptDatagram(const DatagramChannel::Header& header, const Udp::endpoint& remote, bool& learned);
+        DatagramChannel::Token GetDatagramToken() const;
+
+        // AcceptDatagram을 통과한 메시지를 스트림과 같은 수신 한도와 통계를 거쳐 onReceived로 전달한다
+        // 데이터그램은 붙잡아 둘 수 없으므로 Delay 정책이어도 한도를 넘으면 버린다
+        void ReceiveDatagramAsync(Message&& msg, const size_t numBytes);
+
+        // 상대가 이쪽 끝점을 알게 되었다, 그 전까지는 hello 데이터그램을 다시 보낸다
+        void ConfirmDatagram();
+        bool IsDatagramConfirmed() const;
+
         Id GetId() const noexcept;
-        const Tcp::endpoint& GetEndpoint() const noexcept;
+        bool IsLocal() const noexcept;
+        asio::ip::address GetAddress() const;
+
+        // 스트랜드 밖에서 부르면 값마다 따로 읽으므로 메시지 수와 바이트가 같은 순간의 것이 아닐 수 있다
+        StatsSnapshot::SessionEntry GetStats() const;
+
+        using OnStatsRead = std::function<void(StatsSnapshot::SessionEntry&&)>;
+
+        // 통계는 스트랜드에서만 기록하므로 스트랜드에서 읽은 값들은 한 순간의 것이다, onRead도 스트랜드에서 호출한다
+        void ReadStatsAsync(OnStatsRead onRead);
 
         friend std::ostream& operator<<(std::ostream& os, const Session& session);
 
     private:
-        Session(Tcp::socket&& socket,
-                const Id id,
-                OnClosed&& onClosed,
-                Strand&& writeStrand,
-                OnReceived&& onReceived);
-
-        void WriteHeaderAsync(Message::Ptr msg);
-        void OnHeaderWritten(const ErrCode& errCode, const size_t numBytes, Message::Ptr msg);
-        void WritePayloadAsync(Message::Ptr msg);
-        void OnPayloadWritten(const ErrCode& errCode, const size_t numBytes, Message::Ptr msg);
-        void OnMessageWritten(const ErrCode& errCode);
-
-        void ReceiveAsync(Ptr self);
-        void ReadHeaderAsync();
-        void OnHeaderRead(const ErrCode& errCode, const size_t numBytes);
-        void ReadPayloadAsync();
-        void OnPayloadRead(const ErrCode& errCode, const size_t numBytes);
-        void OnMessageRead(const ErrCode& errCode);
+        Session(Transport&& transport, const Id id, Strand&& strand, Context::Ptr&& context);
+
+        enum class State : uint8_t
+        {
+            Handshaking,    // 재개를 받는 쪽에서 첫 프레임을 기다린다, 아직 등록되지 않았다
+            Open,
+            HandingOff,     // 끊긴 세션에 연결을 넘기는 중이다
+            Detached,       // 연결이 끊겨 재연결을 기다린다
+            Closed,
+        };
+
+        void CloseOnStrand();
+        void OnTransportError();
+        void Detach();
+        void WaitDetachedAsync();
+        void InstallTransport(Transport&& transport);
+
+        /*----------------*
+         *    Outgoing    *
+         *----------------*/
+
+        struct Outgoing
+        {
+            Message::Ptr    msg;
+            Tracer::Id      traceId = 0;        // 보낸 핸들러가 추적 중이던 id
+            int64_t         enqueuedAt = 0;     // 추적할 때만 기록한다
+            bool            internal = false;   // 재개 핸드셰이크나 재전송, 송신 대기열과 순번에 들지 않는다
+            bool            conflated = false;  // 레인에는 msg 없이 자리만 두고 메시지는 mConflated에 둔다
+            ConflationKey   conflationKey = 0;
+        };
+
+        // 추적 id와 송신 대기열 깊이를 기록하고 스트랜드에서 대기열에 넣는다
+        void PostOutgoing(Outgoing&& outgoing, const Priority priority);
+        void EnqueueMessage(Outgoing&& outgoing, const Priority priority);
+        void EnqueueConflated(Outgoing&& outgoing, const Priority priority);
+        void TakeConflated();
+        void WriteNextAsync();
+        bool PopNextMessage();
+        bool PopResumeMessage();
+        void WriteMessageAsync();
+        void OnMessageWritten(const ErrCode& errCode, const size_t numBytes);
+
+        enum class ParseResult : uint8_t
+        {
+            NeedMore,       // 버퍼의 프레임을 모두 처리했다
+            Paused,         // 수신 한도 때문에 mResumeDelay 후에 이어서 처리한다
+            Malformed,
+            OverLimit,      // 수신 한도를 넘어 세션을 닫아야 한다
+            HandingOff,     // 연결을 끊긴 세션에 넘겼다, 남은 바이트도 그쪽에서 처리한다
+            Corrupted,      // 체크섬이 맞지 않아 세션을 닫아야 한다
+            TooLarge,       // maxMessageSize보다 큰 프레임이라 세션을 닫아야 한다
+        };
+
+        void ReceiveAsync();
+        void OnReadable(const ErrCode& errCode);
+        void ReadAsync();
+        void OnRead(const ErrCode& errCode, const size_t numBytes);
+        void ProcessReceived();
+        ParseResult ParseFrames();
+        bool AdmitMessage(const Message::Id id);
+        void WaitResumeAsync();
+        void OnMessageRead(Message&& msg, const size_t numBytes);
+        void OnDatagramRead(Message&& msg, const size_t numBytes);
+
+        bool HandleFramingMessage(const Message& msg);
+        void SwitchToCompactFraming();
+        void SwitchToFrameChecksum();
+
+        bool HandleFirstFrame(const Message& msg);
+        void Establish(const bool grantsResumption);
+        void ResumeFrom(const Ptr& transient, const Sequence peerReceived);
+        bool HandleResumeMessage(const Message& msg);
+        void OnResumeGranted(const Message& msg);
+        void CountReceived(const Message::Id id);
+        void JournalMessage(Message::Ptr&& msg);
+        void AcknowledgeSent(const Sequence peerReceived);
+        bool CanResend(const Sequence peerReceived) const;
+        void ResendFrom(const Sequence peerReceived);
+        Outgoing MakeResumeMessage(const Message::SystemId id, const bool resumed) const;
+
+        void RecordActivity();
+        void WriteEndpoint(std::ostream& os) const;
 
     private:
-        Tcp::socket             mSocket;
-        SMutex                  mSocketLock;
+        /*----------------*
+         *    SendLane    *
+         *----------------*/
+
+        // 비어 있으면 메모리를 잡지 않는 송신 대기열, std::deque는 비어 있어도 블록을 할당하는 구현이 있다
+        struct SendLane
+        {
+            std::vector<Outgoing>       msgs;
+            size_t                      head = 0;   // 다음에 꺼낼 메시지
+
+            bool IsEmpty() const;
+            void Push(Outgoing&& outgoing);
+            Outgoing Pop();
+        };
+
+        Transport               mTransport;
+        Strand                  mStrand;        // 소켓 입출력, 닫기, 송신 대기열을 직렬화한다
+        std::atomic<State>      mState;         // 스트랜드에서만 바꾼다
+        uint32_t                mGeneration = 0;    // 연결이 바뀔 때마다 늘려서 이전 연결의 완료를 무시한다
 
         const Id                mId;
-        const Tcp::endpoint     mEndpoint;
+        const Tcp::endpoint     mRemote;        // 로컬 세션이면 비어 있다
+        const bool              mIsLocal;
+
+        Context::Ptr            mContext;
+
+        std::array<SendLane,
+                   static_cast<size_t>(Priority::Count)>
+                                mSendLanes;     // 우선순위 레인별 송신 대기열
+        SendPolicy::Weights     mLaneCredits;
+        std::unordered_map<ConflationKey, Outgoing>
+                                mConflated;     // 레인에 자리를 잡은 키의 최신 메시지, 스트랜드에서만 접근
+        Outgoing                mWriting;       // 현재 쓰고 있는 메시지
+        int64_t                 mWriteStart = 0;    // 추적할 때만 기록한다
+        Framing::HeaderBuffer   mWritingHeader; // 인코딩된 mWriting의 헤더
+        size_t                  mWritingHeaderSize = 0;
+        Framing::ChecksumBuffer mWritingChecksum;
+
+        Framing::Mode           mSendFraming = Framing::Mode::Fixed;        // 스트랜드에서만 접근
+        Framing::Mode           mReceiveFraming = Framing::Mode::Fixed;     // 수신 경로에서만 접근
+        std::atomic<bool>       mSwitchRequested = false;
+        bool                    mSendsChecksum = false;                     // 스트랜드에서만 접근
+        bool                    mReceivesChecksum = false;                  // 수신 경로에서만 접근
+        std::atomic<bool>       mChecksumRequested = false;
+
+        std::vector<std::byte>  mReceiveBuffer;     // 첫 읽기에서 할당한다, 린 세션은 유휴 중에 놓는다
+        size_t                  mReceiveBegin = 0;  // 아직 해석하지 않은 첫 바이트
+        size_t                  mReceiveEnd = 0;    // 받은 마지막 바이트 다음
+        MessageBatch            mReceivedBatch;     // 파싱을 마치면 한 번에 전달한다
+        int64_t                 mReadStart = 0;     // 추적할 때만 기록한다
+
+        /*-------------------*
+         *    RateLimiter    *
+         *-------------------*/
+
+        TokenBucket             mSessionBucket;                                 // 수신 경로에서만 접근
+        std::unordered_map<Message::Id, TokenBucket>
+                                mIdBuckets;                                     // 수신 경로에서만 접근
+        UPtr<Timer>             mResumeTimer;                                   // 처음 멈출 때 만든다
+        Nanoseconds             mResumeDelay = Nanoseconds(0);
+
+        /*--------------------*
+         *    DatagramLink    *
+         *--------------------*/
+
+        struct DatagramLink
+        {
+            Mutex                       lock;
+            DatagramChannel::Ptr        channel;
+            DatagramChannel::Token      token = 0;
+            Udp::endpoint               remote;
+            DatagramChannel::Sequence   sendSequence = 0;
+            DatagramChannel::Sequence   receivedSequence = 0;
+            bool                        confirmed = false;
+        };
 
-        OnClosed                mOnClosed;
+        std::atomic<DatagramLink*>  mDatagramLink = nullptr;   // 바인딩할 때 만들고 소멸자에서 지운다
 
-        Strand                  mWriteStrand;
-        OwnedMessage            mReadMsg;
-        OnReceived              mOnReceived;
+        /*-------------------*
+         *    ResumeState    *
+         *-------------------*/
+
+        // 재개하는 세션만 만든다, 스트랜드에서만 접근
+        struct ResumeState
+        {
+            ResumeToken                 token = 0;
+            Sequence                    sentSeq = 0;        // 마지막으로 쓴 메시지의 순번
+            Sequence                    receivedSeq = 0;    // 마지막으로 받은 메시지의 순번
+            std::deque<Message::Ptr>    journal;            // 상대가 받았다고 알리지 않은 메시지
+            Sequence                    journalBegin = 1;   // journal.front()의 순번
+            Sequence                    resendNext = 1;     // [resendNext, resendLast]를 다시 보낸다
+            Sequence                    resendLast = 0;
+            Outgoing                    handshake;          // 다른 모든 메시지보다 먼저 쓴다
+            bool                        awaitingGrant = false;  // 재연결한 쪽은 응답이 올 때까지 다른 메시지를 쓰지 않는다
+            UPtr<Timer>                 detachTimer;
+
+            void ResetSequences();
+        };
+
+        UPtr<ResumeState>       mResume;
+
+        /*-------------*
+         *    Stats    *
+         *-------------*/
+
+        // sendQueueDepth 말고는 스트랜드에서만 기록하므로 StatsCounter처럼 슬롯을 나누지 않는다
+        struct Stats
+        {
+            std::atomic<uint64_t>   messagesIn = 0;
+            std::atomic<uint64_t>   messagesOut = 0;
+            std::atomic<uint64_t>   bytesIn = 0;
+            std::atomic<uint64_t>   bytesOut = 0;
+            std::atomic<uint32_t>   sendQueueDepth = 0;     // 스트랜드에 게시된 메시지 포함
+            std::atomic<int64_t>    lastActivity = 0;       // Clock 기준 틱
+        };
+
+        Stats                   mStats;
+    };
+
+    std::ostream& operator<<(std::ostream& os, const StreamEndpoint& endpoint);
+
+    // IPv4에 매핑된 IPv6 주소면 IPv4 주소로, 아니면 그대로 돌려준다
+    asio::ip::address UnmapAddress(const asio::ip::address& address);
+
+    /*--------------------*
+     *    ResumeSchema    *
+     *--------------------*/
+
+    // SystemId::ResumeRequest의 payload, 토큰이 0이면 새 세션으로 토큰을 요청한다
+    struct ResumeRequestSchema : MessageSchema<Session::ResumeToken, Session::Sequence>
+    {
+        enum : size_t { Token, ReceivedSequence };
+    };
+
+    // SystemId::ResumeGrant의 payload
+    struct ResumeGrantSchema : MessageSchema<Session::ResumeToken, Session::Sequence, uint8_t>
+    {
+        enum : size_t { Token, ReceivedSequence, Resumed };
+    };
+
+    // SystemId::ResumeAck의 payload
+    struct ResumeAckSchema : MessageSchema<Session::Sequence>
+    {
+        enum : size_t { ReceivedSequence };
     };
 }
@@ -0,0 +1,166 @@
+﻿#include "Pch.h"
+#include "Statistics.h"
+
+namespace PattyCore
+{
+    void StatsSnapshot::SortSessions()
+    {
+        std::sort(sessions.begin(),
+                  sessions.end(),
+                  [](const SessionEntry& lhs, const SessionEntry& rhs)
+                  {
+                      if (lhs.sendQueueDepth != rhs.sendQueueDepth)
+                      {
+                          return lhs.sendQueueDepth > rhs.sendQueueDepth;
+                      }
+
+                      return (lhs.bytesIn + lhs.bytesOut) > (rhs.bytesIn + rhs.bytesOut);
+                  });
+    }
+
+    std::string StatsSnapshot::ToString(const Format format, const size_t maxSessions) const
+    {
+        std::ostringstream oss;
+
+        switch (format)
+        {
+        case Format::Text:
+            WriteText(oss, maxSessions);
+            break;
+
+        case Format::Json:
+            WriteJson(oss, maxSessions);
+            break;
+        }
+
+        return oss.str();
+    }
+
+    void StatsSnapshot::WriteText(std::ostream& os, const size_t maxSessions) const
+    {
+        auto get = [this](const ServiceCounter counter)
+            {
+                return service[static_cast<size_t>(counter)];
+            };
+
+        os << "[STATS] sessions: " << sessions.size()
+           << " (opened " << get(ServiceCounter::SessionsOpened)
+           << ", closed " << get(ServiceCounter::SessionsClosed) << ")"
+           << ", msgs in/out: " << get(ServiceCounter::MessagesIn) << "/" << get(ServiceCounter::MessagesOut)
+           << ", bytes in/out: " << get(ServiceCounter::BytesIn) << "/" << get(ServiceCounter::BytesOut)
+           << ", handled: " << get(ServiceCounter::MessagesHandled)
+           << ", delayed/dropped: " << get(ServiceCounter::MessagesDelayed) << "/" << get(ServiceCounter::MessagesDropped)
+           << ", corrupted: " << get(ServiceCounter::FramesCorrupted)
+           << ", conflated: " << get(ServiceCounter::MessagesConflated) << "\n";
+
+        os << "[STATS] message group workers: " << messageGroup.numActive << "/" << messageGroup.numWorkers
+           << ", executed: " << messageGroup.numExecuted
+           << ", stolen: " << messageGroup.numStolen
+           << ", failed steals: " << messageGroup.numFailedSteals
+           << ", idle waits: " << messageGroup.numIdleWaits << "\n";
+
+        if (socketPoll.numSpinners != 0)
+        {
+            os << "[STATS] socket poll spinners: " << (socketPoll.numSpinners - socketPoll.numParked) << "/" << socketPoll.numSpinners
+               << ", spin: " << (socketPoll.spinNs / 1'000'000) << "ms"
+               << ", parks: " << socketPoll.numParks
+               << ", wakes: " << socketPoll.numWakes << "\n";
+        }
+
+        const size_t numSessions = std::min(maxSessions, sessions.size());
+
+        for (size_t idx = 0; idx < numSessions; ++idx)
+        {
+            const SessionEntry& entry = sessions[idx];
+
+            os << "[" << entry.id << "] " << entry.endpoint
+               << " msgs in/out: " << entry.messagesIn << "/" << entry.messagesOut
+               << ", bytes in/out: " << entry.bytesIn << "/" << entry.bytesOut
+               << ", queue: " << entry.sendQueueDepth
+               << ", idle: " << entry.idleMs << "ms\n";
+        }
+
+        for (const HandlerEntry& entry : handlers)
+        {
+            os << "[HANDLER] " << entry.id
+               << " calls: " << entry.numCalls
+               << ", total: " << (entry.totalNs / 1'000'000) << "ms"
+               << ", avg: " << (entry.totalNs / std::max<uint64_t>(entry.numCalls, 1) / 1'000) << "us"
+               << ", max: " << (entry.maxNs / 1'000) << "us"
+               << ", cpu: " << (entry.cpuNs / 1'000'000) << "ms"
+               << ", slow: " << entry.numSlow << "\n";
+        }
+    }
+
+    void StatsSnapshot::WriteJson(std::ostream& os, const size_t maxSessions) const
+    {
+        auto get = [this](const ServiceCounter counter)
+            {
+                return service[static_cast<size_t>(counter)];
+            };
+
+        os << "{\"service\":{"
+           << "\"sessions\":" << sessions.size()
+           << ",\"sessionsOpened\":" << get(ServiceCounter::SessionsOpened)
+           << ",\"sessionsClosed\":" << get(ServiceCounter::SessionsClosed)
+           << ",\"messagesIn\":" << get(ServiceCounter::MessagesIn)
+           << ",\"messagesOut\":" << get(ServiceCounter::MessagesOut)
+           << ",\"bytesIn\":" << get(ServiceCounter::BytesIn)
+           << ",\"bytesOut\":" << get(ServiceCounter::BytesOut)
+           << ",\"messagesHandled\":" << get(ServiceCounter::MessagesHandled)
+           << ",\"messagesDelayed\":" << get(ServiceCounter::MessagesDelayed)
+           << ",\"messagesDropped\":" << get(ServiceCounter::MessagesDropped)
+           << ",\"framesCorrupted\":" << get(ServiceCounter::FramesCorrupted)
+           << ",\"messagesConflated\":" << get(ServiceCounter::MessagesConflated)
+           << "},\"messageGroup\":{"
+           << "\"workers\":" << messageGroup.numWorkers
+           << ",\"active\":" << messageGroup.numActive
+           << ",\"executed\":" << messageGroup.numExecuted
+           << ",\"stolen\":" << messageGroup.numStolen
+           << ",\"failedSteals\":" << messageGroup.numFailedSteals
+           << ",\"idleWaits\":" << messageGroup.numIdleWaits
+           << "},\"socketPoll\":{"
+           << "\"spinners\":" << socketPoll.numSpinners
+           << ",\"parked\":" << socketPoll.numParked
+           << ",\"spinNs\":" << socketPoll.spinNs
+           << ",\"parks\":" << socketPoll.numParks
+           << ",\"wakes\":" << socketPoll.numWakes
+           << "},\"sessions\":[";
+
+        const size_t numSessions = std::min(maxSessions, sessions.size());
+
+        for (size_t idx = 0; idx < numSessions; ++idx)
+        {
+            const SessionEntry& entry = sessions[idx];
+
+            os << ((idx == 0) ? "" : ",")
+               << "{\"id\":" << entry.id
+               << ",\"endpoint\":\"" << entry.endpoint << "\""
+               << ",\"messagesIn\":" << entry.messagesIn
+               << ",\"messagesOut\":" << entry.messagesOut
+               << ",\"bytesIn\":" << entry.bytesIn
+               << ",\"bytesOut\":" << entry.bytesOut
+               << ",\"sendQueueDepth\":" << entry.sendQueueDepth
+               << ",\"idleMs\":" << entry.idleMs
+               << "}";
+        }
+
+        os << "],\"handlers\":[";
+
+        for (size_t idx = 0; idx < handlers.size(); ++idx)
+        {
+            const HandlerEntry& entry = handlers[idx];
+
+            os << ((idx == 0) ? "" : ",")
+               << "{\"id\":" << entry.id
+               << ",\"calls\":" << entry.numCalls
+               << ",\"totalNs\":" << entry.totalNs
+               << ",\"maxNs\":" << entry.maxNs
+               << ",\"cpuNs\":" << entry.cpuNs
+               << ",\"slow\":" << entry.numSlow
+               << "}";
+        }
+
+        os << "]}";
+    }
+}
@@ -0,0 +1,235 @@
+﻿#pragma once
+
+namespace PattyCore
+{
+    /*--------------------*
+     *    StatsCounter    *
+     *--------------------*/
+
+    // 스레드마다 다른 캐시 라인 슬롯에 기록하고 읽을 때 합산하는 카운터 묶음
+    // 슬롯마다 시퀀스를 두어서 한 번의 Add로 기록한 카운터들은 Read에서 항상 같이 보인다
+    template<typename TCounter>
+    class StatsCounter
+    {
+    public:
+        static constexpr size_t numCounters = static_cast<size_t>(TCounter::Count);
+        static constexpr size_t numSlots = 32;
+
+        using Values = std::array<uint64_t, numCounters>;
+
+    public:
+        StatsCounter() = default;
+        StatsCounter(const StatsCounter&) = delete;
+        StatsCounter& operator=(const StatsCounter&) = delete;
+
+        void Add(const TCounter counter, const uint64_t value = 1)
+        {
+            Slot& slot = mSlots[GetSlotIndex()];
+            const uint64_t sequence = slot.BeginWrite();
+
+            slot.Increase(counter, value);
+            slot.EndWrite(sequence);
+        }
+
+        // MessagesIn과 BytesIn처럼 같이 읽어야 하는 두 카운터를 한 번에 기록한다
+        void Add(const TCounter first, const uint64_t firstValue, const TCounter second, const uint64_t secondValue)
+        {
+            Slot& slot = mSlots[GetSlotIndex()];
+            const uint64_t sequence = slot.BeginWrite();
+
+            slot.Increase(first, firstValue);
+            slot.Increase(second, secondValue);
+            slot.EndWrite(sequence);
+        }
+
+        // 슬롯마다 기록 중이 아닐 때의 값을 읽어서 합산한다
+        // 슬롯을 읽는 시점은 서로 다르므로 전체가 한 순간의 값은 아니지만 한 Add의 카운터들이 갈라지지는 않는다
+        Values Read() const
+        {
+            Values values = {};
+
+            for (const Slot& slot : mSlots)
+            {
+                const Values slotValues = slot.Read();
+
+                for (size_t idx = 0; idx < numCounters; ++idx)
+                {
+                    values[idx] += slotValues[idx];
+                }
+            }
+
+            return values;
+        }
+
+    private:
+        // 시퀀스가 홀수인 동안 기록 중이다, 한 슬롯을 여러 스레드가 나눠 쓸 수 있어서 기록은 시퀀스를 잠금으로 쓴다
+        struct alignas(64) Slot
+        {
+            std::atomic<uint64_t>                           sequence = 0;
+            std::array<std::atomic<uint64_t>, numCounters>  values = {};
+
+            uint64_t BeginWrite()
+            {
+                uint64_t current = sequence.load(std::memory_order_relaxed);
+
+                while (((current & 1) != 0) ||
+                       !sequence.compare_exchange_weak(current, current + 1, std::memory_order_acquire, std::memory_order_relaxed))
+                {
+                    current = sequence.load(std::memory_order_relaxed);
+                }
+
+                // A reader that sees any value written below also sees the odd sequence
+                std::atomic_thread_fence(std::memory_order_release);
+
+                return current + 1;
+            }
+
+            void Increase(const TCounter counter, const uint64_t value)
+            {
+                std::atomic<uint64_t>& target = values[static_cast<size_t>(counter)];
+                target.store(target.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+            }
+
+            void EndWrite(const uint64_t current)
+            {
+                sequence.store(current + 1, std::memory_order_release);
+            }
+
+            Values Read() const
+            {
+                Values result;
+                uint64_t before;
+                uint64_t after;
+
+                do
+                {
+                    before = sequence.load(std::memory_order_acquire);
+
+                    for (size_t idx = 0; idx < numCounters; ++idx)
+                    {
+                        result[idx] = values[idx].load(std::memory_order_relaxed);
+                    }
+
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    after = sequence.load(std::memory_order_relaxed);
+                } while (((before & 1) != 0) || (before != after));
+
+                return result;
+            }
+        };
+
+        static size_t GetSlotIndex()
+        {
+            static std::atomic<size_t> nextIndex = 0;
+            thread_local const size_t index = nextIndex.fetch_add(1) % numSlots;
+
+            return index;
+        }
+
+    private:
+        std::array<Slot, numSlots>  mSlots;
+    };
+
+    /*--------------------*
+     *    ServiceStats    *
+     *--------------------*/
+
+    enum class ServiceCounter : size_t
+    {
+        SessionsOpened,
+        SessionsClosed,
+        MessagesIn,
+        MessagesOut,
+        BytesIn,
+        BytesOut,
+        MessagesHandled,
+        MessagesDelayed,        // 수신 한도 때문에 읽기를 멈춘 횟수
+        MessagesDropped,        // 수신 한도 때문에 버린 메시지
+        FramesCorrupted,        // 체크섬이 맞지 않아 세션을 닫은 프레임
+        MessagesConflated,      // 쓰기 전에 같은 키의 새 메시지로 교체된 메시지
+        Count,
+    };
+
+    using ServiceStats = StatsCounter<ServiceCounter>;
+
+    /*----------------------*
+     *    SchedulerStats    *
+     *----------------------*/
+
+    // WorkStealingPool의 누적 카운터
+    struct SchedulerStats
+    {
+        uint32_t    numWorkers = 0;
+        uint32_t    numActive = 0;
+        uint64_t    numExecuted = 0;
+        uint64_t    numStolen = 0;          // 다른 워커의 대기열에서 가져와 실행한 작업
+        uint64_t    numFailedSteals = 0;    // 모든 워커가 비어 있어 훔치지 못한 횟수
+        uint64_t    numIdleWaits = 0;       // 일이 없어 잠든 횟수
+        uint64_t    idleNs = 0;             // 활성 워커가 잠들어 있던 시간의 합
+    };
+
+    /*---------------------*
+     *    BusyPollStats    *
+     *---------------------*/
+
+    // BusyPoller의 누적 카운터, spinNs가 지연 시간을 줄이려고 쓴 CPU 시간이다
+    struct BusyPollStats
+    {
+        uint32_t    numSpinners = 0;        // 0이면 꺼져 있다
+        uint32_t    numParked = 0;          // 지금 커널에서 기다리는 스피너
+        uint64_t    spinNs = 0;             // 스피너가 돈 시간의 합
+        uint64_t    numParks = 0;           // spinInterval 동안 수신이 없어 멈춘 횟수
+        uint64_t    numWakes = 0;           // 수신이 멈춘 스피너를 다시 돌린 횟수
+    };
+
+    /*---------------------*
+     *    StatsSnapshot    *
+     *---------------------*/
+
+    struct StatsSnapshot
+    {
+        enum class Format : uint8_t
+        {
+            Text,
+            Json,
+        };
+
+        struct SessionEntry
+        {
+            uint32_t        id = 0;
+            std::string     endpoint;
+            uint64_t        messagesIn = 0;
+            uint64_t        messagesOut = 0;
+            uint64_t        bytesIn = 0;
+            uint64_t        bytesOut = 0;
+            uint32_t        sendQueueDepth = 0;
+            int64_t         idleMs = 0;             // 마지막 입출력 이후 경과 시간
+        };
+
+        // HandlerProfiler가 켜져 있을 때 메시지 id별 핸들러 시간
+        struct HandlerEntry
+        {
+            uint32_t        id = 0;
+            uint64_t        numCalls = 0;
+            uint64_t        totalNs = 0;
+            uint64_t        maxNs = 0;
+            uint64_t        cpuNs = 0;
+            uint64_t        numSlow = 0;            // slowThreshold를 넘긴 호출
+        };
+
+        ServiceStats::Values        service = {};
+        SchedulerStats              messageGroup;
+        BusyPollStats               socketPoll;
+        std::vector<SessionEntry>   sessions;
+        std::vector<HandlerEntry>   handlers;       // 총 시간이 긴 순
+
+        // 송신 대기열이 깊은 세션, 트래픽이 많은 세션 순으로 정렬한다
+        void SortSessions();
+
+        std::string ToString(const Format format, const size_t maxSessions) const;
+
+    private:
+        void WriteText(std::ostream& os, const size_t maxSessions) const;
+        void WriteJson(std::ostream& os, const size_t maxSessions) const;
+    };
+}
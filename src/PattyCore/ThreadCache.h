@@ -0,0 +1,42 @@
+﻿#pragma once
+
+namespace PattyCore
+{
+    /*-------------------*
+     *    ThreadCache    *
+     *-------------------*/
+
+    // 객체가 스레드마다 하나씩 두는 항목을 thread_local로 캐시한다, 항목은 객체가 소유한다
+    // 객체 id는 재사용하지 않으므로 없어진 객체를 가리키던 캐시가 새 객체와 맞는 일은 없다
+    template<typename TEntry>
+    class ThreadCache
+    {
+    public:
+        ThreadCache()
+            : mId(sNextId.fetch_add(1))
+        {}
+
+        ThreadCache(const ThreadCache&) = delete;
+        ThreadCache& operator=(const ThreadCache&) = delete;
+
+        // 이 스레드에서 처음이면 create가 돌려준 항목을 캐시한다
+        template<typename TCreate>
+        TEntry& Get(TCreate&& create)
+        {
+            if (tCachedId != mId)
+            {
+                tCachedEntry = create();
+                tCachedId = mId;
+            }
+
+            return *tCachedEntry;
+        }
+
+    private:
+        static inline std::atomic<uint64_t>     sNextId = 1;
+        static inline thread_local uint64_t     tCachedId = 0;
+        static inline thread_local TEntry*      tCachedEntry = nullptr;
+
+        const uint64_t  mId;
+    };
+}
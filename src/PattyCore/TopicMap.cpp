@@ -0,0 +1,284 @@
+﻿#include "Pch.h"
+#include "TopicMap.h"
+
+namespace PattyCore
+{
+    bool TopicMap::Subscribe(const Id topicId, Session::Ptr session)
+    {
+        if (session->IsClosed())
+        {
+            return false;
+        }
+
+        const Session::Id sessionId = session->GetId();
+
+        {
+            TopicShard& shard = GetTopicShard(topicId);
+            SMutexULock lock(shard.mutex);
+
+            Members& members = shard.topics[topicId];
+            auto iter = FindMember(members, sessionId);
+
+            if ((iter != members.end()) && (iter->id == sessionId))
+            {
+                return false;
+            }
+
+            members.insert(iter, Member{ sessionId, session });
+        }
+
+        {
+            SessionShard& shard = GetSessionShard(sessionId);
+            MutexLockGrd lock(shard.mutex);
+
+            shard.topics[sessionId].push_back(topicId);
+        }
+
+        // The session is marked closed before it is unregistered, so either UnsubscribeAll saw this entry or this sees the close
+        if (session->IsClosed())
+        {
+            Unsubscribe(topicId, session);
+            return false;
+        }
+
+        return true;
+    }
+
+    bool TopicMap::Unsubscribe(const Id topicId, const Session::Ptr& session)
+    {
+        const Session::Id sessionId = session->GetId();
+
+        {
+            TopicShard& shard = GetTopicShard(topicId);
+            SMutexULock lock(shard.mutex);
+
+            auto topicIter = shard.topics.find(topicId);
+
+            if (topicIter == shard.topics.end())
+            {
+                return false;
+            }
+
+            Members& members = topicIter->second;
+            auto iter = FindMember(members, sessionId);
+
+            if ((iter == members.end()) || (iter->id != sessionId))
+            {
+                return false;
+            }
+
+            members.erase(iter);
+
+            if (members.empty())
+            {
+                shard.topics.erase(topicIter);
+            }
+        }
+
+        RemoveSessionTopic(sessionId, topicId);
+
+        return true;
+    }
+
+    void TopicMap::UnsubscribeAll(const Session::Ptr& session)
+    {
+        const Session::Id sessionId = session->GetId();
+        std::vector<Id> topicIds;
+
+        {
+            SessionShard& shard = GetSessionShard(sessionId);
+            MutexLockGrd lock(shard.mutex);
+
+            auto iter = shard.topics.find(sessionId);
+
+            if (iter == shard.topics.end())
+            {
+                return;
+            }
+
+            topicIds = std::move(iter->second);
+            shard.topics.erase(iter);
+        }
+
+        for (const Id topicId : topicIds)
+        {
+            TopicShard& shard = GetTopicShard(topicId);
+            SMutexULock lock(shard.mutex);
+
+            auto topicIter = shard.topics.find(topicId);
+
+            if (topicIter == shard.topics.end())
+            {
+                continue;
+            }
+
+            Members& members = topicIter->second;
+            auto iter = FindMember(members, sessionId);
+
+            if ((iter != members.end()) && (iter->id == sessionId))
+            {
+                members.erase(iter);
+            }
+
+            if (members.empty())
+            {
+                shard.topics.erase(topicIter);
+            }
+        }
+    }
+
+    size_t TopicMap::Publish(const Id topicId, const Message& msg, const Session::Id ignoredId)
+    {
+        size_t numSent = 0;
+        std::vector<Session::Id> deadIds;
+
+        {
+            const TopicShard& shard = GetTopicShard(topicId);
+            SMutexSLock lock(shard.mutex);
+
+            auto topicIter = shard.topics.find(topicId);
+
+            if (topicIter == shard.topics.end())
+            {
+                return 0;
+            }
+
+            for (const Member& member : topicIter->second)
+            {
+                if (member.id == ignoredId)
+                {
+                    continue;
+                }
+
+                const Session::Ptr session = member.session.lock();
+
+                // A closed session would only pile messages up in lanes nobody drains
+                if ((session == nullptr) || session->IsClosed())
+                {
+                    deadIds.push_back(member.id);
+                    continue;
+                }
+
+                session->SendAsync(Message(msg));
+                ++numSent;
+            }
+        }
+
+        if (!deadIds.empty())
+        {
+            Prune(topicId, deadIds);
+        }
+
+        return numSent;
+    }
+
+    size_t TopicMap::GetNumSubscribers(const Id topicId) const
+    {
+        const TopicShard& shard = GetTopicShard(topicId);
+        SMutexSLock lock(shard.mutex);
+
+        auto topicIter = shard.topics.find(topicId);
+
+        return (topicIter == shard.topics.end()) ? 0 : topicIter->second.size();
+    }
+
+    TopicMap::TopicShard& TopicMap::GetTopicShard(const Id topicId)
+    {
+        return mTopicShards[topicId % numShards];
+    }
+
+    const TopicMap::TopicShard& TopicMap::GetTopicShard(const Id topicId) const
+    {
+        return mTopicShards[topicId % numShards];
+    }
+
+    TopicMap::SessionShard& TopicMap::GetSessionShard(const Session::Id sessionId)
+    {
+        return mSessionShards[sessionId % numShards];
+    }
+
+    TopicMap::Members::const_iterator TopicMap::FindMember(const Members& members, const Session::Id sessionId)
+    {
+        return std::lower_bound(members.begin(),
+                                members.end(),
+                                sessionId,
+                                [](const Member& member, const Session::Id id)
+                                {
+                                    return member.id < id;
+                                });
+    }
+
+    bool TopicMap::IsDead(const Member& member)
+    {
+        const Session::Ptr session = member.session.lock();
+
+        return (session == nullptr) || session->IsClosed();
+    }
+
+    void TopicMap::Prune(const Id topicId, const std::vector<Session::Id>& deadIds)
+    {
+        std::vector<Session::Id> prunedIds;
+
+        {
+            TopicShard& shard = GetTopicShard(topicId);
+            SMutexULock lock(shard.mutex);
+
+            auto topicIter = shard.topics.find(topicId);
+
+            if (topicIter == shard.topics.end())
+            {
+                return;
+            }
+
+            Members& members = topicIter->second;
+
+            for (const Session::Id sessionId : deadIds)
+            {
+                auto iter = FindMember(members, sessionId);
+
+                // Checked again, the member may have been replaced since the publish let go of the lock
+                if ((iter != members.end()) && (iter->id == sessionId) && IsDead(*iter))
+                {
+                    members.erase(iter);
+                    prunedIds.push_back(sessionId);
+                }
+            }
+
+            if (members.empty())
+            {
+                shard.topics.erase(topicIter);
+            }
+        }
+
+        for (const Session::Id sessionId : prunedIds)
+        {
+            RemoveSessionTopic(sessionId, topicId);
+        }
+    }
+
+    void TopicMap::RemoveSessionTopic(const Session::Id sessionId, const Id topicId)
+    {
+        SessionShard& shard = GetSessionShard(sessionId);
+        MutexLockGrd lock(shard.mutex);
+
+        auto sessionIter = shard.topics.find(sessionId);
+
+        if (sessionIter == shard.topics.end())
+        {
+            return;
+        }
+
+        std::vector<Id>& topicIds = sessionIter->second;
+        auto iter = std::find(topicIds.begin(), topicIds.end(), topicId);
+
+        if (iter != topicIds.end())
+        {
+            topicIds.erase(iter);
+        }
+
+        if (topicIds.empty())
+        {
+            shard.topics.erase(sessionIter);
+        }
+    }
+}
@@ -0,0 +1,68 @@
+﻿#pragma once
+
+#include "Session.h"
+
+namespace PattyCore
+{
+    /*----------------*
+     *    TopicMap    *
+     *----------------*/
+
+    class TopicMap
+    {
+    public:
+        using Id = uint32_t;
+
+    public:
+        TopicMap() = default;
+        TopicMap(const TopicMap&) = delete;
+        TopicMap& operator=(const TopicMap&) = delete;
+
+        // 닫힌 세션은 구독하지 않는다, 닫히는 중에 구독해도 남지 않는다
+        bool Subscribe(const Id topicId, Session::Ptr session);
+        bool Unsubscribe(const Id topicId, const Session::Ptr& session);
+        void UnsubscribeAll(const Session::Ptr& session);
+
+        // 보낸 수를 돌려준다, 그 사이 닫히거나 사라진 구독자는 정리한다
+        size_t Publish(const Id topicId, const Message& msg, const Session::Id ignoredId);
+        size_t GetNumSubscribers(const Id topicId) const;
+
+    private:
+        struct Member
+        {
+            Session::Id     id;
+            WPtr<Session>   session;    // 구독이 세션의 수명을 늘리지 않는다
+        };
+
+        using Members = std::vector<Member>;    // 세션 id 순으로 정렬
+
+        // 샤드마다 캐시 라인을 분리해서 서로 다른 토픽의 갱신이 경합하지 않게 한다
+        struct alignas(64) TopicShard
+        {
+            mutable SMutex                      mutex;
+            std::unordered_map<Id, Members>     topics;
+        };
+
+        struct alignas(64) SessionShard
+        {
+            Mutex                                           mutex;
+            std::unordered_map<Session::Id, std::vector<Id>> topics;
+        };
+
+        static constexpr size_t numShards = 16;
+
+        TopicShard& GetTopicShard(const Id topicId);
+        const TopicShard& GetTopicShard(const Id topicId) const;
+        SessionShard& GetSessionShard(const Session::Id sessionId);
+
+        static Members::const_iterator FindMember(const Members& members, const Session::Id sessionId);
+        static bool IsDead(const Member& member);
+
+        void Prune(const Id topicId, const std::vector<Session::Id>& deadIds);
+        void RemoveSessionTopic(const Session::Id sessionId, const Id topicId);
+
+    private:
+        std::array<TopicShard, numShards>       mTopicShards;
+        std::array<SessionShard, numShards>     mSessionShards;
+    };
+}
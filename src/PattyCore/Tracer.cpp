@@ -0,0 +1,182 @@
+﻿#include "Pch.h"
+#include "Tracer.h"
+
+namespace PattyCore
+{
+    namespace
+    {
+        thread_local Tracer::Id         tCurrentId = 0;
+    }
+
+    Tracer::Scope::Scope(Tracer* tracer, const Id traceId, const char* category, const char* name)
+        : mTracer((traceId != 0) ? tracer : nullptr)
+        , mTraceId(traceId)
+        , mPrevId(tCurrentId)
+        , mCategory(category)
+        , mName(name)
+        , mStart((mTracer != nullptr) ? SteadyNowNs() : 0)
+    {
+        tCurrentId = traceId;
+    }
+
+    Tracer::Scope::~Scope()
+    {
+        tCurrentId = mPrevId;
+
+        if (mTracer != nullptr)
+        {
+            mTracer->Record(mCategory, mName, mTraceId, mStart, SteadyNowNs());
+        }
+    }
+
+    Tracer::Tracer(const uint32_t sampleInterval, const size_t eventsPerThread)
+        : mSampleInterval(std::max<uint32_t>(sampleInterval, 1))
+        , mEventsPerThread(eventsPerThread)
+        , mOrigin(SteadyNowNs())
+    {}
+
+    Tracer::Id Tracer::Sample()
+    {
+        if (mNumCandidates.fetch_add(1, std::memory_order_relaxed) % mSampleInterval != 0)
+        {
+            return 0;
+        }
+
+        return mNextTraceId.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    void Tracer::Record(const char* category, const char* name, const Id traceId, const int64_t start, const int64_t end)
+    {
+        ThreadBuffer& buffer = GetThreadBuffer();
+        const size_t numEvents = buffer.numEvents.load(std::memory_order_relaxed);
+
+        if (numEvents == mEventsPerThread)
+        {
+            buffer.numDropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        if (buffer.label == nullptr)
+        {
+            buffer.label = category;
+        }
+
+        buffer.events[numEvents] = { category, name, traceId, start, end };
+
+        // Publishes the event to Export
+        buffer.numEvents.store(numEvents + 1, std::memory_order_release);
+    }
+
+    bool Tracer::Export(const std::string& path) const
+    {
+        struct Entry
+        {
+            Event       event;
+            uint32_t    tid;
+        };
+
+        std::vector<Entry> entries;
+        std::ostringstream metadata;
+        uint64_t numDropped = 0;
+
+        {
+            MutexLockGrd lock(mBuffersLock);
+
+            for (const UPtr<ThreadBuffer>& buffer : mBuffers)
+            {
+                const size_t numEvents = buffer->numEvents.load(std::memory_order_acquire);
+
+                for (size_t idx = 0; idx < numEvents; ++idx)
+                {
+                    entries.push_back({ buffer->events[idx], buffer->index });
+                }
+
+                numDropped += buffer->numDropped.load(std::memory_order_relaxed);
+
+                if (numEvents > 0)
+                {
+                    metadata << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->index
+                             << ",\"args\":{\"name\":\"" << buffer->label << " #" << buffer->index << "\"}},\n";
+                }
+            }
+        }
+
+        // Spans of one trace in time order, so each links to the one before it
+        std::sort(entries.begin(), entries.end(),
+                  [](const Entry& lhs, const Entry& rhs)
+                  {
+                      return std::tie(lhs.event.traceId, lhs.event.start) < std::tie(rhs.event.traceId, rhs.event.start);
+                  });
+
+        std::ofstream output(path, std::ios::trunc);
+
+        if (!output)
+        {
+            std::cerr << "[TRACE] Failed to open: " << path << "\n";
+            return false;
+        }
+
+        output << std::fixed << std::setprecision(3);
+        output << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n" << metadata.str();
+
+        for (size_t idx = 0; idx < entries.size(); ++idx)
+        {
+            const Event& event = entries[idx].event;
+            const bool flowIn = (idx > 0) && (entries[idx - 1].event.traceId == event.traceId);
+            const bool flowOut = (idx + 1 < entries.size()) && (entries[idx + 1].event.traceId == event.traceId);
+
+            output << "{\"name\":\"" << event.name << "\""
+                   << ",\"cat\":\"" << event.category << "\""
+                   << ",\"ph\":\"X\""
+                   << ",\"ts\":" << (event.start - mOrigin) / 1000.0
+                   << ",\"dur\":" << (event.end - event.start) / 1000.0
+                   << ",\"pid\":1"
+                   << ",\"tid\":" << entries[idx].tid
+                   << ",\"bind_id\":\"0x" << std::hex << event.traceId << std::dec << "\""
+                   << ",\"flow_in\":" << (flowIn ? "true" : "false")
+                   << ",\"flow_out\":" << (flowOut ? "true" : "false")
+                   << ",\"args\":{\"trace\":" << event.traceId << "}}"
+                   << ((idx + 1 < entries.size()) ? ",\n" : "\n");
+        }
+
+        output << "]}\n";
+
+        std::cout << "[TRACE] Exported: " << path << " (" << entries.size() << " spans, " << numDropped << " dropped)\n";
+
+        return static_cast<bool>(output);
+    }
+
+    Tracer::Id Tracer::GetCurrentId()
+    {
+        return tCurrentId;
+    }
+
+    Tracer::ThreadBuffer& Tracer::GetThreadBuffer()
+    {
+        return mBufferCache.Get([this]()
+            {
+                const std::thread::id threadId = std::this_thread::get_id();
+
+                MutexLockGrd lock(mBuffersLock);
+
+                auto iter = std::find_if(mBuffers.begin(), mBuffers.end(),
+                                         [threadId](const UPtr<ThreadBuffer>& buffer)
+                                         {
+                                             return buffer->threadId == threadId;
+                                         });
+
+                if (iter == mBuffers.end())
+                {
+                    UPtr<ThreadBuffer> buffer = std::make_unique<ThreadBuffer>();
+                    buffer->threadId = threadId;
+                    buffer->index = static_cast<uint32_t>(mBuffers.size());
+                    buffer->events = std::make_unique<Event[]>(mEventsPerThread);
+
+                    mBuffers.push_back(std::move(buffer));
+                    iter = std::prev(mBuffers.end());
+                }
+
+                return iter->get();
+            });
+    }
+}
@@ -0,0 +1,91 @@
+﻿#pragma once
+
+namespace PattyCore
+{
+    /*--------------*
+     *    Tracer    *
+     *--------------*/
+
+    // 표본으로 고른 메시지가 스레드 풀을 거쳐 가는 구간을 스레드별 버퍼에 기록한다
+    // Export는 Chrome/Perfetto의 trace event JSON을 쓰며, 같은 추적 id의 구간은 흐름 화살표로 이어진다
+    // 버퍼가 가득 차면 이후 구간은 버리므로 오버헤드가 제한된다
+    class Tracer
+    {
+    public:
+        using Ptr = SPtr<Tracer>;
+        using Id = uint64_t;    // 0이면 추적하지 않는 메시지
+
+        /*-------------*
+         *    Scope    *
+         *-------------*/
+
+        // 살아 있는 동안 스레드의 현재 추적 id를 바꾸고, 끝나면 그 시간을 구간으로 기록한다
+        // 핸들러 안에서 보낸 메시지는 현재 추적 id를 이어받는다
+        class Scope
+        {
+        public:
+            Scope(Tracer* tracer, const Id traceId, const char* category, const char* name);
+            ~Scope();
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+        private:
+            Tracer*         mTracer;
+            const Id        mTraceId;
+            const Id        mPrevId;
+            const char*     mCategory;
+            const char*     mName;
+            const int64_t   mStart;
+        };
+
+    public:
+        // sampleInterval개의 메시지마다 하나를 추적한다
+        Tracer(const uint32_t sampleInterval, const size_t eventsPerThread);
+        Tracer(const Tracer&) = delete;
+        Tracer& operator=(const Tracer&) = delete;
+
+        Id Sample();
+
+        // category와 name은 정적 문자열이어야 한다
+        void Record(const char* category, const char* name, const Id traceId, const int64_t start, const int64_t end);
+
+        bool Export(const std::string& path) const;
+
+        static Id GetCurrentId();
+
+    private:
+        struct Event
+        {
+            const char*     category;
+            const char*     name;
+            Id              traceId;
+            int64_t         start;      // steady_clock 나노초
+            int64_t         end;
+        };
+
+        // 주인 스레드만 쓰고, 읽는 쪽은 numEvents까지만 읽는다
+        struct ThreadBuffer
+        {
+            std::thread::id         threadId;
+            uint32_t                index = 0;
+            const char*             label = nullptr;    // 첫 구간의 category
+            UPtr<Event[]>           events;
+            std::atomic<size_t>     numEvents = 0;
+            std::atomic<uint64_t>   numDropped = 0;
+        };
+
+        ThreadBuffer& GetThreadBuffer();
+
+    private:
+        const uint32_t                  mSampleInterval;
+        const size_t                    mEventsPerThread;
+        const int64_t                   mOrigin;            // 내보낼 때 이 시각을 0으로 삼는다
+
+        std::atomic<uint64_t>           mNumCandidates = 0;
+        std::atomic<Id>                 mNextTraceId = 0;
+
+        ThreadCache<ThreadBuffer>       mBufferCache;
+        std::vector<UPtr<ThreadBuffer>> mBuffers;
+        mutable Mutex                   mBuffersLock;       // 스레드가 처음 기록할 때와 내보낼 때만 잡는다
+    };
+}
@@ -0,0 +1,74 @@
+﻿#include "Pch.h"
+#include "Transport.h"
+
+namespace PattyCore
+{
+    Transport::Transport(StreamSocket&& socket)
+        : mSocket(std::move(socket))
+    {}
+
+    Transport::Transport(MemoryPipe::Ptr pipe)
+        : mSocket(pipe->GetExecutor())
+        , mPipe(std::move(pipe))
+    {}
+
+    asio::any_io_executor Transport::GetExecutor()
+    {
+        if (mPipe)
+        {
+            return mPipe->GetExecutor();
+        }
+
+        return mSocket.get_executor();
+    }
+
+    StreamEndpoint Transport::GetRemoteEndpoint() const
+    {
+        if (mPipe)
+        {
+            return StreamEndpoint();
+        }
+
+        return mSocket.remote_endpoint();
+    }
+
+    bool Transport::IsOpen() const
+    {
+        if (mPipe)
+        {
+            return mPipe->IsOpen();
+        }
+
+        return mSocket.is_open();
+    }
+
+    void Transport::Close(ErrCode& errCode)
+    {
+        if (mPipe)
+        {
+            mPipe->Close();
+            return;
+        }
+
+        mSocket.close(errCode);
+    }
+
+    void Transport::SetBusyPoll(const Microseconds interval, ErrCode& errCode)
+    {
+        if (mPipe)
+        {
+            return;
+        }
+
+#if defined(__linux__) && defined(SO_BUSY_POLL)
+        const int value = static_cast<int>(interval.count());
+
+        if (::setsockopt(mSocket.native_handle(), SOL_SOCKET, SO_BUSY_POLL, &value, sizeof(value)) != 0)
+        {
+            errCode = ErrCode(errno, std::system_category());
+        }
+#else
+        errCode = asio::error::operation_not_supported;
+#endif // __linux__ && SO_BUSY_POLL
+    }
+}
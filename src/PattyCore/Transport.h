@@ -0,0 +1,73 @@
+﻿#pragma once
+
+#include "MemoryPipe.h"
+
+namespace PattyCore
+{
+    /*-----------------*
+     *    Transport    *
+     *-----------------*/
+
+    // 세션이 쓰는 바이트 스트림, 커널 소켓이나 MemoryPipe 중 하나를 감싼다
+    class Transport
+    {
+    public:
+        Transport(StreamSocket&& socket);
+        Transport(MemoryPipe::Ptr pipe);
+
+        asio::any_io_executor GetExecutor();
+
+        // 파이프면 빈 끝점을 돌려준다
+        StreamEndpoint GetRemoteEndpoint() const;
+
+        bool IsOpen() const;
+        void Close(ErrCode& errCode);
+
+        // 커널 소켓이 수신을 기다릴 때 interval 동안 장치 큐를 직접 폴링하게 한다, 파이프면 아무것도 하지 않는다
+        void SetBusyPoll(const Microseconds interval, ErrCode& errCode);
+
+        template<typename THandler>
+        void AsyncReadSome(const asio::mutable_buffer& buffer, THandler&& handler)
+        {
+            if (mPipe)
+            {
+                mPipe->AsyncReadSome(buffer, std::forward<THandler>(handler));
+            }
+            else
+            {
+                mSocket.async_read_some(buffer, std::forward<THandler>(handler));
+            }
+        }
+
+        // 버퍼 시퀀스를 모두 쓰고 완료한다
+        template<typename TBuffers, typename THandler>
+        void AsyncWrite(const TBuffers& buffers, THandler&& handler)
+        {
+            if (mPipe)
+            {
+                mPipe->AsyncWrite(buffers, std::forward<THandler>(handler));
+            }
+            else
+            {
+                asio::async_write(mSocket, buffers, std::forward<THandler>(handler));
+            }
+        }
+
+        template<typename THandler>
+        void AsyncWaitReadable(THandler&& handler)
+        {
+            if (mPipe)
+            {
+                mPipe->AsyncWaitReadable(std::forward<THandler>(handler));
+            }
+            else
+            {
+                mSocket.async_wait(StreamSocket::wait_read, std::forward<THandler>(handler));
+            }
+        }
+
+    private:
+        StreamSocket        mSocket;    // mPipe가 있으면 열리지 않은 채로 둔다
+        MemoryPipe::Ptr     mPipe;
+    };
+}
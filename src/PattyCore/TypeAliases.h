@@ -8,7 +8,12 @@ namespace PattyCore
 
     using ErrCode           = std::error_code;
 
-    using TimePoint         = std::chrono::steady_clock::time_point;
+#ifdef PATTYCORE_VIRTUAL_TIME
+    using Clock             = VirtualClock;
+#else
+    using Clock             = std::chrono::steady_clock;
+#endif // PATTYCORE_VIRTUAL_TIME
+    using TimePoint         = Clock::time_point;
     using Seconds           = std::chrono::seconds;
     using Milliseconds      = std::chrono::milliseconds;
     using Microseconds      = std::chrono::microseconds;
@@ -29,6 +34,12 @@ namespace PattyCore
     template<typename T>
     using WPtr              = std::weak_ptr<T>;
 
+    // Clock과 달리 가상 시간에서도 실제 시간으로 흐르는 steady_clock의 나노초, 구간과 지연을 잴 때 쓴다
+    inline int64_t SteadyNowNs() noexcept
+    {
+        return std::chrono::duration_cast<Nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
     /*------------*
      *    Asio    *
      *------------*/
@@ -37,6 +48,14 @@ namespace PattyCore
     using WorkGrd           = asio::executor_work_guard<ThreadPool::executor_type>;
     using Strand            = asio::strand<ThreadPool::executor_type>;
     using Tcp               = asio::ip::tcp;
+    using Udp               = asio::ip::udp;
     using Endpoints         = asio::ip::basic_resolver_results<Tcp>;
-    using Timer             = asio::steady_timer;
+    using Stream            = asio::generic::stream_protocol;   // TCP, AF_UNIX 공용 스트림
+    using StreamSocket      = Stream::socket;
+    using StreamEndpoint    = Stream::endpoint;
+    using StreamAcceptor    = asio::basic_socket_acceptor<Stream>;
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+    using Local             = asio::local::stream_protocol;
+#endif // ASIO_HAS_LOCAL_SOCKETS
+    using Timer             = asio::basic_waitable_timer<Clock>;
 }
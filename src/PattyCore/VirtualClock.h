@@ -0,0 +1,53 @@
+﻿#pragma once
+
+namespace PattyCore
+{
+    /*--------------------*
+     *    VirtualClock    *
+     *--------------------*/
+
+    // Advance로만 흐르는 시계, PATTYCORE_VIRTUAL_TIME을 정의하면 Clock, Timer가 이 시계를 따른다
+    // 핑 주기나 수신 한도처럼 시간에 걸린 로직을 실제 시간을 기다리지 않고 돌릴 때 쓴다
+    struct VirtualClock
+    {
+        using duration      = std::chrono::nanoseconds;
+        using rep           = duration::rep;
+        using period        = duration::period;
+        using time_point    = std::chrono::time_point<VirtualClock>;
+
+        static constexpr bool is_steady = true;
+
+        // 만료를 기다리는 타이머는 실제 시간으로 이 간격마다 가상 시각을 다시 확인한다
+        static constexpr std::chrono::milliseconds pollInterval = std::chrono::milliseconds(1);
+
+        static time_point now() noexcept
+        {
+            return time_point(duration(sNow.load(std::memory_order_acquire)));
+        }
+
+        static void Advance(const duration delta) noexcept
+        {
+            sNow.fetch_add(delta.count(), std::memory_order_acq_rel);
+        }
+
+    private:
+        static inline std::atomic<rep>  sNow = 0;
+    };
+}
+
+// 가상 시각이 언제 흐를지 모르므로 반응기는 pollInterval보다 오래 잠들지 않는다
+template<>
+struct asio::wait_traits<PattyCore::VirtualClock>
+{
+    using Clock = PattyCore::VirtualClock;
+
+    static Clock::duration to_wait_duration(const Clock::duration& duration)
+    {
+        return std::clamp<Clock::duration>(duration, Clock::duration::zero(), Clock::pollInterval);
+    }
+
+    static Clock::duration to_wait_duration(const Clock::time_point& expiry)
+    {
+        return to_wait_duration(expiry - Clock::now());
+    }
+};
@@ -0,0 +1,293 @@
+﻿#include "Pch.h"
+#include "WorkStealingPool.h"
+
+namespace PattyCore
+{
+    namespace
+    {
+        // 현재 스레드가 워커라면 소속 풀과 인덱스
+        thread_local const WorkStealingPool*    tPool = nullptr;
+        thread_local size_t                     tWorkerIndex = 0;
+    }
+
+    WorkStealingPool::WorkStealingPool(const size_t numThreads, const size_t maxThreads)
+    {
+        const size_t numWorkers = std::max<size_t>({ numThreads, maxThreads, 1 });
+
+        mNumActive.store(std::max<size_t>(numThreads, 1));
+
+        mWorkers.reserve(numWorkers);
+
+        for (size_t index = 0; index < numWorkers; ++index)
+        {
+            mWorkers.push_back(std::make_unique<Worker>());
+        }
+
+        mThreads.reserve(numWorkers);
+
+        for (size_t index = 0; index < numWorkers; ++index)
+        {
+            mThreads.emplace_back([this, index]()
+                                  {
+                                      Run(index);
+                                  });
+        }
+    }
+
+    WorkStealingPool::~WorkStealingPool()
+    {
+        stop();
+        join();
+    }
+
+    WorkStealingPool::executor_type WorkStealingPool::get_executor() noexcept
+    {
+        return executor_type(*this);
+    }
+
+    void WorkStealingPool::stop()
+    {
+        mStopped.store(true);
+
+        MutexLockGrd lock(mSleepLock);
+        mSleepCond.notify_all();
+        mParkCond.notify_all();
+    }
+
+    void WorkStealingPool::join()
+    {
+        for (std::thread& thread : mThreads)
+        {
+            if (thread.joinable() && (thread.get_id() != std::this_thread::get_id()))
+            {
+                thread.join();
+            }
+        }
+    }
+
+    SchedulerStats WorkStealingPool::GetStats() const
+    {
+        const int64_t now = SteadyNowNs();
+
+        SchedulerStats stats;
+        stats.numWorkers = static_cast<uint32_t>(mWorkers.size());
+        stats.numActive = static_cast<uint32_t>(GetNumActive());
+
+        for (const UPtr<Worker>& worker : mWorkers)
+        {
+            stats.numExecuted += worker->numExecuted.load(std::memory_order_relaxed);
+            stats.numStolen += worker->numStolen.load(std::memory_order_relaxed);
+            stats.numFailedSteals += worker->numFailedSteals.load(std::memory_order_relaxed);
+            stats.numIdleWaits += worker->numIdleWaits.load(std::memory_order_relaxed);
+            stats.idleNs += worker->idleNs.load(std::memory_order_relaxed);
+
+            // A sleep still in progress counts up to now
+            const int64_t sleepingSince = worker->sleepingSince.load(std::memory_order_relaxed);
+
+            if (sleepingSince != 0)
+            {
+                stats.idleNs += std::max<int64_t>(now - sleepingSince, 0);
+            }
+        }
+
+        return stats;
+    }
+
+    void WorkStealingPool::Resize(const size_t numActive)
+    {
+        mNumActive.store(std::clamp<size_t>(numActive, 1, mWorkers.size()));
+
+        // Sleepers that became inactive must move over to parking
+        MutexLockGrd lock(mSleepLock);
+        mSleepCond.notify_all();
+        mParkCond.notify_all();
+    }
+
+    size_t WorkStealingPool::GetNumActive() const noexcept
+    {
+        return mNumActive.load(std::memory_order_relaxed);
+    }
+
+    size_t WorkStealingPool::GetMaxThreads() const noexcept
+    {
+        return mWorkers.size();
+    }
+
+    void WorkStealingPool::Submit(Task&& task)
+    {
+        if (mStopped.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+
+        // Work posted by a worker stays local, the rest is spread round-robin
+        const size_t index = (tPool == this)
+                           ? tWorkerIndex
+                           : mNextWorker.fetch_add(1, std::memory_order_relaxed) % GetNumActive();
+
+        Worker& worker = *mWorkers[index];
+
+        {
+            MutexLockGrd lock(worker.lock);
+            worker.tasks.push_back(std::move(task));
+        }
+
+        // Pairs with the sleeper incrementing mNumSleeping before it checks the queues again
+        if (mNumSleeping.load() > 0)
+        {
+            MutexLockGrd lock(mSleepLock);
+            mSleepCond.notify_one();
+        }
+    }
+
+    void WorkStealingPool::Run(const size_t index)
+    {
+        tPool = this;
+        tWorkerIndex = index;
+
+        Worker& worker = *mWorkers[index];
+        std::mt19937 engine(static_cast<uint32_t>(std::random_device{}() + index));
+
+        while (!mStopped.load(std::memory_order_relaxed))
+        {
+            if (index >= GetNumActive())
+            {
+                Park(index);
+                continue;
+            }
+
+            Task task;
+
+            if (PopLocal(worker, task))
+            {
+                task();
+                worker.numExecuted.fetch_add(1, std::memory_order_relaxed);
+
+                continue;
+            }
+
+            if (Steal(index, engine, task))
+            {
+                task();
+                worker.numExecuted.fetch_add(1, std::memory_order_relaxed);
+                worker.numStolen.fetch_add(1, std::memory_order_relaxed);
+
+                continue;
+            }
+
+            worker.numFailedSteals.fetch_add(1, std::memory_order_relaxed);
+            WaitForWork(index);
+        }
+
+        tPool = nullptr;
+    }
+
+    bool WorkStealingPool::PopLocal(Worker& worker, Task& task)
+    {
+        MutexLockGrd lock(worker.lock);
+
+        if (worker.tasks.empty())
+        {
+            return false;
+        }
+
+        task = std::move(worker.tasks.front());
+        worker.tasks.pop_front();
+
+        return true;
+    }
+
+    bool WorkStealingPool::Steal(const size_t thiefIndex, std::mt19937& engine, Task& task)
+    {
+        const size_t numWorkers = mWorkers.size();
+
+        if (numWorkers == 1)
+        {
+            return false;
+        }
+
+        for (int round = 0; round < numStealRounds; ++round)
+        {
+            const size_t start = engine() % numWorkers;
+
+            for (size_t offset = 0; offset < numWorkers; ++offset)
+            {
+                const size_t victimIndex = (start + offset) % numWorkers;
+
+                if (victimIndex == thiefIndex)
+                {
+                    continue;
+                }
+
+                Worker& victim = *mWorkers[victimIndex];
+
+                // A busy victim is skipped rather than waited on
+                MutexULock lock(victim.lock, std::try_to_lock);
+
+                if (!lock.owns_lock() || victim.tasks.empty())
+                {
+                    continue;
+                }
+
+                task = std::move(victim.tasks.back());
+                victim.tasks.pop_back();
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool WorkStealingPool::HasWork()
+    {
+        for (const UPtr<Worker>& worker : mWorkers)
+        {
+            MutexLockGrd lock(worker->lock);
+
+            if (!worker->tasks.empty())
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void WorkStealingPool::WaitForWork(const size_t index)
+    {
+        Worker& worker = *mWorkers[index];
+
+        MutexULock lock(mSleepLock);
+        mNumSleeping.fetch_add(1);
+
+        // Work submitted before the increment is seen here, later work sees the sleeper
+        if (!HasWork() && !mStopped.load() && (index < GetNumActive()))
+        {
+            worker.numIdleWaits.fetch_add(1, std::memory_order_relaxed);
+
+            const int64_t start = SteadyNowNs();
+            worker.sleepingSince.store(start, std::memory_order_relaxed);
+
+            mSleepCond.wait(lock);
+
+            const int64_t end = SteadyNowNs();
+            worker.sleepingSince.store(0, std::memory_order_relaxed);
+            worker.idleNs.fetch_add(end - start, std::memory_order_relaxed);
+        }
+
+        mNumSleeping.fetch_sub(1);
+    }
+
+    void WorkStealingPool::Park(const size_t index)
+    {
+        MutexULock lock(mSleepLock);
+
+        // Tasks left in this worker's deque are picked up by active workers stealing
+        mParkCond.wait(lock,
+                       [this, index]()
+                       {
+                           return mStopped.load() || (index < GetNumActive());
+                       });
+    }
+}
@@ -0,0 +1,153 @@
+﻿#pragma once
+
+#include "Statistics.h"
+
+namespace PattyCore
+{
+    /*------------------------*
+     *    WorkStealingPool    *
+     *------------------------*/
+
+    // 워커마다 대기열을 두고 빈 워커가 무작위 워커의 대기열에서 작업을 훔쳐 오는 스레드 풀
+    // asio::thread_pool과 같은 방식(asio::post, get_executor, stop, join)으로 쓸 수 있다
+    // maxThreads개의 스레드를 만들고 그중 활성 워커만 외부 게시를 받는다, 나머지는 잠들어 있다
+    class WorkStealingPool
+        : public asio::execution_context
+    {
+    private:
+        /*------------*
+         *    Task    *
+         *------------*/
+
+        // 이동만 가능한 핸들러를 담는다
+        class Task
+        {
+        public:
+            Task() = default;
+
+            template<typename TFunc>
+            explicit Task(TFunc&& func)
+                : mImpl(std::make_unique<Impl<std::decay_t<TFunc>>>(std::forward<TFunc>(func)))
+            {}
+
+            void operator()() { mImpl->Run(); }
+
+        private:
+            struct ImplBase
+            {
+                virtual ~ImplBase() = default;
+                virtual void Run() = 0;
+            };
+
+            template<typename TFunc>
+            struct Impl : ImplBase
+            {
+                explicit Impl(TFunc&& func) : func(std::move(func)) {}
+                explicit Impl(const TFunc& func) : func(func) {}
+
+                void Run() override { func(); }
+
+                TFunc func;
+            };
+
+            UPtr<ImplBase>  mImpl;
+        };
+
+    public:
+        /*--------------------*
+         *    executor_type   *
+         *--------------------*/
+
+        class executor_type
+        {
+        public:
+            WorkStealingPool& query(asio::execution::context_t) const noexcept
+            {
+                return *mPool;
+            }
+
+            static constexpr asio::execution::blocking_t query(asio::execution::blocking_t) noexcept
+            {
+                return asio::execution::blocking.never;
+            }
+
+            template<typename TFunc>
+            void execute(TFunc&& func) const
+            {
+                mPool->Submit(Task(std::forward<TFunc>(func)));
+            }
+
+            bool operator==(const executor_type& other) const noexcept { return mPool == other.mPool; }
+            bool operator!=(const executor_type& other) const noexcept { return mPool != other.mPool; }
+
+        private:
+            friend class WorkStealingPool;
+
+            explicit executor_type(WorkStealingPool& pool) noexcept
+                : mPool(&pool)
+            {}
+
+        private:
+            WorkStealingPool*   mPool;
+        };
+
+    public:
+        // maxThreads가 numThreads보다 작으면 numThreads로 고정된다
+        explicit WorkStealingPool(const size_t numThreads, const size_t maxThreads = 0);
+        WorkStealingPool(const WorkStealingPool&) = delete;
+        WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+        ~WorkStealingPool();
+
+        executor_type get_executor() noexcept;
+
+        // 대기 중인 작업은 버린다
+        void stop();
+        void join();
+
+        SchedulerStats GetStats() const;
+
+        // 활성 워커 수를 [1, GetMaxThreads()] 범위로 바꾼다, 비활성 워커의 남은 작업은 다른 워커가 훔쳐 간다
+        void Resize(const size_t numActive);
+        size_t GetNumActive() const noexcept;
+        size_t GetMaxThreads() const noexcept;
+
+    private:
+        struct alignas(64) Worker
+        {
+            Mutex                   lock;
+            std::deque<Task>        tasks;      // 주인은 앞에서, 훔치는 쪽은 뒤에서 꺼낸다
+
+            // 주인 워커만 기록한다
+            std::atomic<uint64_t>   numExecuted = 0;
+            std::atomic<uint64_t>   numStolen = 0;
+            std::atomic<uint64_t>   numFailedSteals = 0;
+            std::atomic<uint64_t>   numIdleWaits = 0;
+            std::atomic<uint64_t>   idleNs = 0;
+            std::atomic<int64_t>    sleepingSince = 0;  // 잠든 시각(steady_clock 나노초), 깨어 있으면 0
+        };
+
+        void Submit(Task&& task);
+        void Run(const size_t index);
+
+        bool PopLocal(Worker& worker, Task& task);
+        bool Steal(const size_t thiefIndex, std::mt19937& engine, Task& task);
+        bool HasWork();
+        void WaitForWork(const size_t index);
+        void Park(const size_t index);
+
+    private:
+        static constexpr int            numStealRounds = 2;     // 잠들기 전에 모든 워커를 훑는 횟수
+
+        std::vector<UPtr<Worker>>       mWorkers;
+        std::vector<std::thread>        mThreads;
+
+        std::atomic<size_t>             mNumActive = 0;
+        std::atomic<size_t>             mNextWorker = 0;        // 외부 스레드가 게시할 워커
+        std::atomic<bool>               mStopped = false;
+
+        Mutex                           mSleepLock;             // 잠들고 깨우는 경로에서만 잡는다
+        std::condition_variable         mSleepCond;
+        std::atomic<size_t>             mNumSleeping = 0;
+        std::condition_variable         mParkCond;              // 비활성 워커가 기다린다
+    };
+}
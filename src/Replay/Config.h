@@ -0,0 +1,14 @@
+﻿#pragma once
+
+namespace Replay::Config
+{
+    constexpr uint8_t numSocketThreads = 4;
+    constexpr uint8_t numSessionThreads = 1;
+    constexpr uint8_t numMessageThreads = 2;
+    constexpr uint8_t numTaskThreads = 1;
+
+    constexpr const char* host = "127.0.0.1";
+    constexpr const char* service = "60000";
+
+    constexpr size_t fastBatchSize = 1024;      // 최대 속도 재생 시 한 번에 보내는 프레임 수
+}
@@ -0,0 +1,4 @@
+﻿#pragma once
+
+#include <PattyCore/Include.h>
+#include <PattyCore/ClientServiceBase.h>
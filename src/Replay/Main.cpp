@@ -0,0 +1,50 @@
+﻿#include "Pch.h"
+#include "Service.h"
+#include "Config.h"
+
+using namespace Replay;
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        if (argc < 3)
+        {
+            std::cerr << "Usage: Replay <capture file> <number of connects> [fast]\n";
+            return 1;
+        }
+
+        const std::string path = argv[1];
+        const size_t numConnects = std::stoul(argv[2]);
+        const bool paced = (argc < 4) || (std::string(argv[3]) != "fast");
+
+        std::vector<CaptureLog::Record> records;
+
+        if (!CaptureLog::Load(path, records) || records.empty() || (numConnects == 0))
+        {
+            std::cerr << "[REPLAY] Failed to load capture: " << path << "\n";
+            return 1;
+        }
+
+        const ServiceBase::ThreadPoolGroup::Info info =
+        {
+            Config::numSocketThreads,
+            Config::numSessionThreads,
+            Config::numMessageThreads,
+            Config::numTaskThreads,
+            0,
+            { Microseconds(0), Microseconds(0) },   // 재생은 소켓 스레드를 스핀시키지 않는다
+        };
+
+        Service service(info, std::move(records), numConnects, paced);
+
+        service.Start(Config::host, Config::service, numConnects);
+        service.Join();
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+    }
+
+    return 0;
+}
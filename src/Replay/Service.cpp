@@ -0,0 +1,140 @@
+﻿#include "Pch.h"
+#include "Service.h"
+#include "Config.h"
+
+namespace Replay
+{
+    Service::Service(const ThreadPoolGroup::Info& info,
+                     std::vector<CaptureLog::Record>&& records,
+                     size_t numConnects,
+                     bool paced)
+        : ClientServiceBase(info)
+        , mRecords(std::move(records))
+        , mNumConnects(numConnects)
+        , mPaced(paced)
+        , mReplayStrand(asio::make_strand(mThreadPoolGroup.GetTaskGroup()))
+        , mReplayTimer(mThreadPoolGroup.GetTaskGroup())
+    {
+        // Concurrent appends can land in the log slightly out of order
+        std::stable_sort(mRecords.begin(),
+                         mRecords.end(),
+                         [](const CaptureLog::Record& lhs, const CaptureLog::Record& rhs)
+                         {
+                             return lhs.header.timestampNs < rhs.header.timestampNs;
+                         });
+    }
+
+    void Service::OnSessionRegistered(Session::Ptr session)
+    {
+        asio::post(mReplayStrand,
+                   [this, session = std::move(session)]() mutable
+                   {
+                       mSessions.push_back(std::move(session));
+
+                       if (mSessions.size() == mNumConnects)
+                       {
+                           StartReplay();
+                       }
+                   });
+    }
+
+    void Service::OnMessageReceived(OwnedMessage /*ownedMsg*/)
+    {
+        mNumReceived.fetch_add(1);
+    }
+
+    void Service::StartReplay()
+    {
+        std::cout << "[REPLAY] Replaying " << mRecords.size() << " frames over "
+                  << mSessions.size() << " sessions (" << (mPaced ? "paced" : "fast") << ")\n";
+
+        mStart = Clock::now();
+        ReplayNext();
+    }
+
+    void Service::ReplayNext()
+    {
+        if (mNextRecord == mRecords.size())
+        {
+            OnReplayFinished();
+            return;
+        }
+
+        if (!mPaced)
+        {
+            const size_t end = std::min(mNextRecord + Config::fastBatchSize, mRecords.size());
+
+            for (; mNextRecord < end; ++mNextRecord)
+            {
+                SendRecord(mRecords[mNextRecord]);
+            }
+
+            // Yield between batches so other tasks on the group are not starved
+            asio::post(mReplayStrand,
+                       [this]()
+                       {
+                           ReplayNext();
+                       });
+
+            return;
+        }
+
+        const int64_t firstNs = mRecords.front().header.timestampNs;
+        const TimePoint now = Clock::now();
+
+        while (mNextRecord < mRecords.size())
+        {
+            const CaptureLog::Record& record = mRecords[mNextRecord];
+            const TimePoint due = mStart + Nanoseconds(record.header.timestampNs - firstNs);
+
+            if (due > now)
+            {
+                WaitReplayTimerAsync(due);
+                return;
+            }
+
+            SendRecord(record);
+            ++mNextRecord;
+        }
+
+        OnReplayFinished();
+    }
+
+    void Service::SendRecord(const CaptureLog::Record& record)
+    {
+        auto iter = mSessionIndexMap.find(record.header.sessionId);
+
+        // Captured sessions are spread over the replay sessions in order of appearance
+        if (iter == mSessionIndexMap.end())
+        {
+            const size_t index = mSessionIndexMap.size() % mSessions.size();
+            iter = mSessionIndexMap.emplace(record.header.sessionId, index).first;
+        }
+
+        mSessions[iter->second]->SendAsync(Message(record.msg));
+    }
+
+    void Service::WaitReplayTimerAsync(const TimePoint expiry)
+    {
+        mReplayTimer.expires_at(expiry);
+        mReplayTimer.async_wait(asio::bind_executor(mReplayStrand,
+                                                    [this](const ErrCode& errCode)
+                                                    {
+                                                        if (errCode)
+                                                        {
+                                                            std::cerr << "[REPLAY] Failed to wait replay timer: " << errCode << "\n";
+                                                            return;
+                                                        }
+
+                                                        ReplayNext();
+                                                    }));
+    }
+
+    void Service::OnReplayFinished()
+    {
+        const auto elapsed = std::chrono::duration_cast<Milliseconds>(Clock::now() - mStart);
+
+        std::cout << "[REPLAY] Finished: " << mRecords.size() << " frames in " << elapsed.count() << "ms, "
+                  << mNumReceived.load() << " messages received\n";
+    }
+}
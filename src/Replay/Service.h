@@ -0,0 +1,42 @@
+﻿#pragma once
+
+namespace Replay
+{
+    /*---------------*
+     *    Service    *
+     *---------------*/
+
+    class Service : public ClientServiceBase
+    {
+    public:
+        Service(const ThreadPoolGroup::Info& info,
+                std::vector<CaptureLog::Record>&& records,
+                size_t numConnects,
+                bool paced);
+
+    protected:
+        virtual void OnSessionRegistered(Session::Ptr session) override;
+        virtual void OnMessageReceived(OwnedMessage ownedMsg) override;
+
+    private:
+        void StartReplay();
+        void ReplayNext();
+        void SendRecord(const CaptureLog::Record& record);
+        void WaitReplayTimerAsync(const TimePoint expiry);
+        void OnReplayFinished();
+
+    private:
+        std::vector<CaptureLog::Record>             mRecords;       // 타임스탬프 순으로 정렬
+        size_t                                      mNextRecord = 0;
+        const size_t                                mNumConnects;
+        const bool                                  mPaced;
+
+        std::vector<Session::Ptr>                   mSessions;
+        std::unordered_map<uint32_t, size_t>        mSessionIndexMap;   // 캡처된 세션 id -> mSessions 인덱스
+        Strand                                      mReplayStrand;
+        Timer                                       mReplayTimer;
+        TimePoint                                   mStart;
+
+        std::atomic<uint64_t>                       mNumReceived = 0;
+    };
+}
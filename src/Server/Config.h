@@ -5,7 +5,31 @@ namespace Server::Config
     constexpr uint8_t numSocketThreads = 4;
     constexpr uint8_t numSessionThreads = 3;
     constexpr uint8_t numMessageThreads = 4;
+    constexpr uint8_t maxMessageThreads = 16;   // 부하에 따라 numMessageThreads부터 여기까지 조절한다
     constexpr uint8_t numTaskThreads = 1;
 
+    // 0이 아니면 소켓 스레드마다 코어 하나를 써서 수신 뒤 이 시간 동안 커널에서 잠들지 않고 폴링한다
+    // socketBusyPollUs는 SO_BUSY_POLL, net.core.busy_read보다 크게 주려면 CAP_NET_ADMIN이 필요하다
+    constexpr uint32_t socketSpinUs = 0;
+    constexpr uint32_t socketBusyPollUs = 0;
+
     constexpr uint16_t port = 60000;
+
+    // 세션당 수신 한도, 넘으면 읽기를 멈춘다
+    constexpr uint32_t receiveRate = 1000;
+    constexpr uint32_t receiveBurst = 2000;
+
+    // 대부분의 연결이 유휴 상태라서 세션이 쉬는 동안 버퍼 메모리를 놓는다
+    constexpr bool leanSessions = true;
+
+    // 연결이 끊긴 세션을 남겨 두고 재연결한 클라이언트에게 못 받은 메시지만 다시 보낸다
+    constexpr bool resumesSessions = true;
+
+    // 0이 아니면 이만큼의 메시지마다 하나를 추적하고 종료할 때 tracePath에 내보낸다
+    constexpr uint32_t traceSampleInterval = 0;
+    constexpr size_t traceEventsPerThread = 1 << 16;
+    constexpr const char* tracePath = "trace.json";
+
+    // 0이 아니면 핸들러 시간을 메시지 id별로 통계에 모으고 이보다 오래 실행 중인 핸들러를 로그로 알린다
+    constexpr uint32_t slowHandlerMs = 100;
 }
@@ -14,12 +14,19 @@ int main()
             Config::numSessionThreads,
             Config::numMessageThreads,
             Config::numTaskThreads,
+            Config::maxMessageThreads,
+            { Microseconds(Config::socketSpinUs), Microseconds(Config::socketBusyPollUs) },
         };
 
         Service service(info, Config::port);
         
         service.Start();
         service.Join();
+
+        if (Config::traceSampleInterval != 0)
+        {
+            service.ExportTrace(Config::tracePath);
+        }
     }
     catch (const std::exception& e)
     {
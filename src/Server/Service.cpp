@@ -1,6 +1,7 @@
 ﻿#include "Pch.h"
 #include "Service.h"
 #include "MessageId.h"
+#include "Config.h"
 #include <Client/MessageId.h>
 
 namespace Server
@@ -11,6 +12,31 @@ namespace Server
         : ServerServiceBase(info, port)
         , mSecondTimer(mThreadPoolGroup.GetTaskGroup())
     {
+        mSendPolicy->priorities[static_cast<Message::Id>(MessageId::Ping)] = Session::Priority::Control;
+        mSendPolicy->allowsCompactFraming = true;
+        mSendPolicy->allowsFrameChecksum = true;
+        mReceivePolicy->sessionLimit = { Config::receiveRate, Config::receiveBurst };
+        mAllowsStatsQuery = true;  // 같은 호스트에서 연결한 세션만 응답받는다
+        mDeliversBatches = true;
+        mLeanSessions = Config::leanSessions;
+        mResumesSessions = Config::resumesSessions;
+
+        if (Config::traceSampleInterval != 0)
+        {
+            StartTracing(Config::traceSampleInterval, Config::traceEventsPerThread);
+        }
+
+        if (Config::slowHandlerMs != 0)
+        {
+            HandlerProfiler::Config profilerConfig;
+            profilerConfig.slowThreshold = Milliseconds(Config::slowHandlerMs);
+            StartHandlerProfiling(profilerConfig);
+        }
+
+        PoolController::Config poolConfig;
+        poolConfig.minThreads = Config::numMessageThreads;
+        StartPoolController(poolConfig);
+
         WaitSecondAsync();
     }
 